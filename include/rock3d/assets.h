@@ -21,9 +21,190 @@ class Assets
         not_found,
     };
     using readResult_t = nonstd::expected<buffer_t, readError_e>;
+    using viewResult_t = nonstd::expected<bufferView_s, readError_e>;
 
+    /**
+     * @brief Order in which queued asynchronous requests are read.  Requests
+     *        of the same priority are read in the order they were made.
+     */
+    enum class priority_e
+    {
+        low,      // Prefetching, nothing is waiting on it yet.
+        normal,   // Needed soon.
+        high,     // Needed for the next frame.
+        critical, // Something is blocked until this arrives.
+    };
+
+    /**
+     * @brief Identifies an asynchronous request.  Never 0.
+     */
+    using handle_t = uint64_t;
+
+    /**
+     * @brief Runs on a worker thread with the result of the read.
+     */
+    using work_t = std::function<void(viewResult_t &&)>;
+
+    /**
+     * @brief Runs on the main thread once the work is done.
+     */
+    using done_t = std::function<void()>;
+
+    /**
+     * @brief Runs on the main thread with the asset paths that changed on
+     *        disk since the last time it ran.
+     */
+    using changed_t = std::function<void(const nonstd::span<const std::string> nstrPaths)>;
+
+    /**
+     * @brief Add a location to search for assets.  Locations are searched
+     *        in the order they were added.
+     *
+     * @details Every file in the location is added to an index right away,
+     *          so finding an asset later doesn't have to ask the filesystem.
+     *          Files already found in an earlier location take priority.
+     *          Asset paths are matched without empty or "." parts.
+     *
+     *          Unless hot reload is watching every location, an asset that
+     *          isn't in the index is looked for in each directory once more
+     *          before giving up, so files created since are still found.
+     *
+     * @param strPath A directory, or a pack file ending in Pack::EXTENSION.
+     */
     virtual auto AddPath(std::string_view strPath) -> void = 0;
+
+    /**
+     * @brief Rebuild the index of every location, to pick up files that
+     *        were added or removed since they were indexed.
+     */
+    virtual auto Rescan() -> void = 0;
+
+    /**
+     * @brief Check if an asset exists, without reading it.
+     */
+    virtual auto Exists(std::string_view strPath) -> bool = 0;
     virtual auto ReadToBuffer(std::string_view strPath) -> readResult_t = 0;
+
+    /**
+     * @brief Read an asset without copying it.
+     *
+     * @details Loose files are memory-mapped, and assets in a pack point
+     *          straight into the mapped pack.  The data stays valid for as
+     *          long as any copy of the returned view is alive, so it can be
+     *          handed off to a parser or the GPU as-is.
+     *
+     * @param strPath Asset path to read.
+     */
+    virtual auto ReadToView(std::string_view strPath) -> viewResult_t = 0;
+
+    /**
+     * @brief Read many assets at once.
+     *
+     * @details Assets in a pack are viewed in place, as ReadToView does.
+     *          Loose files are read in a single batch through the platform,
+     *          which lets it submit every read together instead of taking
+     *          a page fault or a handful of syscalls per file.
+     *
+     * @param nstrPaths Asset paths to read.
+     * @return One result per path, in the order they were passed.
+     */
+    virtual auto ReadToViews(const nonstd::span<const std::string_view> nstrPaths) -> std::vector<viewResult_t> = 0;
+
+    /**
+     * @brief Decompression totals of every pack that has been added.
+     */
+    virtual auto PackStats() -> Pack::stats_s = 0;
+
+    /**
+     * @brief Read an asset in the background.
+     *
+     * @details The asset is read on a worker thread and passed to fnWork
+     *          on the same thread, which is where any parsing or decoding
+     *          should happen.  fnDone then runs on the main thread the next
+     *          time completions are delivered, which the engine does once
+     *          a frame before ticking the app.
+     *
+     * @param strPath Asset path to read.
+     * @param ePriority Where to put the request in the queue.
+     * @param fnWork Work to do with the asset off the main thread.
+     * @param fnDone Work to do on the main thread afterwards, can be empty.
+     * @return Handle of the request.
+     */
+    virtual auto RequestAsync(std::string_view strPath, const priority_e ePriority, work_t &&fnWork, done_t &&fnDone)
+        -> handle_t = 0;
+
+    /**
+     * @brief Cancel a request.
+     *
+     * @details A request that hasn't started is dropped from the queue.  A
+     *          request that has started still runs its work, but its done
+     *          function never runs.
+     *
+     * @return True if the request was still pending.
+     */
+    virtual auto Cancel(const handle_t qwHandle) -> bool = 0;
+
+    /**
+     * @brief Check if a request has yet to deliver its completion.
+     */
+    virtual auto IsPending(const handle_t qwHandle) -> bool = 0;
+
+    /**
+     * @brief Run the done function of every request that finished since
+     *        the last call.  Must be called from the main thread.
+     *
+     * @return Number of completions delivered.
+     */
+    virtual auto DeliverCompletions() -> size_t = 0;
+
+    /**
+     * @brief Watch every location for changes, including ones added later.
+     *
+     * @details Only does anything on platforms that can watch files.  Meant
+     *          for iterating on content, not for shipping games.
+     */
+    virtual auto SetHotReload(const bool bEnable) -> void = 0;
+
+    /**
+     * @brief Be told which assets changed on disk.
+     *
+     * @return Handle to unsubscribe with.
+     */
+    virtual auto Subscribe(changed_t &&fnChanged) -> handle_t = 0;
+    virtual auto Unsubscribe(const handle_t qwHandle) -> void = 0;
+
+    /**
+     * @brief Pick up file changes, if hot reload is on.  Must be called from
+     *        the main thread, before completions are delivered.
+     *
+     * @details Changes are batched until the files have been quiet for a
+     *          moment, so an editor saving a handful of files or a tool
+     *          rewriting a pack is one reload instead of several.  The
+     *          locations are then rescanned on a worker, and subscribers
+     *          are told about the changed assets as a completion.  A
+     *          changed pack counts as a change to every asset in it.
+     */
+    virtual auto PollChanges() -> void = 0;
+
+    /**
+     * @brief Load an asset in the background and hand the result to the
+     *        main thread.
+     *
+     * @param strPath Asset path to read.
+     * @param ePriority Where to put the request in the queue.
+     * @param fnLoad Turns the read result into a T, on a worker thread.
+     * @param fnDone Receives the T on the main thread.
+     * @return Handle of the request.
+     */
+    template <typename T>
+    auto LoadAsync(std::string_view strPath, const priority_e ePriority, std::function<T(viewResult_t &&)> fnLoad,
+                   std::function<void(T &&)> fnDone) -> handle_t
+    {
+        auto result = std::make_shared<std::optional<T>>();
+        return RequestAsync(
+            strPath, ePriority, [result, fnLoad](viewResult_t &&cRead) { result->emplace(fnLoad(std::move(cRead))); },
+            [result, fnDone] { fnDone(std::move(result->value())); });
+    }
 };
 
 auto GetAssets() -> Assets &;
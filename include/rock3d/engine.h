@@ -14,6 +14,15 @@ namespace rock3d
 class App
 {
   public:
+    /**
+     * @brief What to do when a frame can't run every tick it owes.
+     */
+    enum class catchUp_e
+    {
+        drop,   // Throw the extra time away, so the game skips ahead.
+        dilate, // Also slow game time down until frames keep up again.
+    };
+
     struct config_s
     {
         /**
@@ -22,7 +31,8 @@ class App
         const char *szName = nullptr;
 
         /**
-         * @brief Number of MS in a single frame.
+         * @brief Number of MS in a single frame.  Only used if qwTickRateNum
+         *        is zero.
          */
         uint64_t qwDeltaMS = 0;
 
@@ -30,19 +40,87 @@ class App
          * @brief Maximum number of MS a frame can take up.
          */
         uint64_t qwMaxMS = 0;
+
+        /**
+         * @brief Ticks per second, as the fraction qwTickRateNum over
+         *        qwTickRateDen.
+         *
+         * @details Ticks are timed in nanoseconds with no rounding, so 60
+         *          is exactly 60 ticks a second, where a qwDeltaMS of
+         *          1000 / 60 would be 62.5.  Rates that aren't whole
+         *          numbers, like 60000 / 1001, work too.
+         */
+        uint64_t qwTickRateNum = 0;
+        uint64_t qwTickRateDen = 1;
+
+        /**
+         * @brief Frames per second to hold the game to, or 0 to run as many
+         *        as the machine can manage.
+         *
+         * @details Time left over at the end of a frame is slept away instead
+         *          of being spent on another frame, so a capped game leaves
+         *          the CPU idle.  Can be changed later with SetMaxFPS.
+         */
+        uint32_t dwMaxFPS = 0;
+
+        /**
+         * @brief Only run a frame when there is input, a background load
+         *        finished, or the app asked for one with RequestFrame.
+         *
+         * @details Meant for tools, which sit idle most of the time.  Time
+         *          spent waiting isn't simulated, so ticks only run while
+         *          frames are coming in.
+         */
+        bool bEventDriven = false;
+
+        /**
+         * @brief Most ticks a single frame can run, or 0 for no limit.
+         *
+         * @details Without a limit, a machine that can't tick as fast as
+         *          real time spends longer and longer catching up, and
+         *          falls further behind every frame.  With one, ticks that
+         *          don't fit are handled by eCatchUp.  Dilating has nothing
+         *          to react to without a limit, so it uses a few ticks if
+         *          this is left at 0.
+         */
+        uint32_t dwMaxTicksPerFrame = 0;
+
+        /**
+         * @brief What to do with ticks that don't fit in a frame.
+         *
+         * @details Dropping makes the game jump whenever it falls behind.
+         *          Dilating slows game time down while it is behind, so a
+         *          slow machine plays the game evenly, but slower.
+         */
+        catchUp_e eCatchUp = catchUp_e::drop;
+
+        /**
+         * @brief Frames in a row that can skip rendering to spend the time
+         *        on ticks instead, or 0 to render every frame.
+         *
+         * @details Ticks are only dropped once a frame renders, so a game
+         *          that renders slowly gets a few frames to catch up on
+         *          ticks first.
+         */
+        uint32_t dwMaxFrameSkip = 0;
     };
 
     struct tickParams_s
     {
         uint64_t qwFrameCount = 0;
-        uint64_t qwGameTime = 0;
-        uint64_t qwDeltaTime = 0;
+        uint64_t qwGameTime = 0;   // In MS.
+        uint64_t qwDeltaTime = 0;  // In MS, rounded down.
+        uint64_t qwGameTimeNS = 0; // Exact time of this tick.
+        uint64_t qwDeltaNS = 0;    // Length of a tick, rounded down.
     };
 
     struct renderParams_s
     {
-        uint64_t qwAccumTime = 0;
-        uint64_t qwDeltaTime = 0;
+        uint64_t qwAccumTime = 0; // Time since the last tick, in MS.
+        uint64_t qwDeltaTime = 0; // Length of a tick, in MS.
+        uint64_t qwAccumNS = 0;   // Time since the last tick.
+        uint64_t qwDeltaNS = 0;   // Length of a tick.
+        float fAlpha = 0.0f;      // qwAccumNS over qwDeltaNS, which GetSnapshots().Blended() is blended by.
     };
 
     App() {}
@@ -57,8 +135,45 @@ class App
     virtual auto Shutdown() -> void = 0;
 };
 
+/**
+ * @brief How long the parts of a frame took, for profiling frame pacing.
+ */
+struct frameStats_s
+{
+    uint64_t qwFrames = 0;        // Frames run so far.
+    uint64_t qwTicks = 0;         // Ticks run so far.
+    uint32_t dwFrameTicks = 0;    // Ticks run by the last frame.
+    uint64_t qwFrameNS = 0;       // Time from the start of the last frame to the start of the one before it.
+    uint64_t qwEventNS = 0;       // Time the last frame spent on events and background loads.
+    uint64_t qwTickNS = 0;        // Time the last frame spent ticking.
+    uint64_t qwRenderNS = 0;      // Time the last frame spent rendering.
+    uint64_t qwSyncNS = 0;        // Time bgfx::frame spent waiting for the render thread, as of the last frame.
+    uint64_t qwAvgFrameNS = 0;    // Frame time, smoothed over the last few dozen frames.
+    uint64_t qwMaxFrameNS = 0;    // Longest frame so far.
+    uint64_t qwClampedNS = 0;     // Time thrown away because frames took longer than qwMaxMS, also in qwDroppedTicks.
+    uint64_t qwWaitNS = 0;        // Time the last frame spent idle, for the frame limit or for input.
+    uint64_t qwJitterNS = 0;      // How far the last frame was from the frame limit, or from the average without one.
+    uint64_t qwAvgJitterNS = 0;   // Jitter, smoothed over the last few dozen frames.
+    uint64_t qwMaxJitterNS = 0;   // Most jitter so far.
+    uint64_t qwLateFrames = 0;    // Frames that ran past the point the frame limit wanted the next one to start.
+    uint64_t qwLateTicks = 0;     // Ticks that ran a whole tick or more after they were due.
+    uint64_t qwDroppedTicks = 0;  // Ticks thrown away, past dwMaxTicksPerFrame or by the qwMaxMS clamp.
+    uint64_t qwSkippedFrames = 0; // Frames that skipped rendering to catch up on ticks.
+    float fTimeScale = 1.0f;      // Speed of game time against real time, below 1 while dilating.
+};
+
 /**
  * @brief Entry point of the game engine, using the defined app.
+ *
+ * @details The engine understands a few arguments of its own, for running
+ *          on servers and benchmarking:
+ *
+ *          -headless        No window, bgfx runs its Noop renderer.
+ *          -singlethreaded  Render on the main thread, inside bgfx::frame.
+ *          -norender        Never call App::Render.
+ *          -unpaced         Run one tick a frame as fast as possible, instead
+ *                           of keeping up with the clock.
+ *          -ticks <n>       Print timings and quit after n ticks.
  */
 [[noreturn]] auto EngineMain(const args_t &nstrArgs) -> void;
 
@@ -72,6 +187,25 @@ class App
  */
 auto AppConfig() -> const App::config_s &;
 
+/**
+ * @brief Timing of the last frame, and totals so far.
+ */
+auto FrameStats() -> const frameStats_s &;
+
+/**
+ * @brief Change the frame limit set by the app config.
+ *
+ * @param dwMaxFPS Frames per second, or 0 for no limit.
+ */
+auto SetMaxFPS(const uint32_t dwMaxFPS) -> void;
+
+/**
+ * @brief Run another frame even if no input arrives.  Only matters to apps
+ *        that are event driven, which should call it every frame while
+ *        something is animating.  Must be called from the main thread.
+ */
+auto RequestFrame() -> void;
+
 } // namespace rock3d
 
 /**
@@ -153,6 +153,33 @@ struct Level
     std::vector<Location> ncLocations;
 };
 
+/**
+ * @brief Every asset a level needs, so they can be loaded before the level
+ *        is built instead of one at a time while it is.
+ *
+ * @details Kept next to the level as a ".deps.json" file, which the pack
+ *          tool writes for every level it packs.  Sprites and sounds come
+ *          from the things in a level, which the level file does not know
+ *          about, so they can only come from a manifest file.
+ */
+struct LevelManifest
+{
+    /**
+     * Asset paths of wall, floor and ceiling textures.
+     */
+    std::vector<std::string> nstrTextures;
+
+    /**
+     * Asset paths of sprites.
+     */
+    std::vector<std::string> nstrSprites;
+
+    /**
+     * Asset paths of sounds.
+     */
+    std::vector<std::string> nstrSounds;
+};
+
 enum class loadLevelError_e
 {
     missing_asset,
@@ -161,12 +188,181 @@ enum class loadLevelError_e
 
 using loadLevelResult_t = nonstd::expected<Level, loadLevelError_e>;
 
+using levelPrefetch_t = std::function<void(const LevelManifest &)>;
+
+/**
+ * @brief Asset path of a texture named by a level.
+ */
+auto LevelTexturePath(const std::string_view strTexture) -> std::string;
+
+/**
+ * @brief Asset path of the manifest of a level.
+ */
+auto LevelManifestPath(const std::string_view strPath) -> std::string;
+
+/**
+ * @brief Build a manifest out of the textures a level uses.
+ */
+auto BuildLevelManifest(const Level &cLevel) -> LevelManifest;
+
+/**
+ * @brief Build a manifest out of the contents of a level file.
+ *
+ * @return Manifest, or nothing if the level could not be parsed.
+ */
+auto BuildLevelManifest(const nonstd::span<const uint8_t> cLevelFile) -> std::optional<LevelManifest>;
+
+/**
+ * @brief Turn a manifest into the contents of a manifest file.
+ */
+auto SerializeLevelManifest(const LevelManifest &cManifest) -> std::string;
+
+/**
+ * @brief Load the manifest of a level, or build one from the level itself
+ *        if it doesn't have one.
+ *
+ * @param strPath Asset filepath of the level.
+ * @return Manifest, or nothing if neither could be read.
+ */
+auto LoadLevelManifest(const std::string_view strPath) -> std::optional<LevelManifest>;
+
 /**
  * @brief Load a level from an asset path.
  *
+ * @details If fnPrefetch is passed, it is handed the manifest of the level
+ *          as early as possible, so it can start loading everything the
+ *          level needs while the level is parsed.  Levels without a
+ *          manifest file are parsed first and get one built for them.
+ *
  * @param strPath Asset filepath.
+ * @param fnPrefetch Function to start loading the assets of the level.
  * @return Constructed level, or error.
  */
-auto LoadLevelAsset(const std::string_view strPath) -> loadLevelResult_t;
+auto LoadLevelAsset(const std::string_view strPath, const levelPrefetch_t &fnPrefetch = {}) -> loadLevelResult_t;
+
+/**
+ * @brief Load a level in the background.  Reading, parsing and caching
+ *        tessellation all happen on a worker thread.
+ *
+ * @param strPath Asset filepath.
+ * @param ePriority Priority of the read.
+ * @param fnDone Receives the level, or error, on the main thread.
+ * @return Handle of the request.
+ */
+auto LoadLevelAssetAsync(const std::string_view strPath, const Assets::priority_e ePriority,
+                         std::function<void(loadLevelResult_t &&)> fnDone) -> Assets::handle_t;
+
+/**
+ * @brief Keeps the current level, and loads the next one in the background
+ *        while the current one runs.
+ *
+ * @details The next level is read, parsed and tessellated on a worker
+ *          thread, along with anything else the game builds out of it.
+ *          Swapping it in happens between ticks, and the level it replaces
+ *          is released a step at a time over the following frames, so
+ *          neither the load nor the unload causes a hitch.
+ *
+ *          With hot reload on, a level whose file changes is loaded again
+ *          the same way.  The current level is swapped for the new version
+ *          as soon as it is ready, unless another level is being preloaded.
+ */
+class Levels
+{
+  public:
+    /**
+     * @brief Data the game builds out of a level, such as vertex data ready
+     *        to upload.
+     */
+    class Payload
+    {
+      public:
+        Payload() {}
+        virtual ~Payload() {}
+        ROCK3D_NOCOPY(Payload);
+
+        /**
+         * @brief Release some of the payload.  Called once a frame on the
+         *        main thread after the level has been swapped out, until
+         *        it returns true, after which the payload is destroyed.
+         *
+         * @return True once there is nothing left to release.
+         */
+        virtual auto ReleaseStep() -> bool = 0;
+    };
+
+    /**
+     * @brief Builds the payload of a level.  Runs on a worker thread, right
+     *        after the level has been parsed.
+     */
+    using build_t = std::function<std::unique_ptr<Payload>(const Level &cLevel)>;
+
+    enum class preload_e
+    {
+        none,    // Nothing is being preloaded.
+        loading, // Next level is loading in the background.
+        ready,   // Next level is loaded, and can be swapped in.
+        failed,  // Next level could not be loaded.
+    };
+
+    Levels() {}
+    virtual ~Levels() {}
+    ROCK3D_NOCOPY(Levels);
+
+    /**
+     * @brief Start loading a level in the background, replacing any level
+     *        that was already preloaded.
+     *
+     * @param strPath Asset filepath of the level.
+     * @param fnBuild Builds the payload of the level, if passed.
+     */
+    virtual auto Preload(const std::string_view strPath, build_t &&fnBuild) -> void = 0;
+
+    /**
+     * @brief How far along the preloaded level is.
+     */
+    virtual auto PreloadState() -> preload_e = 0;
+
+    /**
+     * @brief Swap in the preloaded level at the next tick boundary after it
+     *        is ready.
+     */
+    virtual auto RequestSwap() -> void = 0;
+
+    /**
+     * @brief Current level, or nullptr if none has been swapped in.
+     */
+    virtual auto Current() -> const Level * = 0;
+
+    /**
+     * @brief Asset path of the current level, or empty if there is none.
+     */
+    virtual auto CurrentPath() -> std::string_view = 0;
+
+    /**
+     * @brief Payload of the current level, or nullptr if it has none.
+     */
+    virtual auto CurrentPayload() -> Payload * = 0;
+
+    /**
+     * @brief Number of old levels that are still being released.
+     */
+    virtual auto RetiredCount() -> size_t = 0;
+
+    /**
+     * @brief Swap in the preloaded level, if a swap was requested and the
+     *        level is ready.  The engine calls this before every tick.
+     *
+     * @return True if the current level changed.
+     */
+    virtual auto ApplySwap() -> bool = 0;
+
+    /**
+     * @brief Release part of the old levels.  The engine calls this once a
+     *        frame.
+     */
+    virtual auto ReleaseStep() -> void = 0;
+};
+
+auto GetLevels() -> Levels &;
 
 } // namespace rock3d
@@ -0,0 +1,121 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+#pragma once
+
+namespace rock3d
+{
+
+/**
+ * @brief A read-only archive of assets, kept in a single memory-mapped
+ *        file.
+ *
+ * @details The table of contents is sorted by a hash of the asset path, so
+ *          looking up an entry is a binary search that never touches the
+ *          filesystem.  The data of every entry starts on a 4K boundary, so
+ *          it lines up with the pages of the mapping.
+ *
+ *          Entries can be compressed with LZ4, which trades a little CPU
+ *          for a lot less disk bandwidth on things like level JSON and
+ *          uncompressed sounds.  Compressed entries are decompressed on
+ *          worker threads straight into the buffer that is handed back.
+ */
+class Pack
+{
+  public:
+    /**
+     * @brief File extension of pack archives.
+     */
+    static constexpr std::string_view EXTENSION = ".r3dpak";
+
+    enum class openError_e
+    {
+        file_not_found, // Pack could not be mapped.
+        bad_format,     // Pack is truncated, from another version, or not a pack.
+    };
+    using openResult_t = nonstd::expected<std::unique_ptr<Pack>, openError_e>;
+
+    /**
+     * @brief An asset to put in a pack.
+     */
+    struct entry_s
+    {
+        std::string strPath;
+        buffer_t cData;
+        bool bCompress = false; // Compress the entry, if that makes it meaningfully smaller.
+    };
+
+    /**
+     * @brief Totals for every compressed entry read so far.  The ratio of
+     *        unpacked to packed bytes is the compression ratio, and unpacked
+     *        bytes over work time is the decompression throughput.
+     */
+    struct stats_s
+    {
+        uint64_t qwEntries = 0;       // Number of entries decompressed.
+        uint64_t qwPackedBytes = 0;   // Bytes of compressed data read from the pack.
+        uint64_t qwUnpackedBytes = 0; // Bytes of asset data they decompressed to.
+        uint64_t qwWorkUS = 0;        // Time spent decompressing, summed over all entries.
+    };
+
+    Pack() {}
+    virtual ~Pack() {}
+    ROCK3D_NOCOPY(Pack);
+
+    /**
+     * @brief Number of entries in the pack.
+     */
+    virtual auto EntryCount() -> size_t = 0;
+
+    /**
+     * @brief Asset path of an entry, in table of contents order.
+     */
+    virtual auto EntryPath(const size_t qwIndex) -> std::string_view = 0;
+
+    /**
+     * @brief Copy the data of an asset out of the pack.
+     *
+     * @param strPath Asset path to read.
+     * @return Data of the asset, or nothing if the pack doesn't have it or
+     *         it could not be decompressed.
+     */
+    virtual auto Read(const std::string_view strPath) -> std::optional<buffer_t> = 0;
+
+    /**
+     * @brief Find the data of an asset, along with a handle that keeps the
+     *        mapping alive after the pack is gone.
+     *
+     * @details Uncompressed entries point straight into the mapped file.
+     *          Compressed entries are decompressed into a buffer owned by
+     *          the view.
+     *
+     * @param strPath Asset path to find.
+     * @return View of the asset, or nothing if the pack doesn't have it or
+     *         it could not be decompressed.
+     */
+    virtual auto FindView(const std::string_view strPath) -> std::optional<bufferView_s> = 0;
+
+    /**
+     * @brief Decompression totals of this pack.
+     */
+    virtual auto Stats() -> stats_s = 0;
+
+    /**
+     * @brief Map a pack file and read its table of contents.
+     *
+     * @param strFilePath Pack file to open.
+     */
+    static auto Open(const std::string_view strFilePath) -> openResult_t;
+
+    /**
+     * @brief Lay out the passed assets as a pack file.
+     *
+     * @param ncEntries Assets to pack.  Paths must be unique.
+     * @return Contents of the pack file.
+     */
+    static auto Build(const nonstd::span<const entry_s> ncEntries) -> buffer_t;
+};
+
+} // namespace rock3d
@@ -35,6 +35,8 @@ class Platform
     };
 
     using readResult_t = nonstd::expected<buffer_t, readError_e>;
+    using mapResult_t = nonstd::expected<bufferView_s, readError_e>;
+    using listResult_t = nonstd::expected<std::vector<std::string>, readError_e>;
 
     /**
      * @brief Initialize platform.
@@ -53,6 +55,13 @@ class Platform
      */
     virtual auto TimeMS() -> uint64_t = 0;
 
+    /**
+     * @brief A monotonic timer with nanosecond precision, or as close as
+     *        the platform gets.  Only differences between calls mean
+     *        anything.
+     */
+    virtual auto TimeNS() -> uint64_t = 0;
+
     /**
      * @brief Sleep this thread for no less than the passed number of
      *        milliseconds.
@@ -75,6 +84,13 @@ class Platform
      */
     virtual auto GetBasePath() -> std::string_view = 0;
 
+    /**
+     * @brief Get a per-user directory that we are allowed to write to.
+     *
+     * @details The returned path ends with a path separator.
+     */
+    virtual auto GetPrefPath() -> std::string_view = 0;
+
     /**
      * @brief Show a fatal error message, then quit.
      *
@@ -90,10 +106,80 @@ class Platform
      */
     virtual auto ReadFileToBuffer(const std::string_view strFilePath) -> readResult_t = 0;
 
+    /**
+     * @brief Read the contents of many files at once.
+     *
+     * @details Platforms that can batch their reads do so here, which is
+     *          much cheaper than one ReadFileToBuffer per file when there
+     *          are hundreds of them.
+     *
+     * @param nstrFilePaths Files to read.
+     * @return One result per file, in the order they were passed.
+     */
+    virtual auto ReadFilesToBuffers(const nonstd::span<const std::string_view> nstrFilePaths)
+        -> std::vector<readResult_t> = 0;
+
+    /**
+     * @brief Map the contents of a file into memory, read-only.
+     *
+     * @param strFilePath File to map.
+     * @return A view of the file's data, or an error on failure.
+     */
+    virtual auto MapFile(const std::string_view strFilePath) -> mapResult_t = 0;
+
+    /**
+     * @brief List every file under a directory, including subdirectories.
+     *
+     * @param strDirPath Directory to list.
+     * @return Paths of the files relative to the directory, with forward
+     *         slashes, or an error if the directory could not be read.
+     */
+    virtual auto ListFiles(const std::string_view strDirPath) -> listResult_t = 0;
+
+    /**
+     * @brief Start watching for changes to a file, or to every file under
+     *        a directory.
+     *
+     * @param strPath File or directory to watch.
+     * @return True if the platform can watch the path.
+     */
+    virtual auto WatchPath(const std::string_view strPath) -> bool = 0;
+
+    /**
+     * @brief Files under watched paths that were written, created, moved or
+     *        deleted since the last call.  Never blocks.
+     *
+     * @return Paths of the files, starting with the watched path they were
+     *         found under.  A file can show up more than once.
+     */
+    virtual auto PollChangedFiles() -> std::vector<std::string> = 0;
+
+    /**
+     * @brief Replace the contents of a file with the passed data.
+     *
+     * @details The file is written under a temporary name and then moved
+     *          into place, so readers never see a partially written file.
+     *
+     * @param strFilePath File to write.
+     * @param cData Data to write.
+     * @return True if the file was written.
+     */
+    virtual auto WriteFileFromBuffer(const std::string_view strFilePath, const nonstd::span<const uint8_t> cData)
+        -> bool = 0;
+
     /**
      * @brief Pump events into a form that we can use later.
      */
     virtual auto PumpEvents() -> void = 0;
+
+    /**
+     * @brief Sleep until an event arrives, without taking it off the
+     *        platform's queue.
+     *
+     * @param dwTimeoutMS Longest time to sleep for.
+     * @return True if an event is waiting to be pumped.
+     */
+    virtual auto WaitEvents(const uint32_t dwTimeoutMS) -> bool = 0;
 };
 
 auto GetPlatform() -> Platform &;
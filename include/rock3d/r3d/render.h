@@ -5,6 +5,87 @@
 
 #pragma once
 
-namespace rock3d::r3D{
+namespace rock3d::r3D
+{
 
-}
+class RenderContext
+{
+  public:
+    virtual ~RenderContext() {}
+
+    /**
+     * @brief Compile shaders and create uniforms.  Must be called after
+     *        bgfx is initialized, and before anything else.
+     */
+    virtual auto Init() -> bool = 0;
+
+    /**
+     * @brief Load a level, and every texture and sprite it needs.
+     *
+     * @details The textures are decoded on worker threads while the level
+     *          is parsed, so they are in the atlas by the time any of its
+     *          geometry is added.  The level is not drawn until it is
+     *          passed to AddLevel.
+     *
+     * @param strPath Asset path of the level.
+     */
+    virtual auto LoadLevel(const std::string_view strPath) -> loadLevelResult_t = 0;
+
+    /**
+     * @brief Add every wall of a level to the set of things to render.
+     *
+     * @return Number of walls added.  Walls whose texture is not in the
+     *         atlas are left out.
+     */
+    virtual auto AddLevel(const Level &cLevel) -> size_t = 0;
+
+    /**
+     * @brief Add a wall to the set of things to render.
+     *
+     * @param cOne First vertex.
+     * @param cTwo Second vertex.
+     * @param fZ1 Floor height.
+     * @param fZ2 Ceiling height.
+     * @param strTexture Asset path of the texture, which must be in the atlas.
+     * @param cBright Wall brightness.
+     */
+    virtual auto AddWall(const glm::vec2 &cOne, const glm::vec2 &cTwo, const float fZ1, const float fZ2,
+                         const std::string_view strTexture, const glm::vec3 &cBright) -> bool = 0;
+
+    /**
+     * @brief Submit every wall to a view.  Call once per frame, from the
+     *        main thread.
+     *
+     * @details Walls are recorded on worker threads and put back in order
+     *          by depth, so this sets the view mode of wView to
+     *          DepthAscending.  Give the world a view of its own rather
+     *          than sharing one with draws that need another mode.
+     *
+     * @param wView View to submit to.
+     * @param cViewProj View and projection matrix.
+     */
+    virtual auto SubmitWorld(const uint16_t wView, const glm::mat4 &cViewProj) -> void = 0;
+
+    /**
+     * @brief Walls that weren't drawn because bgfx ran out of transient
+     *        buffers, since the context was created.
+     *
+     * @details If this goes up, raise bgfx::Init::limits.transientVbSize
+     *          and transientIbSize.
+     */
+    virtual auto DroppedWalls() const -> size_t = 0;
+
+    /**
+     * @brief Totals for every texture loaded into the atlas, including how
+     *        many of them LoadLevel prefetched.
+     */
+    virtual auto TextureStats() -> const Textures::loadStats_s & = 0;
+
+    /**
+     * @brief Allocate a render context with an empty texture atlas of its
+     *        own.
+     */
+    static auto Alloc() -> std::unique_ptr<RenderContext>;
+};
+
+} // namespace rock3d::r3D
@@ -15,14 +15,344 @@ class Textures
     {
         size_t qwID = 0;
         std::string strName;
+        size_t qwPage = 0;
         glm::ivec2 cPixelSize;
         glm::vec2 cAtlasMin;
         glm::vec2 cAtlasMax;
     };
 
+    struct loadStats_s
+    {
+        size_t qwTextures = 0;       // Number of textures decoded.
+        uint64_t qwFileBytes = 0;    // Bytes of compressed image data read.
+        uint64_t qwPixelBytes = 0;   // Bytes of decoded atlas pixels.
+        uint64_t qwWallUS = 0;       // Wall clock time spent loading.
+        uint64_t qwWorkUS = 0;       // Time spent reading and decoding, summed over all threads.
+        size_t qwCacheHits = 0;      // Atlases loaded from the atlas cache.
+        size_t qwCacheMisses = 0;    // Atlases that had to be baked from scratch.
+        uint64_t qwEncodeUS = 0;     // Time spent block-compressing, summed over all threads.
+        uint64_t qwEncodedBytes = 0; // Bytes of block-compressed atlas data produced.
+        float fEncodeRMSE = 0.0f;    // Error of compressed pixels per channel, if measured.
+        size_t qwPrefetched = 0;     // Textures that were already decoded by Prefetch when added.
+        size_t qwReloaded = 0;       // Textures whose pixels were replaced by Reload.
+    };
+
+    /**
+     * @brief GPU formats of the atlas pages.
+     *
+     * @details Opaque and translucent textures are kept on separate pages
+     *          when their formats differ.  Pages are compressed on the CPU,
+     *          so check bgfx::getCaps() before picking a format the GPU
+     *          might not support.  RGBA8, BC1, BC3 and BC7 are supported.
+     */
+    struct compression_s
+    {
+        bgfx::TextureFormat::Enum eOpaque = bgfx::TextureFormat::RGBA8;
+        bgfx::TextureFormat::Enum eAlpha = bgfx::TextureFormat::RGBA8;
+        bool bHighQuality = false;  // Slower, better compression.
+        bool bMeasureError = false; // Decompress what we compressed to fill in fEncodeRMSE.
+    };
+
+    /**
+     * @brief Palette and light levels for paletted textures.
+     *
+     * @details The data is copied, so it only has to live as long as the
+     *          call to SetPalette.
+     */
+    struct palette_s
+    {
+        nonstd::span<const uint8_t> nPalette;  // 256 RGB triples.
+        nonstd::span<const uint8_t> nColormap; // Rows of 256 indexes, brightest first.  Empty to build one.
+        int iTransparent = -1;                 // Index that is see-through, or -1 for none.
+    };
+
+    /**
+     * @brief Memory limits of the atlas.
+     *
+     * @details CPU memory is the copy of every page we keep around to pack
+     *          new textures into and to compact from.  GPU memory is every
+     *          page that has been uploaded.
+     */
+    struct budget_s
+    {
+        uint64_t qwCPUBytes = UINT64_MAX; // Page data kept in memory.
+        uint64_t qwGPUBytes = UINT64_MAX; // Page data uploaded to the GPU.
+        uint64_t qwIdleFrames = 2;        // Frames a page must go unused before it can leave the GPU.
+    };
+
+    struct residencyStats_s
+    {
+        uint64_t qwCPUBytes = 0;    // Page and texture data in memory, as of the last ToGPU.
+        uint64_t qwGPUBytes = 0;    // Page data on the GPU, as of the last ToGPU.
+        size_t qwCPUEvictions = 0;  // Pages whose memory copy was dropped.
+        size_t qwGPUEvictions = 0;  // Pages that were taken off the GPU.
+        size_t qwReuploads = 0;     // Evicted pages that were uploaded again.
+        size_t qwReleasedPages = 0; // Pages freed because every texture on them was removed.
+        size_t qwOverBudget = 0;    // Calls to ToGPU that could not get under budget.
+    };
+
+    Textures() {}
+    virtual ~Textures() {}
+    ROCK3D_NOCOPY(Textures);
+
+    /**
+     * @brief Set the GPU formats of the atlas pages.
+     *
+     * @details Can only be changed before anything has been put in the
+     *          atlas.
+     *
+     * @return True if the formats were changed.
+     */
+    virtual auto SetCompression(const compression_s &cCompression) -> bool = 0;
+
+    /**
+     * @brief Store the atlas as 8-bit palette indexes.
+     *
+     * @details Textures are converted to the closest palette color while
+     *          they are decoded, and pixels with alpha below half become
+     *          the transparent index.  Lighting is done by picking a row
+     *          of the colormap, see the worldPaletted shader.  Can only be
+     *          set before any textures are loaded, and replaces any
+     *          compression settings.
+     *
+     * @return True if the palette was set.
+     */
+    virtual auto SetPalette(const palette_s &cPalette) -> bool = 0;
+
+    /**
+     * @brief Limit how much memory the atlas may use.
+     *
+     * @details Budgets are enforced by ToGPU, which evicts the pages that
+     *          were used the longest time ago.  A page taken off the GPU is
+     *          uploaded again the next time one of its textures is marked
+     *          as used.  A page that loses its memory copy stays on the GPU
+     *          for good, but no longer takes new textures or compacts, so
+     *          only pages that are fully uploaded can lose it.  A page can
+     *          never lose both, so the budgets are a target rather than a
+     *          guarantee, see residencyStats_s::qwOverBudget.
+     */
+    virtual auto SetBudget(const budget_s &cBudget) -> void = 0;
+
+    /**
+     * @brief Load a texture asset.
+     *
+     * @details Before the atlas is baked, textures are only queued up so
+     *          they can be packed together.  After the atlas is baked, the
+     *          texture is inserted into free atlas space right away, and
+     *          existing textures keep their coordinates.
+     *
+     *          Textures are reference counted.  Loading a texture that is
+     *          already loaded adds a reference to it, and every load must
+     *          be matched by a call to Remove.
+     *
+     * @param strAssetPath Asset path of the texture.
+     * @return True if the texture was loaded and has a place in the atlas.
+     */
     virtual auto AddAsset(const std::string_view strAssetPath) -> bool = 0;
+
+    /**
+     * @brief Load many texture assets at once.
+     *
+     * @details Files are read, decoded and converted to the atlas pixel
+     *          format on worker threads.  Textures are registered in the
+     *          order they were passed, so IDs do not depend on which thread
+     *          finished first.  Every texture in the batch gets one
+     *          reference, however many times it is listed.
+     *
+     * @param nstrAssetPaths Asset paths of the textures.
+     * @return True if every texture was loaded and has a place in the atlas.
+     */
+    virtual auto AddAssets(const nonstd::span<const std::string_view> nstrAssetPaths) -> bool = 0;
+
+    /**
+     * @brief Start reading and decoding textures in the background, ahead
+     *        of adding them.
+     *
+     * @details Returns right away.  A later AddAsset or AddAssets of a
+     *          prefetched texture takes the decoded pixels, waiting for them
+     *          if they are not done yet.  Decoded textures are held until
+     *          they are added, so only prefetch what is about to be used.
+     *
+     * @param nstrAssetPaths Asset paths of the textures.
+     */
+    virtual auto Prefetch(const nonstd::span<const std::string_view> nstrAssetPaths) -> void = 0;
+
+    /**
+     * @brief Pick up new versions of textures whose files changed.
+     *
+     * @details Returns right away.  The files are read and decoded in the
+     *          background, and the new pixels are swapped in by whichever
+     *          ToGPU finds them done, without waiting.  A texture that kept
+     *          its size is redrawn in place, so only its tile is uploaded
+     *          again.  One that changed size moves to a new place in the
+     *          atlas, which bumps AtlasGeneration.  Textures that aren't
+     *          loaded are ignored, and a file that can't be decoded leaves
+     *          the old pixels alone.
+     *
+     * @param nstrAssetPaths Asset paths of the textures.
+     * @return Number of textures that will be reloaded.
+     */
+    virtual auto Reload(const nonstd::span<const std::string_view> nstrAssetPaths) -> size_t = 0;
+
+    /**
+     * @brief Drop a reference to a texture, and remove it from the atlas
+     *        once nothing references it.
+     *
+     * @details The atlas space of the texture is not reused until the page
+     *          it lives on is compacted.  Pages that have nothing left on
+     *          them are freed by the next ToGPU.  The ID of a removed
+     *          texture never finds another one, even though a texture
+     *          added later can take over its slot.
+     *
+     * @param strAssetPath Asset path of the texture.
+     * @return True if the texture was found.
+     */
+    virtual auto Remove(const std::string_view strAssetPath) -> bool = 0;
+
+    /**
+     * @brief Pack all queued textures into the atlas.
+     */
     virtual auto BakeAtlas() -> bool = 0;
+
+    /**
+     * @brief Load the passed textures and bake them into an atlas, reusing
+     *        a previous bake from the on-disk cache if nothing changed.
+     *
+     * @details The cache is keyed by a hash of the texture paths, their
+     *          file contents and the atlas settings.  On a hit, decoding
+     *          and packing are skipped and the atlas pages are uploaded
+     *          straight from the memory-mapped cache file.  Pages loaded
+     *          from the cache only accept new textures after they have
+     *          been compacted.
+     *
+     *          Only an empty, unbaked atlas can be cached; otherwise this
+     *          is the same as AddAssets followed by BakeAtlas.
+     *
+     * @param nstrAssetPaths Asset paths of the textures.
+     * @return True if every texture was loaded and has a place in the atlas.
+     */
+    virtual auto BakeAtlasCached(const nonstd::span<const std::string_view> nstrAssetPaths) -> bool = 0;
+
+    /**
+     * @brief Upload atlas changes to the GPU.
+     *
+     * @details Only the parts of the atlas that changed since the last call
+     *          are uploaded.  Finished background compactions are applied
+     *          here, and new ones are started for fragmented pages.
+     *
+     *          Call this once per frame, after every texture that will be
+     *          drawn has been marked as used, since this is where evicted
+     *          pages come back and the memory budget is enforced.
+     */
     virtual auto ToGPU() -> void = 0;
+
+    /**
+     * @brief Mark a texture as used by the current frame, so its page stays
+     *        on the GPU.
+     *
+     * @param qwID ID of the texture.
+     */
+    virtual auto MarkUsed(const size_t qwID) -> void = 0;
+
+    /**
+     * @brief Mark an atlas page as used by the current frame, for callers
+     *        that already know which page their textures are on.
+     *
+     * @param qwPage Index of the page.
+     */
+    virtual auto MarkPageUsed(const size_t qwPage) -> void = 0;
+
+    /**
+     * @brief Number of atlas pages.
+     */
+    virtual auto PageCount() -> size_t = 0;
+
+    /**
+     * @brief GPU texture of an atlas page, if it has been uploaded and
+     *        has not been evicted.
+     */
+    virtual auto PageHandle(const size_t qwPage) -> bgfx::TextureHandle = 0;
+
+    /**
+     * @brief Width and height of every atlas page, in pixels.
+     */
+    virtual auto PageSize() -> size_t = 0;
+
+    /**
+     * @brief Number of mip levels of every atlas page that hold data.
+     *
+     * @details Every texture has a gutter of repeated pixels around it and
+     *          its own mip levels, so sampling never picks up neighbouring
+     *          textures.  The GPU textures have a full mip chain, so
+     *          shaders must clamp their LOD to MipLevels() - 1.
+     */
+    virtual auto MipLevels() -> size_t = 0;
+
+    /**
+     * @brief Sample a texture on the CPU, the same way the world shaders
+     *        do on the GPU.
+     *
+     * @details Meant for checking the atlas against a known result.
+     *          Paletted atlases return the palette color without any
+     *          lighting.
+     *
+     * @param qwID ID of the texture.
+     * @param cTexCoord Texture coordinate, where 1.0 is one repeat of the
+     *                  texture.
+     * @param fLod Level of detail, as computed by the shader.
+     * @return Color of the sampled texel, or nothing if the texture has no
+     *         place in the atlas or its page has no memory copy.
+     */
+    virtual auto SampleReference(const size_t qwID, const glm::vec2 &cTexCoord, const float fLod)
+        -> std::optional<glm::u8vec4> = 0;
+
+    /**
+     * @brief Check if the atlas holds palette indexes.
+     */
+    virtual auto IsPaletted() -> bool = 0;
+
+    /**
+     * @brief GPU texture of the palette, 256x1 RGBA8, once it has been
+     *        uploaded.
+     */
+    virtual auto PaletteHandle() -> bgfx::TextureHandle = 0;
+
+    /**
+     * @brief GPU texture of the colormap, 256 wide with one row per light
+     *        level, once it has been uploaded.
+     */
+    virtual auto ColormapHandle() -> bgfx::TextureHandle = 0;
+
+    /**
+     * @brief Number of light levels in the colormap.
+     */
+    virtual auto ColormapLevels() -> size_t = 0;
+
+    /**
+     * @brief Palette index that is see-through, or -1 for none.
+     */
+    virtual auto TransparentIndex() -> int = 0;
+
+    /**
+     * @brief A counter that increases every time the atlas coordinates of
+     *        existing textures change.
+     *
+     * @details Anything that caches atlas coordinates should rebuild when
+     *          this value changes.
+     */
+    virtual auto AtlasGeneration() -> uint64_t = 0;
+
+    /**
+     * @brief Totals for all textures loaded so far, for measuring decode
+     *        throughput.
+     */
+    virtual auto LoadStats() -> const loadStats_s & = 0;
+
+    /**
+     * @brief Memory use and eviction counts of the atlas.
+     */
+    virtual auto ResidencyStats() -> const residencyStats_s & = 0;
+
     virtual auto FindByID(const size_t qwID) -> const texInfo_s * = 0;
     virtual auto FindByName(const std::string_view strAssetPath) -> const texInfo_s * = 0;
 
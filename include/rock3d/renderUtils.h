@@ -6,6 +6,36 @@
 namespace rock3d
 {
 
+/**
+ * @brief Hand a view over to bgfx without copying it.
+ *
+ * @param cView View to pass along.  bgfx keeps a reference to the owner
+ *              until it is done with the data.
+ * @return Memory that can be passed to any bgfx function.
+ */
+auto ViewToMemory(const bufferView_s &cView) -> const bgfx::Memory *;
+
+/**
+ * @brief Asset paths of the compiled vertex and fragment shader of a
+ *        shader program.
+ *
+ * @param strShaderDir Path to the directory containing the shader source.
+ */
+auto ShaderProgramFiles(const std::string_view strShaderDir) -> std::array<std::string, 2>;
+
+/**
+ * @brief A shader program handle, or what went wrong.
+ */
+using shaderResult_t = nonstd::expected<bgfx::ProgramHandle, std::string>;
+
+/**
+ * @brief Compile a shader program, without giving up if it fails.  Used to
+ *        reload shaders that were edited while the game runs.
+ *
+ * @param strShaderDir Path to the directory containing the shader source.
+ */
+auto ShaderTryCompileProgram(const std::string_view strShaderDir) -> shaderResult_t;
+
 /**
  * @brief Compile a shader program.
  *
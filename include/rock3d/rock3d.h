@@ -7,12 +7,26 @@
 
 #include <cstdint>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <random>
+#include <shared_mutex>
 #include <string_view>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 
@@ -38,17 +52,30 @@
 namespace rock3d
 {
 using buffer_t = std::vector<uint8_t>;
-}
+
+/**
+ * @brief Read-only bytes owned by someone else, such as a memory-mapped
+ *        file.  The bytes stay valid for as long as the owner handle lives.
+ */
+struct bufferView_s
+{
+    nonstd::span<const uint8_t> cSpan;
+    std::shared_ptr<const void> pOwner;
+};
+} // namespace rock3d
 
 #include "./util.h"
 #include "./event.h"
-#include "./level.h"
 #include "./mathlib.h"
 #include "./random.h"
+#include "./workers.h"
 
 #include "./platform.h"
 
+#include "./pack.h"
 #include "./assets.h"
+#include "./level.h"
+#include "./snapshots.h"
 #include "./engine.h"
 #include "./renderUtils.h"
 #include "./r3d/textures.h"
@@ -0,0 +1,134 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+#pragma once
+
+namespace rock3d
+{
+
+/**
+ * @brief What the game looks like as of the last two ticks, so frames that
+ *        land between ticks can be drawn between them.
+ *
+ * @details The app writes what it wants drawn while it ticks.  Before every
+ *          tick the engine keeps a copy of the state as the previous one,
+ *          and before every frame it blends the previous and current state
+ *          by how far the frame is into the next tick.  What is drawn is
+ *          always up to a tick behind the simulation, in exchange for
+ *          motion that looks smooth at any frame rate.
+ *
+ *          Anything the app doesn't write during a tick carries over.  The
+ *          state is kept as parallel arrays, indexed by entity slot or by
+ *          polygon, so blending is a handful of straight loops.
+ */
+class Snapshots
+{
+  public:
+    struct camera_s
+    {
+        glm::vec3 cPosition;
+        glm::quat cRotation;
+    };
+
+    struct state_s
+    {
+        camera_s cCamera;
+        uint32_t dwCameraCut = 0;           // Bumped when the camera jumps.
+        std::vector<glm::vec3> ncPositions; // Entity position, by slot.
+        std::vector<glm::quat> ncRotations; // Entity rotation, by slot.
+        std::vector<uint32_t> ndwCuts;      // Bumped when an entity jumps.
+        std::vector<uint8_t> nbLive;        // Nonzero if the slot is in use.
+        std::vector<float> nfFloorHeights;  // By polygon.
+        std::vector<float> nfCeilHeights;   // By polygon.
+    };
+
+    Snapshots() {}
+    virtual ~Snapshots() {}
+    ROCK3D_NOCOPY(Snapshots);
+
+    /**
+     * @brief Move the camera.
+     */
+    virtual auto SetCamera(const glm::vec3 &cPosition, const glm::quat &cRotation) -> void = 0;
+
+    /**
+     * @brief Don't blend the camera from where it was last tick, because it
+     *        teleported or switched to another view.
+     */
+    virtual auto CutCamera() -> void = 0;
+
+    /**
+     * @brief Move an entity, putting it in the slot if it isn't already.
+     *
+     * @details Slots are the app's to hand out.  Keep them small and reuse
+     *          them, since the arrays are as long as the highest slot.
+     */
+    virtual auto SetEntity(const size_t qwSlot, const glm::vec3 &cPosition, const glm::quat &cRotation) -> void = 0;
+
+    /**
+     * @brief Don't blend an entity from where it was last tick.
+     */
+    virtual auto CutEntity(const size_t qwSlot) -> void = 0;
+
+    /**
+     * @brief Take an entity out of its slot.
+     */
+    virtual auto RemoveEntity(const size_t qwSlot) -> void = 0;
+
+    /**
+     * @brief Move the floor and ceiling of a polygon, like a door or a lift.
+     */
+    virtual auto SetPolygon(const size_t qwPolygon, const float fFloorHeight, const float fCeilHeight) -> void = 0;
+
+    /**
+     * @brief Don't blend anything from last tick.  The engine does this
+     *        when it swaps levels.
+     */
+    virtual auto CutAll() -> void = 0;
+
+    /**
+     * @brief Forget every entity and polygon.
+     */
+    virtual auto Clear() -> void = 0;
+
+    /**
+     * @brief Keep the current state as the previous one.  The engine calls
+     *        this before every tick.
+     */
+    virtual auto Advance() -> void = 0;
+
+    /**
+     * @brief Blend the previous and current state.  The engine calls this
+     *        before every frame.
+     *
+     * @param fAlpha How far the frame is between the last tick and the
+     *               next, from 0 to 1.
+     */
+    virtual auto Blend(const float fAlpha) -> void = 0;
+
+    /**
+     * @brief State as of the tick before the last one.
+     */
+    virtual auto Previous() -> const state_s & = 0;
+
+    /**
+     * @brief State as of the last tick.
+     */
+    virtual auto Current() -> const state_s & = 0;
+
+    /**
+     * @brief State to draw this frame.
+     */
+    virtual auto Blended() -> const state_s & = 0;
+
+    /**
+     * @brief Alpha that the blended state was blended with.
+     */
+    virtual auto Alpha() -> float = 0;
+};
+
+auto GetSnapshots() -> Snapshots &;
+
+} // namespace rock3d
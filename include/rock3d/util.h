@@ -25,4 +25,21 @@ auto BitCast(const SRC &src) noexcept
     return dst;
 }
 
+/**
+ * @brief 64-bit FNV-1a hash.
+ *
+ * @param cData Data to hash.
+ * @param qwSeed Hash to continue from, for hashing several pieces of data
+ *               as if they were one.
+ */
+inline auto HashFNV1a64(const nonstd::span<const uint8_t> cData, uint64_t qwSeed = 0xcbf29ce484222325) -> uint64_t
+{
+    for (const uint8_t byte : cData)
+    {
+        qwSeed ^= byte;
+        qwSeed *= 0x100000001b3;
+    }
+    return qwSeed;
+}
+
 } // namespace rock3d
@@ -0,0 +1,140 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+#pragma once
+
+namespace rock3d
+{
+
+/**
+ * @brief A pool of worker threads for work that can be done off the main
+ *        thread.
+ *
+ * @details Every worker has its own queue.  Jobs a worker submits go on
+ *          its own queue and are run newest first, which keeps their data
+ *          in cache, and a worker that runs dry steals the oldest jobs off
+ *          the others.  Jobs submitted from outside the pool are dealt out
+ *          to the queues in turn.
+ *
+ *          The pool belongs to the thread that first calls GetWorkers,
+ *          which the engine makes sure is the main thread.
+ */
+class Workers
+{
+  public:
+    using task_t = std::function<void()>;
+
+    /**
+     * @brief Number of jobs in a group that have yet to finish.
+     */
+    struct counter_s;
+    using counter_t = std::shared_ptr<counter_s>;
+
+    Workers() {}
+    virtual ~Workers() {}
+    ROCK3D_NOCOPY(Workers);
+
+    /**
+     * @brief Number of worker threads in the pool.
+     */
+    virtual auto ThreadCount() -> size_t = 0;
+
+    /**
+     * @brief Queue a task to be run on a worker thread.
+     *
+     * @param fnTask Task to run.
+     */
+    virtual auto Submit(task_t &&fnTask) -> void = 0;
+
+    /**
+     * @brief Make a counter to group jobs with.
+     */
+    virtual auto MakeCounter() -> counter_t = 0;
+
+    /**
+     * @brief Queue a task as part of a group, to run once another group
+     *        has finished.
+     *
+     * @param fnTask Task to run.
+     * @param cAfter Counter that has to reach zero before the task starts,
+     *               or nullptr to start right away.
+     * @param cDone Counter the task is part of, or nullptr.  It counts the
+     *              task from now until the task has finished.
+     */
+    virtual auto Submit(task_t &&fnTask, const counter_t &cAfter, const counter_t &cDone) -> void = 0;
+
+    /**
+     * @brief Queue a task that has to run on the main thread, like anything
+     *        that calls bgfx.
+     *
+     * @details Main thread tasks run when the engine calls RunMainJobs once
+     *          a frame, or while the main thread waits on a counter.
+     *
+     * @param fnTask Task to run.
+     * @param cAfter Counter that has to reach zero before the task starts,
+     *               or nullptr to start right away.
+     * @param cDone Counter the task is part of, or nullptr.
+     */
+    virtual auto SubmitMain(task_t &&fnTask, const counter_t &cAfter, const counter_t &cDone) -> void = 0;
+
+    /**
+     * @brief Run every main thread task that is ready.  Must be called from
+     *        the main thread.
+     *
+     * @return Number of tasks run.
+     */
+    virtual auto RunMainJobs() -> size_t = 0;
+
+    /**
+     * @brief Check if every task in a group has finished.
+     */
+    virtual auto IsDone(const counter_t &cCounter) -> bool = 0;
+
+    /**
+     * @brief Wait for every task in a group to finish.
+     *
+     * @details The waiting thread runs other tasks in the meantime, so this
+     *          is safe to call from inside a task.  For the same reason,
+     *          don't call it while holding a lock that a task might need.
+     */
+    virtual auto Wait(const counter_t &cCounter) -> void = 0;
+
+    /**
+     * @brief Call a function once for every index in [0, qwCount), spread
+     *        out over the pool, and wait for all calls to finish.
+     *
+     * @details The calling thread helps out, so this is safe to call from
+     *          inside a task.  Calls may happen in any order.  Unlike Wait,
+     *          the caller never runs unrelated tasks, so holding a lock
+     *          across this is fine.
+     *
+     * @param qwCount Number of indexes.
+     * @param fnFunc Function to call with each index.
+     */
+    virtual auto ParallelFor(const size_t qwCount, const std::function<void(size_t)> &fnFunc) -> void = 0;
+
+    /**
+     * @brief Split a span into chunks and call a function with each one,
+     *        spread out over the pool.
+     *
+     * @param nItems Items to split up.
+     * @param qwChunk Items per chunk, or 0 to make a few chunks per thread.
+     * @param fnFunc Function to call with each chunk.
+     */
+    template <typename T, typename FUNC>
+    auto ParallelFor(const nonstd::span<T> nItems, const size_t qwChunk, const FUNC &fnFunc) -> void
+    {
+        const size_t chunk = qwChunk != 0 ? qwChunk : std::max<size_t>(1, nItems.size() / ((ThreadCount() + 1) * 4));
+        const size_t chunks = (nItems.size() + chunk - 1) / chunk;
+        ParallelFor(chunks, [&nItems, &fnFunc, chunk](const size_t i) {
+            const size_t start = i * chunk;
+            fnFunc(nItems.subspan(start, std::min(chunk, nItems.size() - start)));
+        });
+    }
+};
+
+auto GetWorkers() -> Workers &;
+
+} // namespace rock3d
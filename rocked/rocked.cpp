@@ -10,9 +10,42 @@ namespace rocked
 
 class EditorApp final : public rock3d::App
 {
-    static constexpr rock3d::App::config_s CONFIG{u8"rocked", 1000 / 60, 1000 / 4};
+    // Only redraws when something happens, so an idle editor doesn't keep
+    // a core busy.
+    static constexpr rock3d::App::config_s CONFIG{u8"rocked", 1000 / 60, 1000 / 4, 60, 1, 60, true};
 
     RockImGui m_cRockImGui;
+    std::unique_ptr<rock3d::r3D::RenderContext> m_pRender;
+    glm::vec3 m_cEye{0.0f, 0.0f, 0.0f};
+    glm::vec3 m_cForward{0.0f, 1.0f, 0.0f};
+
+    /**
+     * Load a level to show behind the UI, looking out from its first
+     * player spawn.
+     */
+    auto LoadLevel(const std::string_view strPath) -> void
+    {
+        auto maybeLevel = m_pRender->LoadLevel(strPath);
+        if (!maybeLevel.has_value())
+        {
+            return;
+        }
+
+        const rock3d::Level &level = maybeLevel.value();
+        const size_t walls = m_pRender->AddLevel(level);
+        const auto &stats = m_pRender->TextureStats();
+        fmt::print("{}: {} walls, {} textures, {} prefetched, loaded in {:.3f}ms\n", strPath, walls, stats.qwTextures,
+                   stats.qwPrefetched, double(stats.qwWallUS) / 1000.0);
+        for (const rock3d::Location &location : level.ncLocations)
+        {
+            if (location.strType == "playerSpawn")
+            {
+                m_cEye = location.cPosition + glm::vec3{0.0f, 0.0f, 41.0f};
+                m_cForward = location.cRotation * glm::vec3{1.0f, 0.0f, 0.0f};
+                break;
+            }
+        }
+    }
 
   public:
     auto Config() -> const rock3d::App::config_s & override
@@ -24,23 +57,36 @@ class EditorApp final : public rock3d::App
     {
         rock3d::GetAssets().AddPath(std::string(rock3d::GetPlatform().GetBasePath()) + "../assets");
         rock3d::GetAssets().AddPath(std::string(rock3d::GetPlatform().GetBasePath()) + "assets");
+        rock3d::GetAssets().AddPath(std::string(rock3d::GetPlatform().GetBasePath()) + "assets.r3dpak");
+
+        // The editor is where content gets iterated on.
+        rock3d::GetAssets().SetHotReload(true);
 
         ImGui::CreateContext();
 
         ImGuiViewport *main_viewport = ImGui::GetMainViewport();
         main_viewport->PlatformHandleRaw = rock3d::GetPlatform().WindowHandle();
 
-        m_cRockImGui.Init(0);
+        // The world gets view 0, which the platform clears every frame,
+        // and the UI is drawn over it.
+        m_pRender = rock3d::r3D::RenderContext::Alloc();
+        m_pRender->Init();
+        LoadLevel("map/TESTMAP.json");
+
+        m_cRockImGui.Init(1);
     }
 
     auto HandleEvent(const rock3d::event_t &cEvent) -> void override
     {
         m_cRockImGui.HandleEvent(cEvent);
+
+        // ImGui lays out a frame behind its input, so give it a frame to
+        // catch up.
+        rock3d::RequestFrame();
     }
 
     auto Tick(const tickParams_s &cParams) -> void override
     {
-        auto level = rock3d::LoadLevelAsset("maps/TESTMAP.json");
     }
 
     auto Render(const renderParams_s &cParams) -> void override
@@ -50,6 +96,11 @@ class EditorApp final : public rock3d::App
         io.DisplaySize.x = res.x;
         io.DisplaySize.y = res.y;
 
+        const float aspect = float(res.x) / float(std::max(res.y, 1));
+        const glm::mat4 proj = glm::perspective(glm::radians(90.0f), aspect, 1.0f, 65536.0f);
+        const glm::mat4 view = glm::lookAt(m_cEye, m_cEye + m_cForward, glm::vec3{0.0f, 0.0f, 1.0f});
+        m_pRender->SubmitWorld(0, proj * view);
+
         m_cRockImGui.NewFrame();
         ImGui::NewFrame();
         ImGui::ShowDemoWindow();
@@ -62,6 +113,7 @@ class EditorApp final : public rock3d::App
     auto Shutdown() -> void override
     {
         m_cRockImGui.Shutdown();
+        m_pRender.reset();
     }
 };
 
@@ -7,6 +7,7 @@
 
 #include "rock3d/rock3d.h"
 
+#include "glm/gtc/matrix_transform.hpp"
 #include "imgui.h"
 
 #include "imgui_rock3d.h"
@@ -35,18 +35,366 @@ static bool ContainsParentDir(const std::string_view strPath)
     return false;
 }
 
+/**
+ * @brief Turn an asset path into the form the index uses, without empty
+ *        or "." parts, so "./maps//e1m1.json" finds "maps/e1m1.json".
+ */
+static auto NormalizePath(const std::string_view strPath) -> std::string
+{
+    std::string rvo;
+    rvo.reserve(strPath.size());
+    size_t start = 0;
+    while (start <= strPath.size())
+    {
+        const size_t end = std::min(strPath.find('/', start), strPath.size());
+        const std::string_view part = strPath.substr(start, end - start);
+        if (!part.empty() && part != ".")
+        {
+            if (!rvo.empty())
+            {
+                rvo += '/';
+            }
+            rvo += part;
+        }
+        start = end + 1;
+    }
+    return rvo;
+}
+
 class AssetsImpl final : public Assets
 {
     struct resLoc_s
     {
         std::string location;
+        bool bPack = false;
+        std::unique_ptr<Pack> pPack; // Set if the location is a pack file that could be opened.
     };
     std::vector<resLoc_s> m_ncResLocs;
+    std::unordered_map<std::string, size_t> m_cIndex; // Asset path to the location that has it.
+    std::shared_mutex m_cMutex;
+
+    struct request_s
+    {
+        handle_t qwHandle = 0;
+        priority_e ePriority = priority_e::normal;
+        std::string strPath;
+        work_t fnWork;
+        done_t fnDone;
+    };
+
+    /**
+     * @brief Heap order of queued requests, highest priority on top, then
+     *        oldest first.
+     */
+    static auto QueueOrder(const request_s &cA, const request_s &cB) -> bool
+    {
+        if (cA.ePriority != cB.ePriority)
+        {
+            return cA.ePriority < cB.ePriority;
+        }
+        return cA.qwHandle > cB.qwHandle;
+    }
+
+    std::mutex m_cAsyncMutex;
+    std::vector<request_s> m_ncQueued;                 // Heap ordered by QueueOrder.
+    std::unordered_set<handle_t> m_cPending;           // Requests that have not delivered yet.
+    std::vector<std::pair<handle_t, done_t>> m_ncDone; // Finished, waiting for the main thread.
+    handle_t m_qwNextHandle = 1;
+    std::vector<std::pair<handle_t, changed_t>> m_ncSubscribers;
+
+    /**
+     * @brief How long files have to be quiet before a batch of changes is
+     *        reloaded.
+     */
+    static constexpr auto SETTLE_TIME = std::chrono::milliseconds(100);
+
+    bool m_bHotReload = false;
+    std::atomic<bool> m_bWatching = false;           // Every location is being watched for changes.
+    bool m_bReloading = false;                       // A rescan is running, or waiting to deliver.
+    std::unordered_set<std::string> m_cChangedFiles; // Full paths of files changed since the last reload.
+    std::chrono::steady_clock::time_point m_cLastChange;
+
+    /**
+     * @brief Read and work on the most important queued request.
+     *
+     * @details One of these is submitted to the workers for every request,
+     *          but they don't care which request they get, so a request
+     *          made later with a higher priority goes first.
+     */
+    auto RunQueued() -> void
+    {
+        request_s request;
+        {
+            std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+            if (m_ncQueued.empty())
+            {
+                // Cancelled before we got to it.
+                return;
+            }
+            std::pop_heap(m_ncQueued.begin(), m_ncQueued.end(), QueueOrder);
+            request = std::move(m_ncQueued.back());
+            m_ncQueued.pop_back();
+        }
+
+        if (request.fnWork)
+        {
+            request.fnWork(ReadToView(request.strPath));
+        }
+
+        std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+        if (m_cPending.find(request.qwHandle) != m_cPending.end())
+        {
+            m_ncDone.emplace_back(request.qwHandle, std::move(request.fnDone));
+        }
+    }
+
+    static auto IsPackPath(const std::string_view strPath) -> bool
+    {
+        const std::string_view ext = Pack::EXTENSION;
+        return strPath.size() >= ext.size() && strPath.substr(strPath.size() - ext.size()) == ext;
+    }
+
+    /**
+     * @brief Add every file of a location to an index, unless an earlier
+     *        location already has it.
+     *
+     * @details Locations that are missing or broken add nothing, but stay
+     *          around in case they show up by the next rescan.
+     */
+    static auto IndexLocation(resLoc_s &cLoc, const size_t qwLoc, std::unordered_map<std::string, size_t> &cIndex)
+        -> void
+    {
+        if (cLoc.bPack)
+        {
+            auto maybePack = Pack::Open(cLoc.location);
+            cLoc.pPack = maybePack.has_value() ? std::move(maybePack.value()) : nullptr;
+            if (!cLoc.pPack)
+            {
+                return;
+            }
+            for (size_t i = 0; i < cLoc.pPack->EntryCount(); i++)
+            {
+                cIndex.emplace(NormalizePath(cLoc.pPack->EntryPath(i)), qwLoc);
+            }
+            return;
+        }
+
+        auto maybeFiles = GetPlatform().ListFiles(cLoc.location);
+        if (!maybeFiles.has_value())
+        {
+            return;
+        }
+        for (auto &file : maybeFiles.value())
+        {
+            cIndex.emplace(NormalizePath(file), qwLoc);
+        }
+    }
+
+    /**
+     * @brief Turn changed files into the asset paths they affect.
+     *
+     * @details A file that an earlier location shadows affects nothing.
+     *          Files that were deleted are still reported, so anything
+     *          made from them can notice they're gone.
+     */
+    auto ChangedAssets(const nonstd::span<const std::string> nstrFiles) -> std::vector<std::string>
+    {
+        std::shared_lock<std::shared_mutex> lock(m_cMutex);
+        std::vector<std::string> rvo;
+        for (auto &file : nstrFiles)
+        {
+            for (size_t i = 0; i < m_ncResLocs.size(); i++)
+            {
+                const resLoc_s &resloc = m_ncResLocs[i];
+                if (resloc.bPack)
+                {
+                    if (file != resloc.location || !resloc.pPack)
+                    {
+                        continue;
+                    }
+                    for (size_t j = 0; j < resloc.pPack->EntryCount(); j++)
+                    {
+                        std::string path{resloc.pPack->EntryPath(j)};
+                        auto it = m_cIndex.find(path);
+                        if (it != m_cIndex.end() && it->second == i)
+                        {
+                            rvo.push_back(std::move(path));
+                        }
+                    }
+                    continue;
+                }
+
+                const std::string_view dir = resloc.location;
+                if (file.size() <= dir.size() + 1 || file.compare(0, dir.size(), dir) != 0 || file[dir.size()] != '/')
+                {
+                    continue;
+                }
+                std::string path = NormalizePath(std::string_view(file).substr(dir.size() + 1));
+                auto it = m_cIndex.find(path);
+                if (it == m_cIndex.end() || it->second == i)
+                {
+                    rvo.push_back(std::move(path));
+                }
+            }
+        }
+
+        std::sort(rvo.begin(), rvo.end());
+        rvo.erase(std::unique(rvo.begin(), rvo.end()), rvo.end());
+        return rvo;
+    }
+
+    /**
+     * @brief Tell every subscriber about changed assets.
+     */
+    auto NotifyChanged(const nonstd::span<const std::string> nstrPaths) -> void
+    {
+        // Subscribers are free to subscribe or unsubscribe.
+        std::vector<std::pair<handle_t, changed_t>> subscribers;
+        {
+            std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+            subscribers = m_ncSubscribers;
+        }
+        for (auto &[handle, fnChanged] : subscribers)
+        {
+            fnChanged(nstrPaths);
+        }
+    }
+
+    /**
+     * @brief Find the location that has an asset.  The caller must hold
+     *        the lock.
+     *
+     * @param strPath Asset path, from NormalizePath.
+     */
+    auto Lookup(const std::string &strPath) -> const resLoc_s *
+    {
+        auto it = m_cIndex.find(strPath);
+        if (it == m_cIndex.end())
+        {
+            return nullptr;
+        }
+        return &m_ncResLocs[it->second];
+    }
+
+    /**
+     * @brief Look for an asset the index missed in every directory, and
+     *        add it to the index if it turns up.  The caller must not hold
+     *        the lock.
+     *
+     * @details Without a watcher, nothing else would notice files that
+     *          were created after their location was indexed.  With one,
+     *          a miss is a real miss, since new files are picked up by the
+     *          rescan that follows the change.  Packs never change, so
+     *          they are not looked in.
+     *
+     * @param strPath Asset path, from NormalizePath.
+     * @return True if the asset was found.
+     */
+    auto Probe(const std::string &strPath) -> bool
+    {
+        if (m_bWatching)
+        {
+            return false;
+        }
+
+        std::vector<std::pair<size_t, std::string>> dirs;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_cMutex);
+            for (size_t i = 0; i < m_ncResLocs.size(); i++)
+            {
+                if (!m_ncResLocs[i].bPack)
+                {
+                    dirs.emplace_back(i, m_ncResLocs[i].location);
+                }
+            }
+        }
+
+        for (auto &[loc, dir] : dirs)
+        {
+            if (GetPlatform().MapFile(fmt::format("{}/{}", dir, strPath)).has_value())
+            {
+                std::unique_lock<std::shared_mutex> lock(m_cMutex);
+                m_cIndex.emplace(strPath, loc);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Lookup, probing the filesystem on a miss.
+     *
+     * @param cLock Shared lock on m_cMutex, which is held on return.
+     * @param strPath Asset path, from NormalizePath.
+     */
+    auto LookupOrProbe(std::shared_lock<std::shared_mutex> &cLock, const std::string &strPath) -> const resLoc_s *
+    {
+        const resLoc_s *rvo = Lookup(strPath);
+        if (rvo != nullptr)
+        {
+            return rvo;
+        }
+
+        cLock.unlock();
+        const bool found = Probe(strPath);
+        cLock.lock();
+        return found ? Lookup(strPath) : nullptr;
+    }
 
   public:
     auto AddPath(const std::string_view strPath) -> void override
     {
-        m_ncResLocs.push_back(resLoc_s{std::string{strPath}});
+        std::unique_lock<std::shared_mutex> lock(m_cMutex);
+        m_ncResLocs.push_back(resLoc_s{std::string{strPath}, IsPackPath(strPath), nullptr});
+        IndexLocation(m_ncResLocs.back(), m_ncResLocs.size() - 1, m_cIndex);
+        if (m_bHotReload && !GetPlatform().WatchPath(strPath))
+        {
+            m_bWatching = false;
+        }
+    }
+
+    auto Rescan() -> void override
+    {
+        // The filesystem is walked without holding the lock, so reads carry
+        // on from the old index until the new one is swapped in.
+        std::vector<resLoc_s> reslocs;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_cMutex);
+            for (auto &resloc : m_ncResLocs)
+            {
+                reslocs.push_back(resLoc_s{resloc.location, resloc.bPack, nullptr});
+            }
+        }
+        std::unordered_map<std::string, size_t> index;
+        for (size_t i = 0; i < reslocs.size(); i++)
+        {
+            IndexLocation(reslocs[i], i, index);
+        }
+
+        // Views of the old packs keep their mappings alive.
+        std::unique_lock<std::shared_mutex> lock(m_cMutex);
+        for (size_t i = 0; i < reslocs.size(); i++)
+        {
+            m_ncResLocs[i].pPack = std::move(reslocs[i].pPack);
+        }
+        m_cIndex = std::move(index);
+        for (size_t i = reslocs.size(); i < m_ncResLocs.size(); i++)
+        {
+            // Added while we were scanning.
+            IndexLocation(m_ncResLocs[i], i, m_cIndex);
+        }
+    }
+
+    auto Exists(const std::string_view strPath) -> bool override
+    {
+        if (ContainsParentDir(strPath))
+        {
+            return false;
+        }
+
+        const std::string path = NormalizePath(strPath);
+        std::shared_lock<std::shared_mutex> lock(m_cMutex);
+        return LookupOrProbe(lock, path) != nullptr;
     }
 
     auto ReadToBuffer(const std::string_view strPath) -> readResult_t override
@@ -55,16 +403,324 @@ class AssetsImpl final : public Assets
         {
             return nonstd::make_unexpected(readError_e::invalid_path);
         }
+
+        const std::string path = NormalizePath(strPath);
+        std::shared_lock<std::shared_mutex> lock(m_cMutex);
+        const resLoc_s *resloc = LookupOrProbe(lock, path);
+        if (resloc == nullptr)
+        {
+            return nonstd::make_unexpected(readError_e::not_found);
+        }
+
+        if (resloc->pPack)
+        {
+            auto maybeData = resloc->pPack->Read(path);
+            if (!maybeData.has_value())
+            {
+                return nonstd::make_unexpected(readError_e::not_found);
+            }
+            return std::move(maybeData.value());
+        }
+
+        // The file might have gone away since it was indexed.
+        const std::string fullPath = fmt::format("{}/{}", resloc->location, path);
+        auto maybeFile = GetPlatform().ReadFileToBuffer(fullPath);
+        if (!maybeFile.has_value())
+        {
+            return nonstd::make_unexpected(readError_e::not_found);
+        }
+        return std::move(maybeFile.value());
+    }
+
+    auto ReadToView(const std::string_view strPath) -> viewResult_t override
+    {
+        if (ContainsParentDir(strPath))
+        {
+            return nonstd::make_unexpected(readError_e::invalid_path);
+        }
+
+        const std::string path = NormalizePath(strPath);
+        std::shared_lock<std::shared_mutex> lock(m_cMutex);
+        const resLoc_s *resloc = LookupOrProbe(lock, path);
+        if (resloc == nullptr)
+        {
+            return nonstd::make_unexpected(readError_e::not_found);
+        }
+
+        if (resloc->pPack)
+        {
+            auto maybeView = resloc->pPack->FindView(path);
+            if (!maybeView.has_value())
+            {
+                return nonstd::make_unexpected(readError_e::not_found);
+            }
+            return std::move(maybeView.value());
+        }
+
+        const std::string fullPath = fmt::format("{}/{}", resloc->location, path);
+        auto maybeFile = GetPlatform().MapFile(fullPath);
+        if (!maybeFile.has_value())
+        {
+            return nonstd::make_unexpected(readError_e::not_found);
+        }
+        return std::move(maybeFile.value());
+    }
+
+    auto ReadToViews(const nonstd::span<const std::string_view> nstrPaths) -> std::vector<viewResult_t> override
+    {
+        std::vector<viewResult_t> rvo(nstrPaths.size(), nonstd::make_unexpected(readError_e::not_found));
+
+        // Loose files are gathered up and read together, and pack entries
+        // are found in parallel, since they might need decompressing.
+        std::vector<std::string> paths;
+        for (const std::string_view path : nstrPaths)
+        {
+            paths.push_back(NormalizePath(path));
+        }
+
+        // Misses are probed up front, since probing drops the lock and a
+        // rescan could close packs we already found.
+        if (!m_bWatching)
+        {
+            std::vector<size_t> misses;
+            {
+                std::shared_lock<std::shared_mutex> lock(m_cMutex);
+                for (size_t i = 0; i < paths.size(); i++)
+                {
+                    if (Lookup(paths[i]) == nullptr)
+                    {
+                        misses.push_back(i);
+                    }
+                }
+            }
+            for (const size_t i : misses)
+            {
+                Probe(paths[i]);
+            }
+        }
+
+        std::vector<size_t> loose;
+        std::vector<std::string> fullPaths;
+        std::vector<std::pair<size_t, Pack *>> packed;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_cMutex);
+            for (size_t i = 0; i < nstrPaths.size(); i++)
+            {
+                if (ContainsParentDir(nstrPaths[i]))
+                {
+                    rvo[i] = nonstd::make_unexpected(readError_e::invalid_path);
+                    continue;
+                }
+
+                const resLoc_s *resloc = Lookup(paths[i]);
+                if (resloc == nullptr)
+                {
+                    continue;
+                }
+
+                if (resloc->pPack)
+                {
+                    packed.emplace_back(i, resloc->pPack.get());
+                    continue;
+                }
+
+                loose.push_back(i);
+                fullPaths.push_back(fmt::format("{}/{}", resloc->location, paths[i]));
+            }
+
+            // Packs can't go away while we hold the lock.
+            GetWorkers().ParallelFor(packed.size(), [&paths, &packed, &rvo](const size_t i) {
+                auto maybeView = packed[i].second->FindView(paths[packed[i].first]);
+                if (maybeView.has_value())
+                {
+                    rvo[packed[i].first] = std::move(maybeView.value());
+                }
+            });
+        }
+
+        const std::vector<std::string_view> filePaths(fullPaths.begin(), fullPaths.end());
+        auto files = GetPlatform().ReadFilesToBuffers(filePaths);
+        for (size_t i = 0; i < loose.size(); i++)
+        {
+            if (!files[i].has_value())
+            {
+                continue;
+            }
+
+            // The view owns the buffer it points into.
+            auto owner = std::make_shared<const buffer_t>(std::move(files[i].value()));
+            rvo[loose[i]] = bufferView_s{nonstd::span<const uint8_t>(owner->data(), owner->size()), owner};
+        }
+        return rvo;
+    }
+
+    auto PackStats() -> Pack::stats_s override
+    {
+        std::shared_lock<std::shared_mutex> lock(m_cMutex);
+        Pack::stats_s rvo;
         for (auto &resloc : m_ncResLocs)
         {
-            const std::string fullPath = fmt::format("{}/{}", resloc.location, strPath);
-            auto maybeFile = GetPlatform().ReadFileToBuffer(fullPath);
-            if (maybeFile.has_value())
+            if (resloc.pPack)
             {
-                return maybeFile.value();
+                const Pack::stats_s stats = resloc.pPack->Stats();
+                rvo.qwEntries += stats.qwEntries;
+                rvo.qwPackedBytes += stats.qwPackedBytes;
+                rvo.qwUnpackedBytes += stats.qwUnpackedBytes;
+                rvo.qwWorkUS += stats.qwWorkUS;
             }
         }
-        return nonstd::make_unexpected(readError_e::not_found);
+        return rvo;
+    }
+
+    auto RequestAsync(const std::string_view strPath, const priority_e ePriority, work_t &&fnWork, done_t &&fnDone)
+        -> handle_t override
+    {
+        handle_t handle = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+            handle = m_qwNextHandle++;
+            m_ncQueued.push_back(
+                request_s{handle, ePriority, std::string(strPath), std::move(fnWork), std::move(fnDone)});
+            std::push_heap(m_ncQueued.begin(), m_ncQueued.end(), QueueOrder);
+            m_cPending.insert(handle);
+        }
+        GetWorkers().Submit([this] { RunQueued(); });
+        return handle;
+    }
+
+    auto Cancel(const handle_t qwHandle) -> bool override
+    {
+        std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+        if (m_cPending.erase(qwHandle) == 0)
+        {
+            return false;
+        }
+
+        auto it = std::find_if(m_ncQueued.begin(), m_ncQueued.end(),
+                               [qwHandle](const request_s &cRequest) { return cRequest.qwHandle == qwHandle; });
+        if (it != m_ncQueued.end())
+        {
+            m_ncQueued.erase(it);
+            std::make_heap(m_ncQueued.begin(), m_ncQueued.end(), QueueOrder);
+        }
+        return true;
+    }
+
+    auto IsPending(const handle_t qwHandle) -> bool override
+    {
+        std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+        return m_cPending.find(qwHandle) != m_cPending.end();
+    }
+
+    auto DeliverCompletions() -> size_t override
+    {
+        std::vector<std::pair<handle_t, done_t>> done;
+        {
+            std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+            done.swap(m_ncDone);
+        }
+
+        // Done functions are free to make or cancel requests, so the lock
+        // is not held while they run.
+        size_t rvo = 0;
+        for (auto &[handle, fnDone] : done)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+                if (m_cPending.erase(handle) == 0)
+                {
+                    continue;
+                }
+            }
+            if (fnDone)
+            {
+                fnDone();
+            }
+            rvo += 1;
+        }
+        return rvo;
+    }
+
+    auto SetHotReload(const bool bEnable) -> void override
+    {
+        if (!bEnable)
+        {
+            m_bHotReload = false;
+            m_bWatching = false;
+            return;
+        }
+        if (!m_bHotReload)
+        {
+            bool watching = true;
+            std::shared_lock<std::shared_mutex> lock(m_cMutex);
+            for (auto &resloc : m_ncResLocs)
+            {
+                watching = GetPlatform().WatchPath(resloc.location) && watching;
+            }
+            m_bWatching = watching;
+        }
+        m_bHotReload = true;
+    }
+
+    auto Subscribe(changed_t &&fnChanged) -> handle_t override
+    {
+        std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+        const handle_t handle = m_qwNextHandle++;
+        m_ncSubscribers.emplace_back(handle, std::move(fnChanged));
+        return handle;
+    }
+
+    auto Unsubscribe(const handle_t qwHandle) -> void override
+    {
+        std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+        m_ncSubscribers.erase(std::remove_if(m_ncSubscribers.begin(), m_ncSubscribers.end(),
+                                             [qwHandle](const auto &cSub) { return cSub.first == qwHandle; }),
+                              m_ncSubscribers.end());
+    }
+
+    auto PollChanges() -> void override
+    {
+        if (!m_bHotReload)
+        {
+            return;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        auto files = GetPlatform().PollChangedFiles();
+        if (!files.empty())
+        {
+            m_cChangedFiles.insert(std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+            m_cLastChange = now;
+        }
+        if (m_cChangedFiles.empty() || m_bReloading || now - m_cLastChange < SETTLE_TIME)
+        {
+            return;
+        }
+
+        // Changes that come in while this batch reloads wait for the next.
+        auto changed = std::make_shared<std::vector<std::string>>(m_cChangedFiles.begin(), m_cChangedFiles.end());
+        m_cChangedFiles.clear();
+        m_bReloading = true;
+
+        handle_t handle = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+            handle = m_qwNextHandle++;
+            m_cPending.insert(handle);
+        }
+        GetWorkers().Submit([this, handle, changed] {
+            Rescan();
+            auto paths = std::make_shared<std::vector<std::string>>(ChangedAssets(*changed));
+
+            std::lock_guard<std::mutex> lock(m_cAsyncMutex);
+            m_ncDone.emplace_back(handle, [this, paths] {
+                m_bReloading = false;
+                if (!paths->empty())
+                {
+                    NotifyChanged(*paths);
+                }
+            });
+        });
     }
 };
 
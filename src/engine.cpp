@@ -16,7 +16,210 @@ namespace rock3d
 
 class Engine final
 {
+    static constexpr uint64_t NS_PER_MS = 1000000;
+    static constexpr uint64_t NS_PER_SEC = 1000000000;
+
+    /**
+     * @brief How long event driven apps sleep for at most, so file changes
+     *        are still picked up while there is no input.
+     */
+    static constexpr uint32_t IDLE_POLL_MS = 50;
+
+    /**
+     * @brief Bounds on how long the frame limiter spins after it sleeps.
+     *        SDL asks for a 1ms timer resolution on Windows, so sleeps
+     *        shouldn't wake any later than this.
+     */
+    static constexpr uint64_t MIN_SPIN_NS = NS_PER_MS / 4;
+    static constexpr uint64_t MAX_SPIN_NS = NS_PER_MS * 4;
+
+    /**
+     * @brief How far dilation can slow game time down, and how quickly it
+     *        slows down and speeds back up.  Slowing down is quick, so a
+     *        stall doesn't drop many ticks, and speeding up takes a couple
+     *        of seconds, so the game doesn't bounce between the two.
+     */
+    static constexpr float MIN_TIME_SCALE = 0.25f;
+    static constexpr float TIME_SCALE_SLOWER = 0.875f;
+    static constexpr float TIME_SCALE_FASTER = 1.0f / 128.0f;
+
+    /**
+     * @brief Most ticks a frame runs when dilating with no limit of its
+     *        own.  Dilation only slows down once ticks don't fit, so it
+     *        needs some limit to not fit into.
+     */
+    static constexpr uint32_t DILATE_MAX_TICKS = 4;
+
     std::unique_ptr<App> m_pApp = nullptr;
+    frameStats_s m_cStats;
+    uint64_t m_qwLastFrameStart = 0;
+    uint32_t m_dwMaxFPS = 0;
+    uint64_t m_qwFrameDeadline = 0; // When the last frame was meant to end, 0 if there wasn't a limit.
+    uint64_t m_qwSpinNS = NS_PER_MS * 2;
+    bool m_bFrameRequested = false;
+    bool m_bRender = true;      // Cleared by -norender.
+    bool m_bUnpaced = false;    // Set by -unpaced.
+    uint64_t m_qwQuitTicks = 0; // Set by -ticks, 0 to run until the app quits.
+    uint64_t m_qwRunStart = 0;
+    uint32_t m_dwSkippedFrames = 0; // Frames in a row that skipped rendering.
+
+    /**
+     * @brief Exact start time of a tick, in nanoseconds.
+     *
+     * @details Split up so a long running game can't overflow.
+     */
+    static auto TicksToNS(const uint64_t qwTicks, const uint64_t qwRateNum, const uint64_t qwRateDen) -> uint64_t
+    {
+        const uint64_t whole = (qwTicks / qwRateNum) * qwRateDen * NS_PER_SEC;
+        return whole + ((qwTicks % qwRateNum) * qwRateDen * NS_PER_SEC / qwRateNum);
+    }
+
+    /**
+     * @brief Count a frame that started at the passed time.  Its length
+     *        is the time since the frame before it started, so it includes
+     *        everything the loop did.
+     */
+    auto AddFrameTime(const uint64_t qwFrameStart, const bool bIdled) -> void
+    {
+        if (m_qwLastFrameStart != 0)
+        {
+            const uint64_t frameNS = qwFrameStart - m_qwLastFrameStart;
+            m_cStats.qwFrameNS = frameNS;
+            m_cStats.qwMaxFrameNS = std::max(m_cStats.qwMaxFrameNS, frameNS);
+            m_cStats.qwAvgFrameNS = m_cStats.qwAvgFrameNS == 0
+                                        ? frameNS
+                                        : m_cStats.qwAvgFrameNS - (m_cStats.qwAvgFrameNS / 32) + (frameNS / 32);
+
+            // A frame that sat waiting for input says nothing about pacing.
+            if (!bIdled)
+            {
+                const uint64_t targetNS = m_dwMaxFPS != 0 ? NS_PER_SEC / m_dwMaxFPS : m_cStats.qwAvgFrameNS;
+                const uint64_t jitterNS = frameNS > targetNS ? frameNS - targetNS : targetNS - frameNS;
+                m_cStats.qwJitterNS = jitterNS;
+                m_cStats.qwMaxJitterNS = std::max(m_cStats.qwMaxJitterNS, jitterNS);
+                m_cStats.qwAvgJitterNS = m_cStats.qwAvgJitterNS - (m_cStats.qwAvgJitterNS / 32) + (jitterNS / 32);
+            }
+        }
+        m_qwLastFrameStart = qwFrameStart;
+        m_cStats.qwFrames += 1;
+    }
+
+    /**
+     * @brief Wait until the passed time, as close to it as we can get.
+     *
+     * @details Sleeping can wake up late, so we sleep until a little before
+     *          the deadline and spin for the rest.  How early we stop is
+     *          the latest a recent sleep woke up, which grows right away
+     *          when a sleep runs late and shrinks slowly after.
+     */
+    auto WaitUntil(const uint64_t qwDeadline) -> void
+    {
+        Platform &platform = GetPlatform();
+        for (;;)
+        {
+            const uint64_t now = platform.TimeNS();
+            if (now >= qwDeadline)
+            {
+                return;
+            }
+
+            const uint64_t leftNS = qwDeadline - now;
+            if (leftNS >= m_qwSpinNS + NS_PER_MS)
+            {
+                const uint32_t sleepMS = uint32_t((leftNS - m_qwSpinNS) / NS_PER_MS);
+                platform.SleepMS(sleepMS);
+
+                const uint64_t sleptNS = platform.TimeNS() - now;
+                const uint64_t lateNS = sleptNS > sleepMS * NS_PER_MS ? sleptNS - (sleepMS * NS_PER_MS) : 0;
+                m_qwSpinNS = std::clamp(std::max(lateNS, m_qwSpinNS - (m_qwSpinNS / 16)), MIN_SPIN_NS, MAX_SPIN_NS);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /**
+     * @brief Hold the frame that just finished to the frame limit.
+     *
+     * @details Deadlines follow on from each other instead of from when a
+     *          frame ended, so a frame that wakes up a little late is made
+     *          up for by the next one.  A frame that misses its deadline
+     *          starts the schedule over, rather than rushing the frames
+     *          after it to catch up.
+     *
+     * @param qwFrameStart When the frame started.
+     * @return Time spent waiting.
+     */
+    auto LimitFrame(const uint64_t qwFrameStart) -> uint64_t
+    {
+        if (m_dwMaxFPS == 0)
+        {
+            m_qwFrameDeadline = 0;
+            return 0;
+        }
+
+        const uint64_t frameNS = NS_PER_SEC / m_dwMaxFPS;
+        const uint64_t deadline = (m_qwFrameDeadline != 0 ? m_qwFrameDeadline : qwFrameStart) + frameNS;
+        const uint64_t now = GetPlatform().TimeNS();
+        if (now > deadline)
+        {
+            m_cStats.qwLateFrames += 1;
+            m_qwFrameDeadline = now;
+            return 0;
+        }
+
+        WaitUntil(deadline);
+        m_qwFrameDeadline = deadline;
+        return GetPlatform().TimeNS() - now;
+    }
+
+    /**
+     * @brief Sleep until there is a reason to run a frame.
+     *
+     * @return Time spent waiting.
+     */
+    auto WaitForWork() -> uint64_t
+    {
+        if (m_bFrameRequested)
+        {
+            m_bFrameRequested = false;
+            return 0;
+        }
+
+        const uint64_t start = GetPlatform().TimeNS();
+        while (!GetPlatform().WaitEvents(IDLE_POLL_MS))
+        {
+            // Finished loads and edited files count as changes too.  The
+            // app is free to request a frame from a completion.
+            GetAssets().PollChanges();
+            if (GetAssets().DeliverCompletions() != 0 || GetWorkers().RunMainJobs() != 0 || m_bFrameRequested)
+            {
+                break;
+            }
+        }
+        m_bFrameRequested = false;
+
+        // The frame limit schedule means nothing after sleeping a while.
+        m_qwFrameDeadline = 0;
+        return GetPlatform().TimeNS() - start;
+    }
+
+    /**
+     * @brief Print how long the run took, for benchmarks.
+     */
+    auto Report() -> void
+    {
+        const uint64_t elapsedNS = GetPlatform().TimeNS() - m_qwRunStart;
+        const double seconds = double(elapsedNS) / double(NS_PER_SEC);
+        const double avgMS = double(m_cStats.qwAvgFrameNS) / double(NS_PER_MS);
+        const double maxMS = double(m_cStats.qwMaxFrameNS) / double(NS_PER_MS);
+        fmt::print("{} ticks, {} frames in {:.3f}s: {:.1f} ticks/s, {:.3f}ms average frame, {:.3f}ms longest\n",
+                   m_cStats.qwTicks, m_cStats.qwFrames, seconds, double(m_cStats.qwTicks) / seconds, avgMS, maxMS);
+        fmt::print("{} late ticks, {} dropped ticks, {} skipped frames\n", m_cStats.qwLateTicks,
+                   m_cStats.qwDroppedTicks, m_cStats.qwSkippedFrames);
+    }
 
   public:
     /**
@@ -30,8 +233,29 @@ class Engine final
 
     auto Init(const args_t &nstrArgs) -> void
     {
+        for (size_t i = 0; i < nstrArgs.size(); i++)
+        {
+            if (nstrArgs[i] == "-norender")
+            {
+                m_bRender = false;
+            }
+            else if (nstrArgs[i] == "-unpaced")
+            {
+                m_bUnpaced = true;
+            }
+            else if (nstrArgs[i] == "-ticks" && i + 1 < nstrArgs.size())
+            {
+                m_qwQuitTicks = std::strtoull(std::string(nstrArgs[i + 1]).c_str(), nullptr, 10);
+                i += 1;
+            }
+        }
+
+        // The pool belongs to whichever thread touches it first.
+        GetWorkers();
+
         GetPlatform().Init(nstrArgs);
         m_pApp->Init(nstrArgs);
+        m_dwMaxFPS = m_pApp->Config().dwMaxFPS;
     }
 
     // *************************************************************************
@@ -43,19 +267,63 @@ class Engine final
 
     // *************************************************************************
 
+    auto FrameStats() -> const frameStats_s &
+    {
+        return m_cStats;
+    }
+
+    // *************************************************************************
+
+    auto SetMaxFPS(const uint32_t dwMaxFPS) -> void
+    {
+        m_dwMaxFPS = dwMaxFPS;
+        m_qwFrameDeadline = 0;
+    }
+
+    // *************************************************************************
+
+    auto RequestFrame() -> void
+    {
+        m_bFrameRequested = true;
+    }
+
+    // *************************************************************************
+
     auto Tick() -> void
     {
         const App::config_s &config = m_pApp->Config();
 
+        // Ticks are qwTickRateDen / qwTickRateNum seconds long.  Time is
+        // kept in units of 1 / qwTickRateNum nanoseconds, so that every
+        // tick is a whole number of units and never drifts.
+        const uint64_t rateNum = config.qwTickRateNum != 0 ? config.qwTickRateNum : 1000;
+        const uint64_t rateDen = config.qwTickRateNum != 0 ? config.qwTickRateDen : config.qwDeltaMS;
+        const uint64_t tickUnits = rateDen * NS_PER_SEC;
+        const uint64_t maxNS = config.qwMaxMS * NS_PER_MS;
+        const uint64_t deltaNS = tickUnits / rateNum;
+        const bool dilate = config.eCatchUp == App::catchUp_e::dilate;
+        const uint32_t maxTicks =
+            config.dwMaxTicksPerFrame == 0 && dilate ? DILATE_MAX_TICKS : config.dwMaxTicksPerFrame;
+
         // Glenn Fiedler's fixed timestep, with interpolation.
         uint64_t f = 0;
-        uint64_t t = 0;
 
-        uint64_t currentTime = GetPlatform().TimeMS();
+        uint64_t currentTime = GetPlatform().TimeNS();
         uint64_t accumulator = 0;
+        uint64_t clampedUnits = 0; // Clamped time that doesn't add up to a whole tick yet.
+        if (m_qwRunStart == 0)
+        {
+            m_qwRunStart = currentTime;
+        }
 
         for (;;)
         {
+            // Time spent waiting for input isn't simulated.
+            const uint64_t idleNS = config.bEventDriven && !m_bUnpaced ? WaitForWork() : 0;
+            currentTime += idleNS;
+
+            const uint64_t frameStart = GetPlatform().TimeNS();
+
             // Feed events into the queue.
             GetPlatform().PumpEvents();
 
@@ -66,29 +334,133 @@ class Engine final
                 m_pApp->HandleEvent(ev);
             }
 
+            // Hand finished background loads to the app, before it ticks.
+            // Edited files are picked up first, so their reloads are
+            // delivered the frame they finish.  Jobs that have to run on
+            // the main thread go after, since completions can queue them.
+            GetAssets().PollChanges();
+            GetAssets().DeliverCompletions();
+            GetWorkers().RunMainJobs();
+
             // Figure out our desired frame time.
-            uint64_t newTime = GetPlatform().TimeMS();
+            const uint64_t newTime = GetPlatform().TimeNS();
             uint64_t frameTime = newTime - currentTime;
-            if (frameTime > config.qwMaxMS)
+            uint64_t clampedNS = 0;
+            if (frameTime > maxNS)
             {
-                frameTime = config.qwMaxMS;
+                clampedNS = frameTime - maxNS;
+                m_cStats.qwClampedNS += clampedNS;
+                frameTime = maxNS;
             }
             currentTime = newTime;
 
-            // Add frametime to the accumulator.
-            accumulator += frameTime;
+            // Dilated time passes slower than real time.
+            if (dilate)
+            {
+                frameTime = uint64_t(double(frameTime) * double(m_cStats.fTimeScale));
+                clampedNS = uint64_t(double(clampedNS) * double(m_cStats.fTimeScale));
+            }
+
+            // The ticks the clamp threw away were never run either, so
+            // they count as dropped too.
+            if (!m_bUnpaced)
+            {
+                clampedUnits += clampedNS * rateNum;
+                m_cStats.qwDroppedTicks += clampedUnits / tickUnits;
+                clampedUnits %= tickUnits;
+            }
+
+            // Add frametime to the accumulator.  Unpaced, every frame is
+            // exactly one tick no matter how long it really took.
+            accumulator += m_bUnpaced ? tickUnits : frameTime * rateNum;
 
             // Remove time from the accumulator by ticking frames.
-            while (accumulator >= config.qwDeltaMS)
+            uint32_t ticks = 0;
+            while (accumulator >= tickUnits)
             {
-                m_pApp->Tick(App::tickParams_s{f, t, config.qwDeltaMS});
+                if (maxTicks != 0 && ticks >= maxTicks)
+                {
+                    break;
+                }
+                if (accumulator >= tickUnits * 2)
+                {
+                    m_cStats.qwLateTicks += 1;
+                }
+
+                const uint64_t gameTimeNS = TicksToNS(f, rateNum, rateDen);
+                GetSnapshots().Advance();
+                if (GetLevels().ApplySwap())
+                {
+                    // Nothing in the old level should blend into the new one.
+                    GetSnapshots().CutAll();
+                }
+                m_pApp->Tick(App::tickParams_s{f, gameTimeNS / NS_PER_MS, deltaNS / NS_PER_MS, gameTimeNS, deltaNS});
                 f += 1;
-                t += config.qwDeltaMS;
-                accumulator -= config.qwDeltaMS;
+                ticks += 1;
+                accumulator -= tickUnits;
+            }
+            const uint64_t tickEnd = GetPlatform().TimeNS();
+
+            // Ticks are still owed, so we're falling behind.  Skipping the
+            // render gives the next frame more time to tick, and once we
+            // have to render anyway, whatever is still owed is dropped.
+            const bool behind = accumulator >= tickUnits;
+            const bool skip = behind && m_dwSkippedFrames < config.dwMaxFrameSkip;
+            if (skip)
+            {
+                m_dwSkippedFrames += 1;
+                m_cStats.qwSkippedFrames += 1;
+            }
+            else
+            {
+                m_dwSkippedFrames = 0;
+                if (behind)
+                {
+                    const uint64_t dropped = accumulator / tickUnits;
+                    m_cStats.qwDroppedTicks += dropped;
+                    accumulator -= dropped * tickUnits;
+                }
+            }
+            if (dilate)
+            {
+                m_cStats.fTimeScale = behind ? std::max(MIN_TIME_SCALE, m_cStats.fTimeScale * TIME_SCALE_SLOWER)
+                                             : std::min(1.0f, m_cStats.fTimeScale + TIME_SCALE_FASTER);
             }
 
             // Pass leftover time so we can do an interpolation if need be.
-            m_pApp->Render(App::renderParams_s{accumulator, config.qwDeltaMS});
+            const uint64_t accumNS = accumulator / rateNum;
+            const float alpha = float(accumulator) / float(tickUnits);
+            if (m_bRender && !skip)
+            {
+                GetSnapshots().Blend(alpha);
+                m_pApp->Render(App::renderParams_s{accumNS / NS_PER_MS, deltaNS / NS_PER_MS, accumNS, deltaNS, alpha});
+
+                // If this is high, the render thread is what's holding
+                // frames back, not us.
+                const bgfx::Stats *stats = bgfx::getStats();
+                m_cStats.qwSyncNS = stats->cpuTimerFreq > 0
+                                        ? uint64_t(stats->waitRender) * NS_PER_SEC / uint64_t(stats->cpuTimerFreq)
+                                        : 0;
+            }
+
+            // Tear down a little more of any level that was swapped out.
+            GetLevels().ReleaseStep();
+            const uint64_t renderEnd = GetPlatform().TimeNS();
+
+            m_cStats.qwEventNS = newTime - frameStart;
+            m_cStats.qwTickNS = tickEnd - newTime;
+            m_cStats.qwRenderNS = renderEnd - tickEnd;
+            m_cStats.dwFrameTicks = ticks;
+            m_cStats.qwTicks += ticks;
+            AddFrameTime(frameStart, idleNS != 0);
+
+            if (m_qwQuitTicks != 0 && m_cStats.qwTicks >= m_qwQuitTicks)
+            {
+                Report();
+                rock3d::Shutdown();
+            }
+
+            m_cStats.qwWaitNS = idleNS + (m_bUnpaced ? 0 : LimitFrame(frameStart));
         }
     }
 
@@ -138,4 +510,25 @@ auto AppConfig() -> const App::config_s &
     return g_pEngine->AppConfig();
 }
 
+// *************************************************************************
+
+auto FrameStats() -> const frameStats_s &
+{
+    return g_pEngine->FrameStats();
+}
+
+// *************************************************************************
+
+auto SetMaxFPS(const uint32_t dwMaxFPS) -> void
+{
+    g_pEngine->SetMaxFPS(dwMaxFPS);
+}
+
+// *************************************************************************
+
+auto RequestFrame() -> void
+{
+    g_pEngine->RequestFrame();
+}
+
 } // namespace rock3d
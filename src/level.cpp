@@ -143,20 +143,21 @@ static auto CacheNormal(Edge &cOutEdge) -> void
 
 // *****************************************************************************
 
-auto LoadLevelAsset(const std::string_view strPath) -> loadLevelResult_t
+/**
+ * @brief Build a level out of the contents of a level file.
+ */
+static auto ParseLevel(const Assets::viewResult_t &cResult) -> loadLevelResult_t
 {
-    // Find the level file.
-    auto result = GetAssets().ReadToBuffer(strPath);
-    if (!result.has_value())
+    if (!cResult.has_value())
     {
         return nonstd::make_unexpected(loadLevelError_e::missing_asset);
     }
 
-    // Parse the JSON.
-    buffer_t &data = result.value();
+    // Parse the JSON straight out of the file.
+    const nonstd::span<const uint8_t> data = cResult.value().cSpan;
     Json::Value root;
     Json::Reader reader;
-    const char *start = (const char *)&data[0];
+    const char *start = (const char *)data.data();
     const char *end = start + data.size();
     const int ok = reader.parse(start, end, root);
     if (!ok)
@@ -184,4 +185,371 @@ auto LoadLevelAsset(const std::string_view strPath) -> loadLevelResult_t
 
 // *****************************************************************************
 
+/**
+ * @brief Add a path to a list, unless it is empty or already there.
+ */
+static auto AddUnique(std::vector<std::string> &nstrOut, const std::string &strPath) -> void
+{
+    if (!strPath.empty() && std::find(nstrOut.begin(), nstrOut.end(), strPath) == nstrOut.end())
+    {
+        nstrOut.push_back(strPath);
+    }
+}
+
+/**
+ * @brief Read a list of asset paths out of a manifest JSON.
+ */
+static auto UnserializePaths(const Json::Value &cJson) -> std::vector<std::string>
+{
+    std::vector<std::string> rvo;
+    for (auto &jsonPath : cJson)
+    {
+        AddUnique(rvo, jsonPath.asString());
+    }
+    return rvo;
+}
+
+/**
+ * @brief Build a manifest out of the contents of a manifest file.
+ */
+static auto ParseLevelManifest(const nonstd::span<const uint8_t> cData) -> std::optional<LevelManifest>
+{
+    Json::Value root;
+    Json::Reader reader;
+    const char *start = (const char *)cData.data();
+    const char *end = start + cData.size();
+    if (!reader.parse(start, end, root) || !root.isObject())
+    {
+        return std::nullopt;
+    }
+
+    LevelManifest manifest;
+    manifest.nstrTextures = UnserializePaths(root["textures"]);
+    manifest.nstrSprites = UnserializePaths(root["sprites"]);
+    manifest.nstrSounds = UnserializePaths(root["sounds"]);
+    return manifest;
+}
+
+// *****************************************************************************
+
+auto LevelTexturePath(const std::string_view strTexture) -> std::string
+{
+    return fmt::format("texture/{}.png", strTexture);
+}
+
+// *****************************************************************************
+
+auto LevelManifestPath(const std::string_view strPath) -> std::string
+{
+    constexpr std::string_view EXTENSION = ".json";
+    if (strPath.size() >= EXTENSION.size() &&
+        strPath.compare(strPath.size() - EXTENSION.size(), EXTENSION.size(), EXTENSION) == 0)
+    {
+        return fmt::format("{}.deps.json", strPath.substr(0, strPath.size() - EXTENSION.size()));
+    }
+    return fmt::format("{}.deps.json", strPath);
+}
+
+// *****************************************************************************
+
+auto BuildLevelManifest(const Level &cLevel) -> LevelManifest
+{
+    LevelManifest manifest;
+    const auto addTexture = [&manifest](const std::string &strTexture) {
+        if (!strTexture.empty())
+        {
+            AddUnique(manifest.nstrTextures, LevelTexturePath(strTexture));
+        }
+    };
+    for (auto &poly : cLevel.ncPolygons)
+    {
+        addTexture(poly.strFloorTex);
+        addTexture(poly.strCeilTex);
+    }
+    for (auto &edge : cLevel.ncEdges)
+    {
+        addTexture(edge.strUpperTex);
+        addTexture(edge.strMiddleTex);
+        addTexture(edge.strLowerTex);
+    }
+    return manifest;
+}
+
+// *****************************************************************************
+
+auto BuildLevelManifest(const nonstd::span<const uint8_t> cLevelFile) -> std::optional<LevelManifest>
+{
+    auto maybeLevel = ParseLevel(bufferView_s{cLevelFile, nullptr});
+    if (!maybeLevel.has_value())
+    {
+        return std::nullopt;
+    }
+    return BuildLevelManifest(maybeLevel.value());
+}
+
+// *****************************************************************************
+
+auto SerializeLevelManifest(const LevelManifest &cManifest) -> std::string
+{
+    const auto toJson = [](const std::vector<std::string> &nstrPaths) {
+        Json::Value rvo(Json::arrayValue);
+        for (auto &path : nstrPaths)
+        {
+            rvo.append(path);
+        }
+        return rvo;
+    };
+
+    Json::Value root(Json::objectValue);
+    root["textures"] = toJson(cManifest.nstrTextures);
+    root["sprites"] = toJson(cManifest.nstrSprites);
+    root["sounds"] = toJson(cManifest.nstrSounds);
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "    ";
+    return Json::writeString(builder, root);
+}
+
+// *****************************************************************************
+
+auto LoadLevelManifest(const std::string_view strPath) -> std::optional<LevelManifest>
+{
+    auto maybeFile = GetAssets().ReadToView(LevelManifestPath(strPath));
+    if (maybeFile.has_value())
+    {
+        return ParseLevelManifest(maybeFile->cSpan);
+    }
+
+    auto maybeLevel = LoadLevelAsset(strPath);
+    if (!maybeLevel.has_value())
+    {
+        return std::nullopt;
+    }
+    return BuildLevelManifest(maybeLevel.value());
+}
+
+// *****************************************************************************
+
+auto LoadLevelAsset(const std::string_view strPath, const levelPrefetch_t &fnPrefetch) -> loadLevelResult_t
+{
+    if (!fnPrefetch)
+    {
+        return ParseLevel(GetAssets().ReadToView(strPath));
+    }
+
+    // With a manifest file, prefetching can start before we even read the
+    // level.  Without one, we have to parse the level to know what it
+    // needs, which is still before anything gets built out of it.
+    auto maybeFile = GetAssets().ReadToView(LevelManifestPath(strPath));
+    std::optional<LevelManifest> manifest;
+    if (maybeFile.has_value())
+    {
+        manifest = ParseLevelManifest(maybeFile->cSpan);
+    }
+    if (manifest.has_value())
+    {
+        fnPrefetch(manifest.value());
+        return ParseLevel(GetAssets().ReadToView(strPath));
+    }
+
+    auto rvo = ParseLevel(GetAssets().ReadToView(strPath));
+    if (rvo.has_value())
+    {
+        fnPrefetch(BuildLevelManifest(rvo.value()));
+    }
+    return rvo;
+}
+
+// *****************************************************************************
+
+auto LoadLevelAssetAsync(const std::string_view strPath, const Assets::priority_e ePriority,
+                         std::function<void(loadLevelResult_t &&)> fnDone) -> Assets::handle_t
+{
+    return GetAssets().LoadAsync<loadLevelResult_t>(
+        strPath, ePriority, [](Assets::viewResult_t &&cRead) { return ParseLevel(cRead); }, std::move(fnDone));
+}
+
+// *****************************************************************************
+
+class LevelsImpl final : public Levels
+{
+    struct loaded_s
+    {
+        std::string strPath;
+        build_t fnBuild;
+        Level cLevel;
+        std::unique_ptr<Payload> pPayload;
+    };
+
+    std::unique_ptr<loaded_s> m_pCurrent;
+    std::unique_ptr<loaded_s> m_pNext;
+    preload_e m_eNextState = preload_e::none;
+    std::string m_strNextPath;
+    build_t m_fnNextBuild;
+    Assets::handle_t m_qwNextHandle = 0;
+    bool m_bSwapRequested = false;
+    std::deque<std::unique_ptr<loaded_s>> m_npRetired;
+    Assets::handle_t m_qwChangedHandle = 0;
+
+    /**
+     * @brief Queue a level to be released over the next few frames.
+     */
+    auto Retire(std::unique_ptr<loaded_s> &&pLoaded) -> void
+    {
+        if (pLoaded)
+        {
+            m_npRetired.push_back(std::move(pLoaded));
+        }
+    }
+
+    /**
+     * @brief Load changed levels again.
+     */
+    auto OnChanged(const nonstd::span<const std::string> nstrPaths) -> void
+    {
+        const bool nextBusy = m_eNextState == preload_e::loading || m_eNextState == preload_e::ready;
+        for (auto &path : nstrPaths)
+        {
+            if (nextBusy && path == m_strNextPath)
+            {
+                build_t build = m_fnNextBuild;
+                Preload(path, std::move(build));
+                return;
+            }
+            if (m_pCurrent && path == m_pCurrent->strPath && (!nextBusy || m_strNextPath == path))
+            {
+                build_t build = m_pCurrent->fnBuild;
+                Preload(path, std::move(build));
+                RequestSwap();
+                return;
+            }
+        }
+    }
+
+  public:
+    LevelsImpl()
+    {
+        m_qwChangedHandle =
+            GetAssets().Subscribe([this](const nonstd::span<const std::string> nstrPaths) { OnChanged(nstrPaths); });
+    }
+
+    ~LevelsImpl()
+    {
+        GetAssets().Unsubscribe(m_qwChangedHandle);
+    }
+
+    auto Preload(const std::string_view strPath, build_t &&fnBuild) -> void override
+    {
+        if (m_eNextState == preload_e::loading)
+        {
+            GetAssets().Cancel(m_qwNextHandle);
+        }
+        Retire(std::move(m_pNext));
+
+        using result_t = std::unique_ptr<loaded_s>;
+        const std::string path(strPath);
+        m_eNextState = preload_e::loading;
+        m_strNextPath = path;
+        m_fnNextBuild = fnBuild;
+        m_qwNextHandle = GetAssets().LoadAsync<result_t>(
+            strPath, Assets::priority_e::low,
+            [path, fnBuild](Assets::viewResult_t &&cRead) -> result_t {
+                auto maybeLevel = ParseLevel(cRead);
+                if (!maybeLevel.has_value())
+                {
+                    return nullptr;
+                }
+
+                auto rvo = std::make_unique<loaded_s>();
+                rvo->strPath = path;
+                rvo->fnBuild = fnBuild;
+                rvo->cLevel = std::move(maybeLevel.value());
+                if (fnBuild)
+                {
+                    rvo->pPayload = fnBuild(rvo->cLevel);
+                }
+                return rvo;
+            },
+            [this](result_t &&pLoaded) {
+                m_eNextState = pLoaded ? preload_e::ready : preload_e::failed;
+                m_pNext = std::move(pLoaded);
+            });
+    }
+
+    auto PreloadState() -> preload_e override
+    {
+        return m_eNextState;
+    }
+
+    auto RequestSwap() -> void override
+    {
+        m_bSwapRequested = true;
+    }
+
+    auto Current() -> const Level * override
+    {
+        return m_pCurrent ? &m_pCurrent->cLevel : nullptr;
+    }
+
+    auto CurrentPath() -> std::string_view override
+    {
+        return m_pCurrent ? std::string_view(m_pCurrent->strPath) : std::string_view();
+    }
+
+    auto CurrentPayload() -> Payload * override
+    {
+        return m_pCurrent ? m_pCurrent->pPayload.get() : nullptr;
+    }
+
+    auto RetiredCount() -> size_t override
+    {
+        return m_npRetired.size();
+    }
+
+    auto ApplySwap() -> bool override
+    {
+        if (!m_bSwapRequested || m_eNextState != preload_e::ready)
+        {
+            return false;
+        }
+
+        Retire(std::move(m_pCurrent));
+        m_pCurrent = std::move(m_pNext);
+        m_eNextState = preload_e::none;
+        m_bSwapRequested = false;
+        return true;
+    }
+
+    auto ReleaseStep() -> void override
+    {
+        if (m_npRetired.empty())
+        {
+            return;
+        }
+
+        // Release one step of the oldest level each frame.  The level data
+        // itself goes on the frame after its payload is done.
+        loaded_s &oldest = *m_npRetired.front();
+        if (oldest.pPayload)
+        {
+            if (oldest.pPayload->ReleaseStep())
+            {
+                oldest.pPayload.reset();
+            }
+            return;
+        }
+        m_npRetired.pop_front();
+    }
+};
+
+// *****************************************************************************
+
+auto GetLevels() -> Levels &
+{
+    static LevelsImpl levels;
+    return levels;
+}
+
+// *****************************************************************************
+
 }; // namespace rock3d
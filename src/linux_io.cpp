@@ -0,0 +1,578 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief File reading for the Linux platform.
+ *
+ * @details io_uring is driven straight through its syscalls, so there is
+ *          no dependency on liburing.  Everything here falls back to plain
+ *          POSIX calls on kernels that are too old, or where io_uring is
+ *          disabled.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "linux_io.h"
+
+namespace rock3d
+{
+
+//******************************************************************************
+
+/**
+ * @brief A minimal io_uring, used to run batches of operations.
+ */
+class Uring final
+{
+    static constexpr unsigned ENTRIES = 256;
+
+    /**
+     * @brief Largest single read, the kernel caps reads a bit below 2GB.
+     */
+    static constexpr size_t MAX_READ = size_t(1) << 30;
+
+    int m_iFd = -1;
+    unsigned m_dwEntries = 0;
+    void *m_pSQRing = MAP_FAILED;
+    size_t m_qwSQRingSize = 0;
+    void *m_pCQRing = MAP_FAILED;
+    size_t m_qwCQRingSize = 0;
+    io_uring_sqe *m_pSQEs = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t m_qwSQEsSize = 0;
+
+    unsigned *m_pSQHead = nullptr;
+    unsigned *m_pSQTail = nullptr;
+    unsigned *m_pSQMask = nullptr;
+    unsigned *m_pSQArray = nullptr;
+    unsigned *m_pCQHead = nullptr;
+    unsigned *m_pCQTail = nullptr;
+    unsigned *m_pCQMask = nullptr;
+    io_uring_cqe *m_pCQEs = nullptr;
+
+    template <typename T>
+    static auto RingField(void *pRing, const uint32_t dwOffset) -> T *
+    {
+        return reinterpret_cast<T *>(static_cast<uint8_t *>(pRing) + dwOffset);
+    }
+
+    /**
+     * @brief Check that the kernel knows every operation we use.
+     */
+    auto Supported() -> bool
+    {
+        constexpr unsigned OPS = 256;
+        buffer_t buffer(sizeof(io_uring_probe) + (OPS * sizeof(io_uring_probe_op)), 0);
+        auto *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+        if (syscall(__NR_io_uring_register, m_iFd, IORING_REGISTER_PROBE, probe, OPS) < 0)
+        {
+            return false;
+        }
+        for (const unsigned op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE})
+        {
+            if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+  public:
+    using prep_t = std::function<void(size_t, io_uring_sqe &)>;
+    using done_t = std::function<void(size_t, int)>;
+
+  private:
+    /**
+     * @brief Pass every completion waiting in the ring to fnDone.
+     *
+     * @return Number of completions.
+     */
+    auto Reap(const done_t &fnDone) -> size_t
+    {
+        size_t rvo = 0;
+        unsigned head = *m_pCQHead;
+        const unsigned cqTail = __atomic_load_n(m_pCQTail, __ATOMIC_ACQUIRE);
+        for (; head != cqTail; head++)
+        {
+            const io_uring_cqe &cqe = m_pCQEs[head & *m_pCQMask];
+            fnDone(size_t(cqe.user_data), cqe.res);
+            rvo += 1;
+        }
+        __atomic_store_n(m_pCQHead, head, __ATOMIC_RELEASE);
+        return rvo;
+    }
+
+    /**
+     * @brief Wait for operations the kernel already took, after the ring
+     *        stopped working.  Until they finish, the kernel can still open
+     *        files and write into the buffers they point at, so nothing
+     *        they use can be freed before this returns.
+     */
+    auto Drain(const size_t qwSubmitted, size_t qwReaped, const done_t &fnDone) -> void
+    {
+        while (qwReaped < qwSubmitted)
+        {
+            const long ret = syscall(__NR_io_uring_enter, m_iFd, 0, unsigned(qwSubmitted - qwReaped),
+                                     IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0 && errno != EINTR)
+            {
+                // Can't even wait on the ring, so watch it instead.
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            qwReaped += Reap(fnDone);
+        }
+    }
+
+  public:
+
+    Uring() {}
+    ~Uring()
+    {
+        if (m_pSQEs != MAP_FAILED)
+        {
+            munmap(m_pSQEs, m_qwSQEsSize);
+        }
+        if (m_pCQRing != MAP_FAILED && m_pCQRing != m_pSQRing)
+        {
+            munmap(m_pCQRing, m_qwCQRingSize);
+        }
+        if (m_pSQRing != MAP_FAILED)
+        {
+            munmap(m_pSQRing, m_qwSQRingSize);
+        }
+        if (m_iFd >= 0)
+        {
+            close(m_iFd);
+        }
+    }
+    ROCK3D_NOCOPY(Uring);
+
+    //**************************************************************************
+
+    auto Init() -> bool
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_iFd = int(syscall(__NR_io_uring_setup, ENTRIES, &params));
+        if (m_iFd < 0)
+        {
+            return false;
+        }
+        m_dwEntries = params.sq_entries;
+
+        m_qwSQRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+        m_qwCQRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+        {
+            m_qwSQRingSize = std::max(m_qwSQRingSize, m_qwCQRingSize);
+        }
+
+        m_pSQRing = mmap(nullptr, m_qwSQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_iFd,
+                         IORING_OFF_SQ_RING);
+        if (m_pSQRing == MAP_FAILED)
+        {
+            return false;
+        }
+        m_pCQRing = single ? m_pSQRing
+                           : mmap(nullptr, m_qwCQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_iFd,
+                                  IORING_OFF_CQ_RING);
+        if (m_pCQRing == MAP_FAILED)
+        {
+            return false;
+        }
+        m_qwSQEsSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_pSQEs = static_cast<io_uring_sqe *>(mmap(nullptr, m_qwSQEsSize, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, m_iFd, IORING_OFF_SQES));
+        if (m_pSQEs == MAP_FAILED)
+        {
+            return false;
+        }
+
+        m_pSQHead = RingField<unsigned>(m_pSQRing, params.sq_off.head);
+        m_pSQTail = RingField<unsigned>(m_pSQRing, params.sq_off.tail);
+        m_pSQMask = RingField<unsigned>(m_pSQRing, params.sq_off.ring_mask);
+        m_pSQArray = RingField<unsigned>(m_pSQRing, params.sq_off.array);
+        m_pCQHead = RingField<unsigned>(m_pCQRing, params.cq_off.head);
+        m_pCQTail = RingField<unsigned>(m_pCQRing, params.cq_off.tail);
+        m_pCQMask = RingField<unsigned>(m_pCQRing, params.cq_off.ring_mask);
+        m_pCQEs = RingField<io_uring_cqe>(m_pCQRing, params.cq_off.cqes);
+
+        return Supported();
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Run a batch of operations, and wait for all of them to finish.
+     *
+     * @details Operations are submitted as many as the ring holds at a
+     *          time, and each of those is a single io_uring_enter that both
+     *          submits and waits.
+     *
+     * @param qwCount Number of operations.
+     * @param fnPrep Fills in the submission of each operation.
+     * @param fnDone Receives the result of each operation.
+     * @return False if the ring stopped working.  Every operation the
+     *         kernel took has still finished and been passed to fnDone,
+     *         the rest never start.
+     */
+    auto Run(const size_t qwCount, const prep_t &fnPrep, const done_t &fnDone) -> bool
+    {
+        for (size_t first = 0; first < qwCount; first += m_dwEntries)
+        {
+            const size_t count = std::min(qwCount - first, size_t(m_dwEntries));
+
+            const unsigned start = *m_pSQTail;
+            unsigned tail = start;
+            for (size_t i = 0; i < count; i++)
+            {
+                const unsigned index = tail & *m_pSQMask;
+                io_uring_sqe &sqe = m_pSQEs[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                fnPrep(first + i, sqe);
+                sqe.user_data = first + i;
+                m_pSQArray[index] = index;
+                tail += 1;
+            }
+            __atomic_store_n(m_pSQTail, tail, __ATOMIC_RELEASE);
+
+            size_t reaped = 0;
+            while (reaped < count)
+            {
+                const unsigned unsubmitted = tail - __atomic_load_n(m_pSQHead, __ATOMIC_ACQUIRE);
+                const long ret = syscall(__NR_io_uring_enter, m_iFd, unsubmitted, unsigned(count - reaped),
+                                         IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                {
+                    reaped += Reap(fnDone);
+                    Drain(__atomic_load_n(m_pSQHead, __ATOMIC_ACQUIRE) - start, reaped, fnDone);
+                    return false;
+                }
+                reaped += Reap(fnDone);
+            }
+        }
+        return true;
+    }
+
+    //**************************************************************************
+
+    static auto PrepOpen(io_uring_sqe &cSQE, const char *szPath) -> void
+    {
+        cSQE.opcode = IORING_OP_OPENAT;
+        cSQE.fd = AT_FDCWD;
+        cSQE.addr = uint64_t(uintptr_t(szPath));
+        cSQE.open_flags = O_RDONLY | O_CLOEXEC;
+    }
+
+    static auto PrepStatx(io_uring_sqe &cSQE, const char *szPath, struct statx *pStat) -> void
+    {
+        cSQE.opcode = IORING_OP_STATX;
+        cSQE.fd = AT_FDCWD;
+        cSQE.addr = uint64_t(uintptr_t(szPath));
+        cSQE.len = STATX_SIZE;
+        cSQE.off = uint64_t(uintptr_t(pStat));
+    }
+
+    static auto PrepRead(io_uring_sqe &cSQE, const int iFd, uint8_t *pDest, const size_t qwSize,
+                         const uint64_t qwOffset) -> void
+    {
+        cSQE.opcode = IORING_OP_READ;
+        cSQE.fd = iFd;
+        cSQE.addr = uint64_t(uintptr_t(pDest));
+        cSQE.len = uint32_t(std::min(qwSize, MAX_READ));
+        cSQE.off = qwOffset;
+    }
+
+    static auto PrepClose(io_uring_sqe &cSQE, const int iFd) -> void
+    {
+        cSQE.opcode = IORING_OP_CLOSE;
+        cSQE.fd = iFd;
+    }
+};
+
+//******************************************************************************
+
+static thread_local std::unique_ptr<Uring> t_pRing;
+static thread_local bool t_bTried = false;
+
+/**
+ * @brief The ring of the calling thread, set up the first time it is
+ *        needed.  nullptr if io_uring is not available, or if the ring
+ *        stopped working.
+ */
+static auto ThreadRing() -> Uring *
+{
+    if (!t_bTried)
+    {
+        t_bTried = true;
+        auto ring = std::make_unique<Uring>();
+        if (ring->Init())
+        {
+            t_pRing = std::move(ring);
+        }
+    }
+    return t_pRing.get();
+}
+
+//******************************************************************************
+
+auto PosixReadFile(const std::string_view strFilePath) -> Platform::readResult_t
+{
+    using readError_e = Platform::readError_e;
+
+    const std::string path(strFilePath);
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return nonstd::make_unexpected(readError_e::file_not_found);
+    }
+    auto closeFile = nonstd::make_scope_exit([fd] { close(fd); });
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        return nonstd::make_unexpected(readError_e::file_read_error);
+    }
+
+    buffer_t rvo(size_t(st.st_size));
+    size_t done = 0;
+    while (done < rvo.size())
+    {
+        const ssize_t got = read(fd, rvo.data() + done, rvo.size() - done);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return nonstd::make_unexpected(readError_e::file_read_error);
+        }
+        if (got == 0)
+        {
+            // File got shorter since we sized it.
+            rvo.resize(done);
+            break;
+        }
+        done += size_t(got);
+    }
+    return rvo;
+}
+
+//******************************************************************************
+
+/**
+ * @brief A file being read through io_uring.
+ */
+struct uringFile_s
+{
+    std::string strPath;
+    int iFd = -1;
+    int iStatResult = 0;
+    struct statx cStat;
+    buffer_t cData;
+    size_t qwRead = 0;
+    bool bEOF = false;
+    std::optional<Platform::readError_e> eError;
+};
+
+/**
+ * @brief Number of files that are open at once.  Opening and sizing takes
+ *        two operations per file, which fills the ring once, and this stays
+ *        well under the usual limit of 1024 open files.
+ */
+static constexpr size_t URING_GROUP_FILES = 128;
+
+/**
+ * @brief Open, size, read and close a group of files.
+ *
+ * @return False if the ring stopped working.
+ */
+static auto UringReadGroup(Uring &cRing, const nonstd::span<uringFile_s> ncFiles) -> bool
+{
+    // Open and size everything.  Both go by path, so they can share a
+    // batch.
+    bool ok = cRing.Run(
+        ncFiles.size() * 2,
+        [&ncFiles](const size_t i, io_uring_sqe &cSQE) {
+            uringFile_s &file = ncFiles[i / 2];
+            if (i % 2 == 0)
+            {
+                Uring::PrepOpen(cSQE, file.strPath.c_str());
+            }
+            else
+            {
+                Uring::PrepStatx(cSQE, file.strPath.c_str(), &file.cStat);
+            }
+        },
+        [&ncFiles](const size_t i, const int iResult) {
+            uringFile_s &file = ncFiles[i / 2];
+            if (i % 2 == 0)
+            {
+                file.iFd = iResult;
+            }
+            else
+            {
+                file.iStatResult = iResult;
+            }
+        });
+
+    std::vector<size_t> reading;
+    for (size_t i = 0; i < ncFiles.size(); i++)
+    {
+        uringFile_s &file = ncFiles[i];
+        if (file.iFd < 0)
+        {
+            file.eError = Platform::readError_e::file_not_found;
+        }
+        else if (file.iStatResult < 0)
+        {
+            file.eError = Platform::readError_e::file_read_error;
+        }
+        else
+        {
+            file.cData.resize(size_t(file.cStat.stx_size));
+            reading.push_back(i);
+        }
+    }
+
+    // Read until every buffer is full, which is usually one pass.
+    while (ok)
+    {
+        std::vector<size_t> pending;
+        for (const size_t i : reading)
+        {
+            const uringFile_s &file = ncFiles[i];
+            if (!file.eError.has_value() && !file.bEOF && file.qwRead < file.cData.size())
+            {
+                pending.push_back(i);
+            }
+        }
+        if (pending.empty())
+        {
+            break;
+        }
+
+        ok = cRing.Run(
+            pending.size(),
+            [&ncFiles, &pending](const size_t i, io_uring_sqe &cSQE) {
+                uringFile_s &file = ncFiles[pending[i]];
+                Uring::PrepRead(cSQE, file.iFd, file.cData.data() + file.qwRead, file.cData.size() - file.qwRead,
+                                file.qwRead);
+            },
+            [&ncFiles, &pending](const size_t i, const int iResult) {
+                uringFile_s &file = ncFiles[pending[i]];
+                if (iResult == -EINTR || iResult == -EAGAIN)
+                {
+                    return;
+                }
+                if (iResult < 0)
+                {
+                    file.eError = Platform::readError_e::file_read_error;
+                }
+                else if (iResult == 0)
+                {
+                    // File got shorter since we sized it.
+                    file.bEOF = true;
+                    file.cData.resize(file.qwRead);
+                }
+                else
+                {
+                    file.qwRead += size_t(iResult);
+                }
+            });
+    }
+
+    // Close whatever we opened.  Anything the ring didn't close, because it
+    // gave up before or during the closes, is still ours, so close it the
+    // old-fashioned way.
+    std::vector<int> fds;
+    for (auto &file : ncFiles)
+    {
+        if (file.iFd >= 0)
+        {
+            fds.push_back(file.iFd);
+        }
+    }
+    if (ok)
+    {
+        ok = cRing.Run(
+            fds.size(), [&fds](const size_t i, io_uring_sqe &cSQE) { Uring::PrepClose(cSQE, fds[i]); },
+            [&fds](const size_t i, const int) { fds[i] = -1; });
+    }
+    for (const int fd : fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    return ok;
+}
+
+//******************************************************************************
+
+auto UringReadFiles(const nonstd::span<const std::string_view> nstrFilePaths)
+    -> std::optional<std::vector<Platform::readResult_t>>
+{
+    Uring *ring = ThreadRing();
+    if (ring == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<uringFile_s> files(nstrFilePaths.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        files[i].strPath = std::string(nstrFilePaths[i]);
+    }
+
+    // Groups that finished before the ring broke keep their results.
+    size_t finished = 0;
+    while (finished < files.size())
+    {
+        const size_t count = std::min(files.size() - finished, URING_GROUP_FILES);
+        if (!UringReadGroup(*ring, nonstd::span<uringFile_s>(files.data() + finished, count)))
+        {
+            // Don't trust this thread's ring again, so later batches go
+            // straight to PosixReadFile.
+            t_pRing.reset();
+            break;
+        }
+        finished += count;
+    }
+
+    std::vector<Platform::readResult_t> rvo;
+    rvo.reserve(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        uringFile_s &file = files[i];
+        if (i >= finished)
+        {
+            rvo.push_back(PosixReadFile(file.strPath));
+        }
+        else if (file.eError.has_value())
+        {
+            rvo.push_back(nonstd::make_unexpected(file.eError.value()));
+        }
+        else
+        {
+            rvo.push_back(std::move(file.cData));
+        }
+    }
+    return rvo;
+}
+
+} // namespace rock3d
@@ -0,0 +1,41 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief File reading for the Linux platform.
+ */
+
+#pragma once
+
+namespace rock3d
+{
+
+/**
+ * @brief Read a whole file with plain POSIX calls: one open, one fstat to
+ *        size the buffer, as few reads as the kernel allows, and a close.
+ *
+ * @param strFilePath File to read.
+ */
+auto PosixReadFile(const std::string_view strFilePath) -> Platform::readResult_t;
+
+/**
+ * @brief Read many whole files through io_uring.
+ *
+ * @details Files are taken a group at a time, so only so many are open at
+ *          once.  Every file in a group is opened and sized with statx in
+ *          one go, then read into a buffer of that size, then closed, with
+ *          each step submitted as one batch.  A few hundred files take a
+ *          handful of syscalls instead of several per file.
+ *
+ * @param nstrFilePaths Files to read.
+ * @return One result per file, in order, or nothing if io_uring is not
+ *         available on this kernel, in which case use PosixReadFile.  If
+ *         the ring breaks partway, files it didn't finish are read with
+ *         PosixReadFile, and later calls on this thread return nothing.
+ */
+auto UringReadFiles(const nonstd::span<const std::string_view> nstrFilePaths)
+    -> std::optional<std::vector<Platform::readResult_t>>;
+
+} // namespace rock3d
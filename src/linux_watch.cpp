@@ -0,0 +1,250 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief File watching for the Linux platform.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "linux_watch.h"
+
+namespace rock3d
+{
+
+/**
+ * @brief Everything that can change the contents of a file, or whether
+ *        it exists at all.
+ */
+static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+//******************************************************************************
+
+InotifyWatcher::~InotifyWatcher()
+{
+    if (m_iFd >= 0)
+    {
+        close(m_iFd);
+    }
+}
+
+//******************************************************************************
+
+auto InotifyWatcher::AddDir(const std::string &strDir, const bool bTree) -> int
+{
+    const int wd = inotify_add_watch(m_iFd, strDir.c_str(), WATCH_MASK | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        return wd;
+    }
+
+    // The kernel hands back the same watch for the same directory.  Events
+    // are reported under the first path it was watched through.
+    watch_s &watch = m_cWatches[wd];
+    if (watch.strDir.empty())
+    {
+        watch.strDir = strDir;
+    }
+    watch.bTree = watch.bTree || bTree;
+    return wd;
+}
+
+//******************************************************************************
+
+auto InotifyWatcher::AddTree(const std::string &strDir, std::vector<std::string> &nstrOutFiles,
+                             std::vector<fileID_t> &ncParents) -> bool
+{
+    // A symlink back up the tree would have us walking in circles.
+    struct stat dirStat;
+    if (stat(strDir.c_str(), &dirStat) != 0)
+    {
+        return false;
+    }
+    const fileID_t id{uint64_t(dirStat.st_dev), uint64_t(dirStat.st_ino)};
+    if (std::find(ncParents.begin(), ncParents.end(), id) != ncParents.end())
+    {
+        return true;
+    }
+
+    const int wd = AddDir(strDir, true);
+    if (wd < 0)
+    {
+        return false;
+    }
+    if (m_cWatches[wd].strDir != strDir)
+    {
+        // Already watched through a symlink, or the other way around.
+        return true;
+    }
+
+    // Watch first and list second, so nothing created in between is lost.
+    DIR *dir = opendir(strDir.c_str());
+    if (dir == nullptr)
+    {
+        return true;
+    }
+    auto closeDir = nonstd::make_scope_exit([dir] { closedir(dir); });
+    ncParents.push_back(id);
+    auto popParent = nonstd::make_scope_exit([&ncParents] { ncParents.pop_back(); });
+
+    while (const dirent *entry = readdir(dir))
+    {
+        const std::string_view name = entry->d_name;
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+
+        const std::string path = strDir + "/" + std::string(name);
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+        {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode))
+        {
+            AddTree(path, nstrOutFiles, ncParents);
+        }
+        else
+        {
+            nstrOutFiles.push_back(path);
+        }
+    }
+    return true;
+}
+
+//******************************************************************************
+
+auto InotifyWatcher::Watch(const std::string_view strPath) -> bool
+{
+    if (m_iFd < 0)
+    {
+        m_iFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_iFd < 0)
+        {
+            return false;
+        }
+    }
+
+    const std::string path(strPath);
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        if (std::find(m_nstrTrees.begin(), m_nstrTrees.end(), path) == m_nstrTrees.end())
+        {
+            m_nstrTrees.push_back(path);
+        }
+        std::vector<std::string> existing;
+        std::vector<fileID_t> parents;
+        return AddTree(path, existing, parents);
+    }
+
+    const size_t slash = path.rfind('/');
+    const std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    const std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    const int wd = AddDir(dir, false);
+    if (wd < 0)
+    {
+        return false;
+    }
+    m_cWatches[wd].cNames.insert(name);
+    return true;
+}
+
+//******************************************************************************
+
+auto InotifyWatcher::Poll() -> std::vector<std::string>
+{
+    std::vector<std::string> rvo;
+    if (m_iFd < 0)
+    {
+        return rvo;
+    }
+
+    bool overflow = false;
+    alignas(inotify_event) std::array<char, 16384> buffer;
+    for (;;)
+    {
+        const ssize_t bytes = read(m_iFd, buffer.data(), buffer.size());
+        if (bytes <= 0)
+        {
+            // EAGAIN, so we are caught up.
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < bytes;)
+        {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+            offset += ssize_t(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                overflow = true;
+                continue;
+            }
+
+            auto it = m_cWatches.find(event->wd);
+            if (it == m_cWatches.end())
+            {
+                continue;
+            }
+            if (event->mask & IN_IGNORED)
+            {
+                // Directory is gone, and so is its watch.
+                m_cWatches.erase(it);
+                continue;
+            }
+            if (event->len == 0)
+            {
+                continue;
+            }
+
+            const watch_s &watch = it->second;
+            const std::string name = event->name;
+            const std::string path = watch.strDir + "/" + name;
+            if (event->mask & IN_ISDIR)
+            {
+                // A new directory might already have files in it by the time
+                // we get to watch it, so they count as changed too.
+                if (watch.bTree && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                {
+                    std::vector<fileID_t> parents;
+                    AddTree(path, rvo, parents);
+                }
+                continue;
+            }
+            if (watch.bTree || watch.cNames.count(name) != 0)
+            {
+                rvo.push_back(path);
+            }
+        }
+    }
+
+    if (overflow)
+    {
+        // Walking the trees again also watches directories whose creation
+        // we missed.
+        for (const std::string &tree : m_nstrTrees)
+        {
+            std::vector<fileID_t> parents;
+            AddTree(tree, rvo, parents);
+        }
+        for (const auto &[wd, watch] : m_cWatches)
+        {
+            for (const std::string &name : watch.cNames)
+            {
+                rvo.push_back(watch.strDir + "/" + name);
+            }
+        }
+    }
+    return rvo;
+}
+
+} // namespace rock3d
@@ -0,0 +1,68 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief File watching for the Linux platform.
+ */
+
+#pragma once
+
+namespace rock3d
+{
+
+/**
+ * @brief Watches files and directory trees with inotify.
+ *
+ * @details inotify only watches single directories, so every directory of
+ *          a tree gets its own watch, and directories created later are
+ *          picked up as they appear.  Single files are watched through
+ *          their parent directory, since tools usually replace a file by
+ *          renaming a new one over it, which a watch on the file itself
+ *          would never see.
+ */
+class InotifyWatcher final
+{
+    struct watch_s
+    {
+        std::string strDir;
+        bool bTree = false;                     // Report every file, and watch new subdirectories.
+        std::unordered_set<std::string> cNames; // Files to report, if not watching the whole tree.
+    };
+
+    using fileID_t = std::pair<uint64_t, uint64_t>; // Device and inode.
+
+    int m_iFd = -1;
+    std::unordered_map<int, watch_s> m_cWatches;
+    std::vector<std::string> m_nstrTrees; // Directories passed to Watch, to walk again if events are lost.
+
+    auto AddDir(const std::string &strDir, const bool bTree) -> int;
+    auto AddTree(const std::string &strDir, std::vector<std::string> &nstrOutFiles, std::vector<fileID_t> &ncParents)
+        -> bool;
+
+  public:
+    InotifyWatcher() {}
+    ~InotifyWatcher();
+    ROCK3D_NOCOPY(InotifyWatcher);
+
+    /**
+     * @brief Start watching a file, or every file under a directory.
+     *
+     * @return True if the path is being watched.
+     */
+    auto Watch(const std::string_view strPath) -> bool;
+
+    /**
+     * @brief Read every event that is waiting, without blocking.
+     *
+     * @details If the kernel had to throw events away, there's no telling
+     *          what changed, so every file that is being watched is
+     *          reported.
+     *
+     * @return Paths of the files that changed.
+     */
+    auto Poll() -> std::vector<std::string>;
+};
+
+} // namespace rock3d
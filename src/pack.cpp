@@ -0,0 +1,433 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Pack archives of assets.
+ *
+ * @details A pack file is laid out as follows, with all integers little
+ *          endian:
+ *
+ *          - header_s
+ *          - One tocEntry_s per entry, sorted by path hash, then by path.
+ *          - Entry paths, back to back, with no terminators.
+ *          - Entry data, every entry starting on a multiple of ALIGNMENT.
+ *
+ *          Compressed entries are split into chunks of CHUNK_SIZE bytes
+ *          before compressing, so one big entry can be decompressed by
+ *          several threads at once.  The stored data starts with the
+ *          compressed size of every chunk as a uint32_t, followed by the
+ *          chunks back to back.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include "lz4.h"
+#include "lz4hc.h"
+
+namespace rock3d
+{
+
+//******************************************************************************
+
+class PackImpl final : public Pack
+{
+    static constexpr uint32_t VERSION = 2;
+    static constexpr char MAGIC[8] = {'R', '3', 'D', 'P', 'A', 'C', 'K', '\0'};
+    static constexpr uint64_t ALIGNMENT = 4096;
+    static constexpr uint64_t CHUNK_SIZE = 256 * 1024;
+
+    enum class compression_e : uint32_t
+    {
+        none,
+        lz4,
+    };
+
+    struct header_s
+    {
+        char szMagic[8];
+        uint32_t dwVersion;
+        uint32_t dwEntries;
+        uint64_t qwNamesOffset;
+        uint64_t qwNamesSize;
+    };
+
+    struct tocEntry_s
+    {
+        uint64_t qwHash;
+        uint64_t qwOffset;
+        uint64_t qwSize;       // Size of the asset.
+        uint64_t qwStoredSize; // Size of the data in the pack, after compression.
+        uint32_t dwNameOffset;
+        uint32_t dwNameLength;
+        compression_e eCompression;
+        uint32_t dwReserved;
+    };
+
+    bufferView_s m_cFile;
+    std::vector<tocEntry_s> m_ncEntries;
+    std::string_view m_strNames;
+
+    std::atomic<uint64_t> m_qwStatEntries = 0;
+    std::atomic<uint64_t> m_qwStatPackedBytes = 0;
+    std::atomic<uint64_t> m_qwStatUnpackedBytes = 0;
+    std::atomic<uint64_t> m_qwStatWorkUS = 0;
+
+    static auto HashPath(const std::string_view strPath) -> uint64_t
+    {
+        const auto *bytes = reinterpret_cast<const uint8_t *>(strPath.data());
+        return HashFNV1a64(nonstd::span<const uint8_t>(bytes, strPath.size()));
+    }
+
+    static auto AlignUp(const uint64_t qwValue) -> uint64_t
+    {
+        return (qwValue + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    static auto ChunkCount(const uint64_t qwSize) -> uint64_t
+    {
+        return (qwSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+
+    auto Name(const tocEntry_s &cEntry) const -> std::string_view
+    {
+        return m_strNames.substr(cEntry.dwNameOffset, cEntry.dwNameLength);
+    }
+
+    auto Stored(const tocEntry_s &cEntry) const -> nonstd::span<const uint8_t>
+    {
+        return m_cFile.cSpan.subspan(size_t(cEntry.qwOffset), size_t(cEntry.qwStoredSize));
+    }
+
+    auto Lookup(const std::string_view strPath) const -> const tocEntry_s *
+    {
+        const uint64_t hash = HashPath(strPath);
+        auto it = std::lower_bound(
+            m_ncEntries.begin(), m_ncEntries.end(), hash,
+            [](const tocEntry_s &cEntry, const uint64_t qwHash) { return cEntry.qwHash < qwHash; });
+        for (; it != m_ncEntries.end() && it->qwHash == hash; ++it)
+        {
+            if (Name(*it) == strPath)
+            {
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Decompress an entry straight into its destination, with every
+     *        chunk handed to a worker.
+     *
+     * @param cEntry Compressed entry.
+     * @param pDest Buffer of cEntry.qwSize bytes to decompress into.
+     * @return True if every chunk decompressed to exactly the right size.
+     */
+    auto Unpack(const tocEntry_s &cEntry, uint8_t *pDest) -> bool
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        const nonstd::span<const uint8_t> stored = Stored(cEntry);
+        const uint64_t chunks = ChunkCount(cEntry.qwSize);
+        if (chunks * sizeof(uint32_t) > stored.size())
+        {
+            return false;
+        }
+
+        // Find where each chunk starts, and make sure they all fit.
+        std::vector<uint64_t> offsets(size_t(chunks) + 1);
+        offsets[0] = chunks * sizeof(uint32_t);
+        for (size_t i = 0; i < chunks; i++)
+        {
+            uint32_t size;
+            std::memcpy(&size, stored.data() + (i * sizeof(uint32_t)), sizeof(size));
+            offsets[i + 1] = offsets[i] + size;
+        }
+        if (offsets.back() != stored.size())
+        {
+            return false;
+        }
+
+        std::atomic<bool> ok = true;
+        GetWorkers().ParallelFor(size_t(chunks), [&cEntry, pDest, &stored, &offsets, &ok](const size_t i) {
+            const uint64_t begin = i * CHUNK_SIZE;
+            const int size = int(std::min(CHUNK_SIZE, cEntry.qwSize - begin));
+            const int read = LZ4_decompress_safe(reinterpret_cast<const char *>(stored.data() + offsets[i]),
+                                                 reinterpret_cast<char *>(pDest + begin),
+                                                 int(offsets[i + 1] - offsets[i]), size);
+            if (read != size)
+            {
+                ok = false;
+            }
+        });
+
+        m_qwStatEntries += 1;
+        m_qwStatPackedBytes += cEntry.qwStoredSize;
+        m_qwStatUnpackedBytes += cEntry.qwSize;
+        m_qwStatWorkUS += uint64_t(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        return ok;
+    }
+
+    /**
+     * @brief Compress an asset in chunks, as Unpack expects.
+     */
+    static auto Compress(const buffer_t &cData) -> buffer_t
+    {
+        const uint64_t chunks = ChunkCount(cData.size());
+        buffer_t rvo(size_t(chunks * sizeof(uint32_t)));
+        const int bound = LZ4_compressBound(int(CHUNK_SIZE));
+        std::vector<char> scratch(static_cast<size_t>(bound));
+        for (size_t i = 0; i < chunks; i++)
+        {
+            const uint64_t begin = i * CHUNK_SIZE;
+            const int size = int(std::min(CHUNK_SIZE, cData.size() - begin));
+            const int packed = LZ4_compress_HC(reinterpret_cast<const char *>(cData.data() + begin), scratch.data(),
+                                               size, int(scratch.size()), LZ4HC_CLEVEL_DEFAULT);
+            const uint32_t packedSize = uint32_t(packed);
+            std::memcpy(rvo.data() + (i * sizeof(uint32_t)), &packedSize, sizeof(packedSize));
+            rvo.insert(rvo.end(), scratch.begin(), scratch.begin() + packed);
+        }
+        return rvo;
+    }
+
+  public:
+    /**
+     * @brief Check the pack and read its table of contents.
+     *
+     * @details Everything is bounds-checked here, so lookups don't have to.
+     */
+    auto Init(bufferView_s &&cFile) -> bool
+    {
+        const nonstd::span<const uint8_t> data = cFile.cSpan;
+
+        header_s header;
+        if (data.size() < sizeof(header))
+        {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.szMagic, MAGIC, sizeof(MAGIC)) != 0 || header.dwVersion != VERSION)
+        {
+            return false;
+        }
+
+        const uint64_t tocSize = uint64_t(header.dwEntries) * sizeof(tocEntry_s);
+        if (tocSize > data.size() - sizeof(header) || header.qwNamesOffset != sizeof(header) + tocSize ||
+            header.qwNamesSize > data.size() - header.qwNamesOffset)
+        {
+            return false;
+        }
+        m_strNames = std::string_view(reinterpret_cast<const char *>(data.data() + header.qwNamesOffset),
+                                      size_t(header.qwNamesSize));
+
+        m_ncEntries.resize(header.dwEntries);
+        std::memcpy(m_ncEntries.data(), data.data() + sizeof(header), size_t(tocSize));
+        for (size_t i = 0; i < m_ncEntries.size(); i++)
+        {
+            const tocEntry_s &entry = m_ncEntries[i];
+            if (entry.qwOffset % ALIGNMENT != 0 || entry.qwOffset > data.size() ||
+                entry.qwStoredSize > data.size() - entry.qwOffset || entry.dwNameOffset > header.qwNamesSize ||
+                entry.dwNameLength > header.qwNamesSize - entry.dwNameOffset ||
+                entry.qwHash != HashPath(Name(entry)))
+            {
+                return false;
+            }
+            if (entry.eCompression == compression_e::none ? entry.qwStoredSize != entry.qwSize
+                                                           : entry.eCompression != compression_e::lz4)
+            {
+                return false;
+            }
+            if (i > 0 && entry.qwHash < m_ncEntries[i - 1].qwHash)
+            {
+                // Out of order, so lookups would miss things.
+                return false;
+            }
+        }
+
+        m_cFile = std::move(cFile);
+        return true;
+    }
+
+    //**************************************************************************
+
+    auto EntryCount() -> size_t override
+    {
+        return m_ncEntries.size();
+    }
+
+    //**************************************************************************
+
+    auto EntryPath(const size_t qwIndex) -> std::string_view override
+    {
+        if (qwIndex >= m_ncEntries.size())
+        {
+            return {};
+        }
+        return Name(m_ncEntries[qwIndex]);
+    }
+
+    //**************************************************************************
+
+    auto Read(const std::string_view strPath) -> std::optional<buffer_t> override
+    {
+        const tocEntry_s *entry = Lookup(strPath);
+        if (entry == nullptr)
+        {
+            return std::nullopt;
+        }
+        if (entry->eCompression == compression_e::none)
+        {
+            const nonstd::span<const uint8_t> stored = Stored(*entry);
+            return buffer_t(stored.begin(), stored.end());
+        }
+
+        buffer_t rvo(size_t(entry->qwSize));
+        if (!Unpack(*entry, rvo.data()))
+        {
+            return std::nullopt;
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto FindView(const std::string_view strPath) -> std::optional<bufferView_s> override
+    {
+        const tocEntry_s *entry = Lookup(strPath);
+        if (entry == nullptr)
+        {
+            return std::nullopt;
+        }
+        if (entry->eCompression == compression_e::none)
+        {
+            return bufferView_s{Stored(*entry), m_cFile.pOwner};
+        }
+
+        // The view owns the buffer it points into.
+        auto owner = std::make_shared<buffer_t>(size_t(entry->qwSize));
+        if (!Unpack(*entry, owner->data()))
+        {
+            return std::nullopt;
+        }
+        return bufferView_s{nonstd::span<const uint8_t>(owner->data(), owner->size()), owner};
+    }
+
+    //**************************************************************************
+
+    auto Stats() -> stats_s override
+    {
+        stats_s rvo;
+        rvo.qwEntries = m_qwStatEntries;
+        rvo.qwPackedBytes = m_qwStatPackedBytes;
+        rvo.qwUnpackedBytes = m_qwStatUnpackedBytes;
+        rvo.qwWorkUS = m_qwStatWorkUS;
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    static auto BuildImpl(const nonstd::span<const entry_s> ncEntries) -> buffer_t
+    {
+        std::vector<size_t> order(ncEntries.size());
+        std::vector<uint64_t> hashes(ncEntries.size());
+        for (size_t i = 0; i < ncEntries.size(); i++)
+        {
+            order[i] = i;
+            hashes[i] = HashPath(ncEntries[i].strPath);
+        }
+        std::sort(order.begin(), order.end(), [&ncEntries, &hashes](const size_t a, const size_t b) {
+            if (hashes[a] != hashes[b])
+            {
+                return hashes[a] < hashes[b];
+            }
+            return ncEntries[a].strPath < ncEntries[b].strPath;
+        });
+
+        header_s header{};
+        std::memcpy(header.szMagic, MAGIC, sizeof(MAGIC));
+        header.dwVersion = VERSION;
+        header.dwEntries = uint32_t(ncEntries.size());
+        header.qwNamesOffset = sizeof(header_s) + (uint64_t(ncEntries.size()) * sizeof(tocEntry_s));
+
+        // Compression is only worth it if it saves at least an eighth,
+        // otherwise the entry is stored as-is and can be mapped directly.
+        std::vector<std::optional<buffer_t>> packed(ncEntries.size());
+        GetWorkers().ParallelFor(ncEntries.size(), [&ncEntries, &packed](const size_t i) {
+            const buffer_t &data = ncEntries[i].cData;
+            if (!ncEntries[i].bCompress || data.empty())
+            {
+                return;
+            }
+            buffer_t compressed = Compress(data);
+            if (compressed.size() < data.size() - (data.size() / 8))
+            {
+                packed[i] = std::move(compressed);
+            }
+        });
+
+        std::string names;
+        std::vector<tocEntry_s> toc;
+        for (const size_t i : order)
+        {
+            tocEntry_s entry{};
+            entry.qwHash = hashes[i];
+            entry.qwSize = ncEntries[i].cData.size();
+            entry.qwStoredSize = packed[i].has_value() ? packed[i]->size() : entry.qwSize;
+            entry.eCompression = packed[i].has_value() ? compression_e::lz4 : compression_e::none;
+            entry.dwNameOffset = uint32_t(names.size());
+            entry.dwNameLength = uint32_t(ncEntries[i].strPath.size());
+            names += ncEntries[i].strPath;
+            toc.push_back(entry);
+        }
+        header.qwNamesSize = names.size();
+
+        // Data goes in the same order as the table of contents.
+        uint64_t offset = AlignUp(header.qwNamesOffset + header.qwNamesSize);
+        for (size_t i = 0; i < toc.size(); i++)
+        {
+            toc[i].qwOffset = offset;
+            offset = AlignUp(offset + toc[i].qwStoredSize);
+        }
+
+        buffer_t rvo(size_t(offset), 0);
+        std::memcpy(rvo.data(), &header, sizeof(header));
+        std::memcpy(rvo.data() + sizeof(header), toc.data(), toc.size() * sizeof(tocEntry_s));
+        std::memcpy(rvo.data() + header.qwNamesOffset, names.data(), names.size());
+        for (size_t i = 0; i < toc.size(); i++)
+        {
+            const size_t index = order[i];
+            const buffer_t &data = packed[index].has_value() ? packed[index].value() : ncEntries[index].cData;
+            std::memcpy(rvo.data() + toc[i].qwOffset, data.data(), data.size());
+        }
+        return rvo;
+    }
+};
+
+//******************************************************************************
+
+auto Pack::Open(const std::string_view strFilePath) -> openResult_t
+{
+    auto maybeFile = GetPlatform().MapFile(strFilePath);
+    if (!maybeFile.has_value())
+    {
+        return nonstd::make_unexpected(openError_e::file_not_found);
+    }
+
+    auto rvo = std::make_unique<PackImpl>();
+    if (!rvo->Init(std::move(maybeFile.value())))
+    {
+        return nonstd::make_unexpected(openError_e::bad_format);
+    }
+    return rvo;
+}
+
+//******************************************************************************
+
+auto Pack::Build(const nonstd::span<const entry_s> ncEntries) -> buffer_t
+{
+    return PackImpl::BuildImpl(ncEntries);
+}
+
+} // namespace rock3d
@@ -0,0 +1,493 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief This is a platform implementation for Linux, which utilizes SDL
+ *        for the window and input, and POSIX for everything else.
+ *
+ * @details Pass -headless, or run without a display, and no window is
+ *          created.  bgfx then runs with its Noop renderer, so the engine
+ *          can run on servers and CI boxes that have no GPU.
+ *
+ *          bgfx renders on a thread of its own, unless -singlethreaded is
+ *          passed.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SDL2/SDL.h"
+#include "SDL2/SDL_syswm.h"
+
+#include "bgfx/platform.h"
+
+#include "linux_io.h"
+#include "linux_watch.h"
+#include "render_thread.h"
+#include "sdl_events.h"
+
+namespace rock3d
+{
+
+class LinuxPlatform final : public Platform
+{
+    constexpr static int DEFAULT_SCREEN_WIDTH = 1280;
+    constexpr static int DEFAULT_SCREEN_HEIGHT = 720;
+
+    /**
+     * @brief Batches smaller than this are read with plain POSIX calls,
+     *        since setting up a ring costs a few syscalls of its own.
+     */
+    constexpr static size_t URING_MIN_FILES = 16;
+
+    SDL_Window *m_pWindow = nullptr;
+    bool m_bHeadless = false;
+    RenderThread m_cRender;
+    std::atomic<bool> m_bNoUring = false; // io_uring turned out to be unavailable.
+    InotifyWatcher m_cWatcher;
+
+  public:
+    auto Init(const args_t &nstrArgs) -> void override
+    {
+        m_bHeadless = std::find(nstrArgs.begin(), nstrArgs.end(), "-headless") != nstrArgs.end() ||
+                        (std::getenv("DISPLAY") == nullptr && std::getenv("WAYLAND_DISPLAY") == nullptr);
+
+        // Initialize SDL, leaving out video if there is nowhere to show it.
+        const Uint32 subsystems = m_bHeadless ? SDL_INIT_EVENTS | SDL_INIT_TIMER : SDL_INIT_EVERYTHING;
+        if (SDL_Init(subsystems) < 0)
+        {
+            GetPlatform().FatalError(SDL_GetError());
+            return;
+        }
+
+        bgfx::PlatformData pd{};
+        glm::ivec2 res{DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT};
+        if (!m_bHeadless)
+        {
+            m_pWindow = SDL_CreateWindow(AppConfig().szName, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                         DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+            if (m_pWindow == nullptr)
+            {
+                GetPlatform().FatalError(SDL_GetError());
+                return;
+            }
+
+            // Attach bgfx to SDL window.
+            SDL_SysWMinfo wmi;
+            SDL_VERSION(&wmi.version);
+            if (!SDL_GetWindowWMInfo(m_pWindow, &wmi))
+            {
+                GetPlatform().FatalError(SDL_GetError());
+                return;
+            }
+            if (wmi.subsystem == SDL_SYSWM_WAYLAND)
+            {
+                pd.ndt = wmi.info.wl.display;
+                pd.nwh = wmi.info.wl.surface;
+                pd.type = bgfx::NativeWindowHandleType::Wayland;
+            }
+            else
+            {
+                pd.ndt = wmi.info.x11.display;
+                pd.nwh = reinterpret_cast<void *>(uintptr_t(wmi.info.x11.window));
+            }
+            res = WindowResolution();
+        }
+
+        // Initialize bgfx.
+        bgfx::setPlatformData(pd);
+
+        bgfx::Init bgfx_init;
+        bgfx_init.type = m_bHeadless ? bgfx::RendererType::Noop : bgfx::RendererType::Vulkan;
+        bgfx_init.resolution.width = res.x;
+        bgfx_init.resolution.height = res.y;
+        bgfx_init.resolution.reset = m_bHeadless ? BGFX_RESET_NONE : BGFX_RESET_VSYNC;
+        bgfx_init.platformData = pd;
+        bgfx_init.limits.maxEncoders = uint16_t(std::min<size_t>(GetWorkers().ThreadCount() + 1, UINT16_MAX));
+        const bool threaded = std::find(nstrArgs.begin(), nstrArgs.end(), "-singlethreaded") == nstrArgs.end();
+        if (!m_cRender.Init(bgfx_init, threaded))
+        {
+            GetPlatform().FatalError("Could not initialize bgfx.");
+            return;
+        }
+
+        bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x007ffffff, 1.0f, 0);
+        bgfx::setViewRect(0, 0, 0, uint16_t(res.x), uint16_t(res.y));
+    }
+
+    //**************************************************************************
+
+    auto Shutdown() -> void override
+    {
+        m_cRender.Shutdown();
+
+        if (m_pWindow)
+        {
+            SDL_DestroyWindow(m_pWindow);
+            m_pWindow = nullptr;
+        }
+
+        SDL_Quit();
+    }
+
+    //**************************************************************************
+
+    auto TimeMS() -> uint64_t override
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t(ts.tv_sec) * 1000) + (uint64_t(ts.tv_nsec) / 1000000);
+    }
+
+    //**************************************************************************
+
+    auto TimeNS() -> uint64_t override
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t(ts.tv_sec) * 1000000000) + uint64_t(ts.tv_nsec);
+    }
+
+    //**************************************************************************
+
+    auto SleepMS(const uint32_t dwMillis) -> void override
+    {
+        timespec ts{time_t(dwMillis / 1000), long(dwMillis % 1000) * 1000000};
+        while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR)
+        {
+            // Interrupted by a signal, sleep for whatever is left.
+        }
+    }
+
+    //**************************************************************************
+
+    auto WindowHandle() -> void * override
+    {
+        SDL_SysWMinfo info;
+        SDL_VERSION(&info.version);
+        if (m_pWindow == nullptr || !SDL_GetWindowWMInfo(m_pWindow, &info))
+        {
+            return nullptr;
+        }
+        if (info.subsystem == SDL_SYSWM_WAYLAND)
+        {
+            return info.info.wl.surface;
+        }
+        return reinterpret_cast<void *>(uintptr_t(info.info.x11.window));
+    }
+
+    //**************************************************************************
+
+    auto WindowResolution() -> glm::ivec2 override
+    {
+        if (m_pWindow == nullptr)
+        {
+            return glm::ivec2{DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT};
+        }
+
+        glm::ivec2 rvo;
+        SDL_GetWindowSize(m_pWindow, &rvo.x, &rvo.y);
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto GetBasePath() -> std::string_view override
+    {
+        static std::string basePath;
+        if (basePath.empty())
+        {
+            char *path = SDL_GetBasePath();
+            basePath = path != nullptr ? path : "./";
+            SDL_free(path);
+        }
+        return basePath;
+    }
+
+    //**************************************************************************
+
+    auto GetPrefPath() -> std::string_view override
+    {
+        static std::string prefPath;
+        if (prefPath.empty())
+        {
+            char *path = SDL_GetPrefPath("rock3d", AppConfig().szName);
+            if (path == nullptr)
+            {
+                GetPlatform().FatalError(SDL_GetError());
+            }
+            prefPath = path;
+            SDL_free(path);
+        }
+        return prefPath;
+    }
+
+    //**************************************************************************
+
+    [[noreturn]] auto FatalError(const std::string_view strError) -> void override
+    {
+        // Servers have nobody to click a message box, so always log it.
+        const std::string error(strError);
+        std::fprintf(stderr, "rock3d Error: %s\n", error.c_str());
+        if (m_pWindow != nullptr)
+        {
+            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "rock3d Error", error.c_str(), m_pWindow);
+        }
+
+        exit(EXIT_FAILURE);
+    }
+
+    //**************************************************************************
+
+    auto ReadFileToBuffer(const std::string_view strFilePath) -> readResult_t override
+    {
+        return PosixReadFile(strFilePath);
+    }
+
+    //**************************************************************************
+
+    auto ReadFilesToBuffers(const nonstd::span<const std::string_view> nstrFilePaths)
+        -> std::vector<readResult_t> override
+    {
+        if (nstrFilePaths.size() >= URING_MIN_FILES && !m_bNoUring)
+        {
+            auto maybeFiles = UringReadFiles(nstrFilePaths);
+            if (maybeFiles.has_value())
+            {
+                return std::move(maybeFiles.value());
+            }
+            m_bNoUring = true;
+        }
+
+        std::vector<readResult_t> rvo;
+        rvo.reserve(nstrFilePaths.size());
+        for (auto &path : nstrFilePaths)
+        {
+            rvo.push_back(PosixReadFile(path));
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto MapFile(const std::string_view strFilePath) -> mapResult_t override
+    {
+        const std::string path(strFilePath);
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return nonstd::make_unexpected(readError_e::file_not_found);
+        }
+        auto closeFile = nonstd::make_scope_exit([fd] { close(fd); });
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            return nonstd::make_unexpected(readError_e::file_read_error);
+        }
+        if (st.st_size == 0)
+        {
+            // Empty files can't be mapped.
+            return bufferView_s{};
+        }
+
+        // The mapping stays alive on its own once the file is closed.
+        const size_t size = size_t(st.st_size);
+        void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+        {
+            return nonstd::make_unexpected(readError_e::file_read_error);
+        }
+
+        bufferView_s rvo;
+        rvo.cSpan = nonstd::span<const uint8_t>(static_cast<const uint8_t *>(view), size);
+        rvo.pOwner = std::shared_ptr<const void>(view, [size](const void *pView) {
+            munmap(const_cast<void *>(pView), size);
+        });
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto ListFiles(const std::string_view strDirPath) -> listResult_t override
+    {
+        const std::string root(strDirPath);
+
+        // Every directory we listed, and the index of the one it was found
+        // in, so a symlink back into one of its own parents can be caught.
+        struct listed_s
+        {
+            dev_t qwDev;
+            ino_t qwIno;
+            size_t qwParent;
+        };
+        std::vector<listed_s> listed;
+
+        // Directories left to visit, relative to the root, and the index
+        // of their parent in listed.
+        std::vector<std::string> rvo;
+        std::vector<std::pair<std::string, size_t>> dirs{{"", SIZE_MAX}};
+        while (!dirs.empty())
+        {
+            const std::string dir = std::move(dirs.back().first);
+            const size_t parent = dirs.back().second;
+            dirs.pop_back();
+
+            DIR *dh = opendir((root + "/" + dir).c_str());
+            if (dh == nullptr)
+            {
+                if (dir.empty())
+                {
+                    return nonstd::make_unexpected(readError_e::file_not_found);
+                }
+                continue;
+            }
+            auto closeDir = nonstd::make_scope_exit([dh] { closedir(dh); });
+
+            // A directory reached through a symlink elsewhere in the tree is
+            // listed under both paths, but one inside itself would loop.
+            struct stat dirStat;
+            if (fstat(dirfd(dh), &dirStat) != 0)
+            {
+                continue;
+            }
+            bool loop = false;
+            for (size_t i = parent; i != SIZE_MAX && !loop; i = listed[i].qwParent)
+            {
+                loop = listed[i].qwDev == dirStat.st_dev && listed[i].qwIno == dirStat.st_ino;
+            }
+            if (loop)
+            {
+                continue;
+            }
+            listed.push_back(listed_s{dirStat.st_dev, dirStat.st_ino, parent});
+            const size_t self = listed.size() - 1;
+
+            while (const dirent *entry = readdir(dh))
+            {
+                const std::string_view name = entry->d_name;
+                if (name == "." || name == "..")
+                {
+                    continue;
+                }
+
+                // Some filesystems don't fill in the type, so ask for it.
+                bool isDir = entry->d_type == DT_DIR;
+                if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+                {
+                    struct stat st;
+                    isDir = fstatat(dirfd(dh), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+                }
+
+                if (isDir)
+                {
+                    dirs.emplace_back(dir + std::string(name) + "/", self);
+                    continue;
+                }
+                rvo.push_back(dir + std::string(name));
+            }
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto WatchPath(const std::string_view strPath) -> bool override
+    {
+        return m_cWatcher.Watch(strPath);
+    }
+
+    //**************************************************************************
+
+    auto PollChangedFiles() -> std::vector<std::string> override
+    {
+        return m_cWatcher.Poll();
+    }
+
+    //**************************************************************************
+
+    auto WriteFileFromBuffer(const std::string_view strFilePath, const nonstd::span<const uint8_t> cData)
+        -> bool override
+    {
+        const std::string filePath(strFilePath);
+        const std::string tempPath = filePath + ".tmp";
+        const int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        size_t written = 0;
+        while (written < cData.size())
+        {
+            const ssize_t wrote = write(fd, cData.data() + written, cData.size() - written);
+            if (wrote < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (wrote <= 0)
+            {
+                close(fd);
+                unlink(tempPath.c_str());
+                return false;
+            }
+            written += size_t(wrote);
+        }
+        close(fd);
+
+        if (rename(tempPath.c_str(), filePath.c_str()) != 0)
+        {
+            unlink(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    //**************************************************************************
+
+    auto PumpEvents() -> void override
+    {
+        SDLPumpEvents();
+    }
+
+    //**************************************************************************
+
+    auto WaitEvents(const uint32_t dwTimeoutMS) -> bool override
+    {
+        return SDLWaitEvents(dwTimeoutMS);
+    }
+};
+
+//******************************************************************************
+
+auto GetPlatform() -> Platform &
+{
+    static LinuxPlatform platform;
+    return platform;
+}
+
+} // namespace rock3d
+
+//******************************************************************************
+
+auto main(int argc, char *argv[]) -> int
+{
+    std::vector<std::string_view> args;
+    for (int i = 0; i < argc; i++)
+    {
+        args.push_back(std::string_view(argv[i]));
+    }
+    rock3d::EngineMain(args);
+}
@@ -6,10 +6,18 @@
 /**
  * @brief This is a platform implementation for Win32, which utilizes SDL
  *        for many pieces for functionality.
+ *
+ * @details Pass -headless and no window is created.  bgfx then runs with its
+ *          Noop renderer.
+ *
+ *          bgfx renders on a thread of its own, unless -singlethreaded is
+ *          passed.
  */
 
 #include "rock3d/rock3d.h"
 
+#include <cstdio>
+
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <stringapiset.h>
@@ -19,6 +27,9 @@
 
 #include "bgfx/platform.h"
 
+#include "render_thread.h"
+#include "sdl_events.h"
+
 namespace rock3d
 {
 
@@ -70,6 +81,44 @@ static auto UTF8ToWString(const std::string_view strInput) -> nonstd::expected<s
     return rvo;
 }
 
+/**
+ * @brief Convert a wstring from Wide Win32 functions to UTF8.
+ *
+ * @param strInput String to convert.
+ * @return A converted UTF8 string.
+ */
+static auto WStringToUTF8(const std::wstring_view strInput) -> nonstd::expected<std::string, encodeError_e>
+{
+    if (strInput.empty())
+    {
+        return std::string();
+    }
+
+    const int length = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, strInput.data(), int(strInput.size()),
+                                           nullptr, 0, nullptr, nullptr);
+    if (length == 0)
+    {
+        DWORD err = GetLastError();
+        if (err == ERROR_NO_UNICODE_TRANSLATION)
+        {
+            return nonstd::make_unexpected(encodeError_e::invalid_unicode);
+        }
+        return nonstd::make_unexpected(encodeError_e::internal_error);
+    }
+
+    std::string rvo;
+    rvo.resize(length);
+
+    const int ok = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, strInput.data(), int(strInput.size()),
+                                       rvo.data(), int(rvo.size()), nullptr, nullptr);
+    if (ok == 0)
+    {
+        return nonstd::make_unexpected(encodeError_e::internal_error);
+    }
+
+    return rvo;
+}
+
 //******************************************************************************
 
 class Win32Platform final : public Platform
@@ -80,57 +129,69 @@ class Win32Platform final : public Platform
     SDL_Window *m_pWindow = nullptr;
     SDL_Surface *m_pSurface = nullptr;
     HWND handle = nullptr;
+    bool m_bHeadless = false;
+    RenderThread m_cRender;
 
   public:
     auto Init(const args_t &nstrArgs) -> void override
     {
-        (void)nstrArgs;
+        m_bHeadless = std::find(nstrArgs.begin(), nstrArgs.end(), "-headless") != nstrArgs.end();
 
-        // Initialize SDL.
-        if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
+        // Initialize SDL, leaving out video if there is no window.
+        const Uint32 subsystems = m_bHeadless ? SDL_INIT_EVENTS | SDL_INIT_TIMER : SDL_INIT_EVERYTHING;
+        if (SDL_Init(subsystems) < 0)
         {
             GetPlatform().FatalError(SDL_GetError());
             return;
         }
 
-        m_pWindow = SDL_CreateWindow(AppConfig().szName, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                                     DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-        if (m_pWindow == nullptr)
+        bgfx::PlatformData pd{};
+        glm::ivec2 res{DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT};
+        if (!m_bHeadless)
         {
-            GetPlatform().FatalError(SDL_GetError());
-            return;
-        }
+            m_pWindow = SDL_CreateWindow(AppConfig().szName, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                         DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+            if (m_pWindow == nullptr)
+            {
+                GetPlatform().FatalError(SDL_GetError());
+                return;
+            }
 
-        m_pSurface = SDL_GetWindowSurface(m_pWindow);
-        if (m_pSurface == nullptr)
-        {
-            GetPlatform().FatalError(SDL_GetError());
-            return;
-        }
+            m_pSurface = SDL_GetWindowSurface(m_pWindow);
+            if (m_pSurface == nullptr)
+            {
+                GetPlatform().FatalError(SDL_GetError());
+                return;
+            }
 
-        // Attach bgfx to SDL window.
-        SDL_SysWMinfo wmi;
-        SDL_VERSION(&wmi.version);
-        if (!SDL_GetWindowWMInfo(m_pWindow, &wmi))
-        {
-            GetPlatform().FatalError(SDL_GetError());
-            return;
+            // Attach bgfx to SDL window.
+            SDL_SysWMinfo wmi;
+            SDL_VERSION(&wmi.version);
+            if (!SDL_GetWindowWMInfo(m_pWindow, &wmi))
+            {
+                GetPlatform().FatalError(SDL_GetError());
+                return;
+            }
+            pd.nwh = wmi.info.win.window;
+            res = WindowResolution();
         }
-        glm::ivec2 res = WindowResolution();
 
         // Initialize bgfx.
-        bgfx::PlatformData pd{};
-        pd.nwh = wmi.info.win.window;
         bgfx::setPlatformData(pd);
-        bgfx::renderFrame();
 
         bgfx::Init bgfx_init;
-        bgfx_init.type = bgfx::RendererType::Vulkan;
+        bgfx_init.type = m_bHeadless ? bgfx::RendererType::Noop : bgfx::RendererType::Vulkan;
         bgfx_init.resolution.width = res.x;
         bgfx_init.resolution.height = res.y;
-        bgfx_init.resolution.reset = BGFX_RESET_VSYNC;
+        bgfx_init.resolution.reset = m_bHeadless ? BGFX_RESET_NONE : BGFX_RESET_VSYNC;
         bgfx_init.platformData = pd;
-        bgfx::init(bgfx_init);
+        bgfx_init.limits.maxEncoders = uint16_t(std::min<size_t>(GetWorkers().ThreadCount() + 1, UINT16_MAX));
+        const bool threaded = std::find(nstrArgs.begin(), nstrArgs.end(), "-singlethreaded") == nstrArgs.end();
+        if (!m_cRender.Init(bgfx_init, threaded))
+        {
+            GetPlatform().FatalError("Could not initialize bgfx.");
+            return;
+        }
 
         bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x007ffffff, 1.0f, 0);
         bgfx::setViewRect(0, 0, 0, uint16_t(res.x), uint16_t(res.y));
@@ -140,9 +201,12 @@ class Win32Platform final : public Platform
 
     auto Shutdown() -> void override
     {
-        if (!m_pWindow)
+        m_cRender.Shutdown();
+
+        if (m_pWindow)
         {
             SDL_DestroyWindow(m_pWindow);
+            m_pWindow = nullptr;
         }
 
         SDL_Quit();
@@ -157,6 +221,16 @@ class Win32Platform final : public Platform
 
     //**************************************************************************
 
+    auto TimeNS() -> uint64_t override
+    {
+        // Split up so the multiply can't overflow.
+        static const uint64_t freq = SDL_GetPerformanceFrequency();
+        const uint64_t counter = SDL_GetPerformanceCounter();
+        return ((counter / freq) * 1000000000) + ((counter % freq) * 1000000000 / freq);
+    }
+
+    //**************************************************************************
+
     auto SleepMS(const uint32_t dwMillis) -> void override
     {
         return SDL_Delay(dwMillis);
@@ -168,7 +242,7 @@ class Win32Platform final : public Platform
     {
         SDL_SysWMinfo info;
         SDL_VERSION(&info.version);
-        if (SDL_GetWindowWMInfo(m_pWindow, &info))
+        if (m_pWindow != nullptr && SDL_GetWindowWMInfo(m_pWindow, &info))
         {
             return (void *)info.info.win.window;
         }
@@ -182,6 +256,12 @@ class Win32Platform final : public Platform
 
     auto WindowResolution() -> glm::ivec2 override
     {
+        if (m_pWindow == nullptr)
+        {
+            // Headless, report the size we would have made the window.
+            return glm::ivec2{DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT};
+        }
+
         glm::ivec2 rvo;
         SDL_GetWindowSize(m_pWindow, &rvo.x, &rvo.y);
         return rvo;
@@ -201,8 +281,33 @@ class Win32Platform final : public Platform
 
     //**************************************************************************
 
+    auto GetPrefPath() -> std::string_view override
+    {
+        static std::string prefPath;
+        if (prefPath.empty())
+        {
+            char *path = SDL_GetPrefPath("rock3d", AppConfig().szName);
+            if (path == nullptr)
+            {
+                GetPlatform().FatalError(SDL_GetError());
+            }
+            prefPath = path;
+            SDL_free(path);
+        }
+        return prefPath;
+    }
+
+    //**************************************************************************
+
     [[noreturn]] auto FatalError(const std::string_view strError) -> void override
     {
+        if (m_bHeadless)
+        {
+            // Nobody is around to click a message box.
+            std::fprintf(stderr, "rock3d Error: %s\n", std::string(strError).c_str());
+            exit(EXIT_FAILURE);
+        }
+
         int result = 0;
         auto maybeError = UTF8ToWString(strError);
         if (!maybeError.has_value())
@@ -242,136 +347,224 @@ class Win32Platform final : public Platform
         {
             return nonstd::make_unexpected(readError_e::file_not_found);
         }
+        auto closeFile = nonstd::make_scope_exit([fh] { CloseHandle(fh); });
 
-        buffer_t rvo;
-        std::array<uint8_t, 8192> buffer;
-        for (;;)
+        // Size the buffer up front, so the whole file lands in one read.
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(fh, &size))
         {
+            return nonstd::make_unexpected(readError_e::file_read_error);
+        }
+
+        buffer_t rvo(size_t(size.QuadPart));
+        size_t offset = 0;
+        while (offset < rvo.size())
+        {
+            const DWORD toRead = DWORD(std::min<size_t>(rvo.size() - offset, 1 << 30));
             DWORD bytesRead = 0;
-            BOOL ok = ReadFile(fh, buffer.data(), DWORD(buffer.size()), &bytesRead, nullptr);
-            if (!ok)
+            if (!ReadFile(fh, rvo.data() + offset, toRead, &bytesRead, nullptr))
             {
                 return nonstd::make_unexpected(readError_e::file_read_error);
             }
             else if (bytesRead == 0)
             {
-                return rvo;
+                // File got shorter since we sized it.
+                rvo.resize(offset);
+                break;
             }
-            rvo.reserve(rvo.size() + bytesRead);
-            std::copy(buffer.begin(), buffer.begin() + bytesRead, std::back_inserter(rvo));
+            offset += bytesRead;
         }
-    };
+        return rvo;
+    }
+
+    //**************************************************************************
 
-    /**
-     * @brief Convert an SDL scancode to our keyboardScan_e enum.
-     */
-    static auto SDLScanToRock(const SDL_Scancode eScan) -> keyboardScan_e
+    auto ReadFilesToBuffers(const nonstd::span<const std::string_view> nstrFilePaths)
+        -> std::vector<readResult_t> override
     {
-        return keyboardScan_e(eScan);
-    }
+        std::vector<readResult_t> rvo;
+        rvo.reserve(nstrFilePaths.size());
+        for (auto &path : nstrFilePaths)
+        {
+            rvo.push_back(ReadFileToBuffer(path));
+        }
+        return rvo;
+    };
 
-    /**
-     * @brief Convert an SDL scancode to our keyboardScan_e enum.
-     */
-    static auto SDLKeyToRock(const SDL_Keycode eKey) -> keyboardKey_e
+    //**************************************************************************
+
+    auto MapFile(const std::string_view strFilePath) -> mapResult_t override
     {
-        return keyboardKey_e(eKey);
+        auto maybeFilePath = UTF8ToWString(strFilePath);
+        if (!maybeFilePath.has_value())
+        {
+            return nonstd::make_unexpected(readError_e::invalid_path);
+        }
+
+        const std::wstring filePath = maybeFilePath.value();
+        const HANDLE fh = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fh == INVALID_HANDLE_VALUE)
+        {
+            return nonstd::make_unexpected(readError_e::file_not_found);
+        }
+        auto closeFile = nonstd::make_scope_exit([fh] { CloseHandle(fh); });
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(fh, &size))
+        {
+            return nonstd::make_unexpected(readError_e::file_read_error);
+        }
+        if (size.QuadPart == 0)
+        {
+            // Empty files can't be mapped.
+            return bufferView_s{};
+        }
+
+        const HANDLE mh = CreateFileMappingW(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mh == nullptr)
+        {
+            return nonstd::make_unexpected(readError_e::file_read_error);
+        }
+        auto closeMapping = nonstd::make_scope_exit([mh] { CloseHandle(mh); });
+
+        // The view keeps the mapping alive on its own.
+        const void *view = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr)
+        {
+            return nonstd::make_unexpected(readError_e::file_read_error);
+        }
+
+        bufferView_s rvo;
+        rvo.cSpan = nonstd::span<const uint8_t>(static_cast<const uint8_t *>(view), size_t(size.QuadPart));
+        rvo.pOwner = std::shared_ptr<const void>(view, [](const void *pView) { UnmapViewOfFile(pView); });
+        return rvo;
     }
 
-    /**
-     * @brief Convert a SDL mouse button to our mouseButton_e enum.
-     */
-    static auto SDLMBtnToRock(const Uint8 button) -> mouseButton_e
+    //**************************************************************************
+
+    auto ListFiles(const std::string_view strDirPath) -> listResult_t override
     {
-        switch (button)
-        {
-        case SDL_BUTTON_LEFT:
-            return MBTN_LEFT;
-        case SDL_BUTTON_MIDDLE:
-            return MBTN_MIDDLE; // Unlike SDL, we use 3 for middle.
-        case SDL_BUTTON_RIGHT:
-            return MBTN_RIGHT; // Unlike SDL, we use 2 for right.
-        case SDL_BUTTON_X1:
-            return MBTN_X1;
-        case SDL_BUTTON_X2:
-            return MBTN_X2;
-        }
-        return MBTN_NONE;
+        auto maybeDirPath = UTF8ToWString(strDirPath);
+        if (!maybeDirPath.has_value())
+        {
+            return nonstd::make_unexpected(readError_e::invalid_path);
+        }
+
+        // Directories left to visit, relative to the root.
+        std::vector<std::string> rvo;
+        std::vector<std::wstring> dirs{L""};
+        while (!dirs.empty())
+        {
+            const std::wstring dir = std::move(dirs.back());
+            dirs.pop_back();
+
+            const std::wstring pattern = maybeDirPath.value() + L"/" + dir + L"*";
+            WIN32_FIND_DATAW data;
+            const HANDLE fh = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+                                               nullptr, FIND_FIRST_EX_LARGE_FETCH);
+            if (fh == INVALID_HANDLE_VALUE)
+            {
+                if (dir.empty())
+                {
+                    return nonstd::make_unexpected(readError_e::file_not_found);
+                }
+                continue;
+            }
+            auto closeFind = nonstd::make_scope_exit([fh] { FindClose(fh); });
+
+            do
+            {
+                const std::wstring_view name = data.cFileName;
+                if (name == L"." || name == L"..")
+                {
+                    continue;
+                }
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                {
+                    dirs.push_back(dir + std::wstring(name) + L"/");
+                    continue;
+                }
+                auto maybePath = WStringToUTF8(dir + std::wstring(name));
+                if (maybePath.has_value())
+                {
+                    rvo.push_back(std::move(maybePath.value()));
+                }
+            } while (FindNextFileW(fh, &data));
+        }
+        return rvo;
     }
 
-    /**
-     * @brief Convert an SDL gamepad axis to our padAxis_e enum.
-     */
-    static auto SDLPadAxisToRock(const SDL_GameControllerAxis eAxis) -> padAxis_e
+    //**************************************************************************
+
+    auto WatchPath(const std::string_view) -> bool override
     {
-        return padAxis_e(eAxis);
+        // Not yet; would need ReadDirectoryChangesW.
+        return false;
     }
 
-    /**
-     * @brief Convert an SDL gamepad button to our padButton_e enum.
-     */
-    static auto SDLPadButtonToRock(const SDL_GameControllerButton eButton) -> padButton_e
+    //**************************************************************************
+
+    auto PollChangedFiles() -> std::vector<std::string> override
     {
-        return padButton_e(eButton);
+        return {};
     }
 
     //**************************************************************************
 
-    virtual auto PumpEvents() -> void
+    auto WriteFileFromBuffer(const std::string_view strFilePath, const nonstd::span<const uint8_t> cData)
+        -> bool override
     {
-        SDL_Event ev;
-        while (SDL_PollEvent(&ev))
+        auto maybeFilePath = UTF8ToWString(strFilePath);
+        if (!maybeFilePath.has_value())
         {
-            switch (ev.type)
+            return false;
+        }
+
+        const std::wstring filePath = maybeFilePath.value();
+        const std::wstring tempPath = filePath + L".tmp";
+        const HANDLE fh =
+            CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fh == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        size_t written = 0;
+        while (written < cData.size())
+        {
+            const DWORD chunk = DWORD(std::min<size_t>(cData.size() - written, MAXDWORD));
+            DWORD bytesWritten = 0;
+            if (!WriteFile(fh, cData.data() + written, chunk, &bytesWritten, nullptr))
             {
-            case SDL_KEYDOWN:
-                [[fallthrough]];
-            case SDL_KEYUP: {
-                event_t rockEv = eventKey_s{
-                    SDLScanToRock(ev.key.keysym.scancode),
-                    SDLKeyToRock(ev.key.keysym.sym),
-                    ev.type == SDL_KEYDOWN,
-                };
-                GetEventQueue().Queue(std::move(rockEv));
-                break;
-            }
-            case SDL_MOUSEMOTION: {
-                event_t rockEv = eventMouseMotion_s{
-                    glm::ivec2{ev.motion.x, ev.motion.y},
-                    glm::ivec2{ev.motion.xrel, ev.motion.yrel},
-                };
-                GetEventQueue().Queue(std::move(rockEv));
-                break;
-            }
-            case SDL_MOUSEBUTTONDOWN:
-                [[fallthrough]];
-            case SDL_MOUSEBUTTONUP: {
-                event_t rockEv = eventMouseButton_s{
-                    glm::ivec2{ev.button.x, ev.button.y},
-                    SDLMBtnToRock(ev.button.button),
-                    ev.button.state == SDL_PRESSED,
-                };
-                GetEventQueue().Queue(std::move(rockEv));
-                break;
-            }
-            case SDL_MOUSEWHEEL:
-                break;
-            case SDL_CONTROLLERAXISMOTION: {
-                event_t rockEv = eventPadAxis_s{ev.caxis.axis, ev.caxis.value};
-                GetEventQueue().Queue(std::move(rockEv));
-                break;
-            }
-            case SDL_CONTROLLERBUTTONDOWN:
-                [[fallthrough]];
-            case SDL_CONTROLLERBUTTONUP: {
-                event_t rockEv = eventPadButton_s{ev.cbutton.button, ev.type == SDL_CONTROLLERBUTTONDOWN};
-                GetEventQueue().Queue(std::move(rockEv));
-                break;
-            }
-            default:
-                break;
+                CloseHandle(fh);
+                DeleteFileW(tempPath.c_str());
+                return false;
             }
+            written += bytesWritten;
+        }
+        CloseHandle(fh);
+
+        if (!MoveFileExW(tempPath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            DeleteFileW(tempPath.c_str());
+            return false;
         }
+        return true;
+    }
+
+    //**************************************************************************
+
+    auto PumpEvents() -> void override
+    {
+        SDLPumpEvents();
+    }
+
+    //**************************************************************************
+
+    auto WaitEvents(const uint32_t dwTimeoutMS) -> bool override
+    {
+        return SDLWaitEvents(dwTimeoutMS);
     }
 };
 
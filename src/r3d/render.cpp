@@ -20,8 +20,19 @@ const DEBUG: boolean = false;
 namespace rock3d::r3D
 {
 
-class RenderContext
+class RenderContextImpl final : public RenderContext
 {
+    /**
+     * Fewest walls worth handing to a worker of their own.
+     */
+    static constexpr size_t SLICE_MIN_WALLS = 1024;
+
+    /**
+     * Most walls drawn out of one transient buffer, so every index fits
+     * in 16 bits.
+     */
+    static constexpr size_t BATCH_MAX_WALLS = 65536 / 4;
+
     struct wallVert_s
     {
         glm::vec3 cPosition;
@@ -30,18 +41,111 @@ class RenderContext
         glm::vec3 cBright;
     };
     std::vector<wallVert_s> m_ncWallVerts;
+    std::vector<size_t> m_nqwWallPages; // Atlas page of every wall, one per four verts.
+
+    /**
+     * A wall as it was added, so its verts can be rebuilt when the atlas
+     * moves its texture.
+     */
+    struct wallDef_s
+    {
+        glm::vec2 cOne;
+        glm::vec2 cTwo;
+        float fZ1 = 0.0f;
+        float fZ2 = 0.0f;
+        std::string strTexture;
+        glm::vec3 cBright;
+    };
+    std::vector<wallDef_s> m_ncWalls;
+    uint64_t m_qwAtlasGeneration = 0; // Atlas generation the wall verts were built with.
+    size_t m_qwDroppedWalls = 0;      // Walls not drawn because bgfx ran out of transient buffers.
+
+    /**
+     * A run of walls drawn out of one transient buffer.
+     */
+    struct wallBatch_s
+    {
+        size_t qwFirst = 0;
+        size_t qwLast = 0;
+        bgfx::TransientVertexBuffer cVerts;
+        bgfx::TransientIndexBuffer cIndexes;
+    };
+
+    /**
+     * Everything a worker needs to bind world textures, looked up on the
+     * main thread so workers never touch the atlas.
+     */
+    struct worldBinding_s
+    {
+        bgfx::ProgramHandle cProgram = BGFX_INVALID_HANDLE;
+        std::vector<bgfx::TextureHandle> ncPages;
+        float nfAtlasParams[4] = {};
+        bool bPaletted = false;
+        bgfx::TextureHandle cPalette = BGFX_INVALID_HANDLE;
+        bgfx::TextureHandle cColormap = BGFX_INVALID_HANDLE;
+        float nfPaletteInfo[4] = {};
+    };
 
     std::unique_ptr<Textures> m_pTextures;
 
     bgfx::ProgramHandle m_cWorldShader = BGFX_INVALID_HANDLE;
+    bgfx::ProgramHandle m_cWorldPalettedShader = BGFX_INVALID_HANDLE;
     bgfx::VertexLayout m_cVertexLayout;
     bgfx::UniformHandle m_cUViewProj = BGFX_INVALID_HANDLE;
     bgfx::UniformHandle m_cUTexure = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle m_cUAtlasParams = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle m_cUPalette = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle m_cUColormap = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle m_cUPaletteInfo = BGFX_INVALID_HANDLE;
+
+    Assets::handle_t m_qwChangedHandle = 0;
+
+    /**
+     * Recompile a shader program if either of its files changed.  A shader
+     * that no longer compiles keeps the old program, so a typo doesn't
+     * take the game down.
+     *
+     * @param nstrPaths Asset paths that changed.
+     * @param strShaderDir Path to the directory containing the shader.
+     * @param cProgram Program to replace.
+     */
+    static auto ReloadShader(const nonstd::span<const std::string> nstrPaths, const std::string_view strShaderDir,
+                             bgfx::ProgramHandle &cProgram) -> void
+    {
+        const auto files = ShaderProgramFiles(strShaderDir);
+        if (std::none_of(nstrPaths.begin(), nstrPaths.end(),
+                         [&files](const std::string &path) { return path == files[0] || path == files[1]; }))
+        {
+            return;
+        }
+
+        auto maybeProgram = ShaderTryCompileProgram(strShaderDir);
+        if (!maybeProgram.has_value())
+        {
+            return;
+        }
+
+        // bgfx holds off on destroying it until the frame is done with it.
+        bgfx::destroy(cProgram);
+        cProgram = maybeProgram.value();
+    }
 
   public:
-    auto Init() -> bool
+    RenderContextImpl() : m_pTextures(Textures::Alloc())
+    {
+    }
+
+    ~RenderContextImpl()
+    {
+        GetAssets().Unsubscribe(m_qwChangedHandle);
+    }
+
+    auto Init() -> bool override
     {
         m_cWorldShader = ShaderCompileProgram("rock3d/r3d/shaders/world");
+        m_cWorldPalettedShader = ShaderCompileProgram("rock3d/r3d/shaders/worldPaletted");
+        m_qwChangedHandle = GetAssets().Subscribe(
+            [this](const nonstd::span<const std::string> nstrPaths) { ReloadAssets(nstrPaths); });
 
         m_cVertexLayout.begin()
             .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)  // Pos
@@ -52,10 +156,305 @@ class RenderContext
 
         m_cUViewProj = bgfx::createUniform("u_viewProj", bgfx::UniformType::Mat4);
         m_cUTexure = bgfx::createUniform("u_texture", bgfx::UniformType::Sampler);
+        m_cUAtlasParams = bgfx::createUniform("u_atlasParams", bgfx::UniformType::Vec4);
+        m_cUPalette = bgfx::createUniform("u_palette", bgfx::UniformType::Sampler);
+        m_cUColormap = bgfx::createUniform("u_colormap", bgfx::UniformType::Sampler);
+        m_cUPaletteInfo = bgfx::createUniform("u_paletteInfo", bgfx::UniformType::Vec4);
 
         return true;
     }
 
+    /**
+     * Rebuild whatever was made out of assets that changed on disk.
+     *
+     * Textures are decoded in the background and redrawn in the atlas by
+     * a later ToGPU.  Shaders are small, so they are recompiled right away.
+     *
+     * @param nstrPaths Asset paths that changed.
+     */
+    auto ReloadAssets(const nonstd::span<const std::string> nstrPaths) -> void
+    {
+        const std::vector<std::string_view> paths(nstrPaths.begin(), nstrPaths.end());
+        m_pTextures->Reload(paths);
+        ReloadShader(nstrPaths, "rock3d/r3d/shaders/world", m_cWorldShader);
+        ReloadShader(nstrPaths, "rock3d/r3d/shaders/worldPaletted", m_cWorldPalettedShader);
+    }
+
+    /**
+     * Look up what drawing world geometry needs from the atlas.
+     *
+     * Paletted atlases also need the palette and colormap, and are drawn
+     * with a shader that does the lookups itself.
+     */
+    auto WorldBinding() -> worldBinding_s
+    {
+        worldBinding_s rvo;
+        for (size_t i = 0; i < m_pTextures->PageCount(); i++)
+        {
+            rvo.ncPages.push_back(m_pTextures->PageHandle(i));
+        }
+        rvo.nfAtlasParams[0] = float(m_pTextures->PageSize());
+        rvo.nfAtlasParams[1] = float(m_pTextures->MipLevels() - 1);
+        rvo.bPaletted = m_pTextures->IsPaletted();
+        if (!rvo.bPaletted)
+        {
+            rvo.cProgram = m_cWorldShader;
+            return rvo;
+        }
+
+        rvo.cProgram = m_cWorldPalettedShader;
+        rvo.cPalette = m_pTextures->PaletteHandle();
+        rvo.cColormap = m_pTextures->ColormapHandle();
+        rvo.nfPaletteInfo[0] = float(m_pTextures->ColormapLevels());
+        rvo.nfPaletteInfo[1] = float(m_pTextures->TransparentIndex());
+        return rvo;
+    }
+
+    /**
+     * Bind the textures needed to draw world geometry on an atlas page.
+     *
+     * @param cEncoder Encoder to bind with.
+     * @param cBinding Textures and uniforms from WorldBinding.
+     * @param qwPage Atlas page to draw with.
+     */
+    auto BindWorldTextures(bgfx::Encoder &cEncoder, const worldBinding_s &cBinding, const size_t qwPage) -> void
+    {
+        cEncoder.setTexture(0, m_cUTexure, cBinding.ncPages[qwPage]);
+        cEncoder.setUniform(m_cUAtlasParams, cBinding.nfAtlasParams);
+        if (cBinding.bPaletted)
+        {
+            cEncoder.setTexture(1, m_cUPalette, cBinding.cPalette);
+            cEncoder.setTexture(2, m_cUColormap, cBinding.cColormap);
+            cEncoder.setUniform(m_cUPaletteInfo, cBinding.nfPaletteInfo);
+        }
+    }
+
+    /**
+     * Reserve transient buffers for a range of walls, one batch at a time.
+     * Must be called from the main thread, since bgfx only checks for room
+     * and allocates in one step if nobody else is allocating.
+     *
+     * @param qwStart First wall.
+     * @param qwEnd One past the last wall.
+     * @param ncOutBatches Batches that got buffers are added to the end.
+     */
+    auto ReserveWalls(const size_t qwStart, const size_t qwEnd, std::vector<wallBatch_s> &ncOutBatches) -> void
+    {
+        for (size_t first = qwStart; first < qwEnd; first += BATCH_MAX_WALLS)
+        {
+            wallBatch_s batch;
+            batch.qwFirst = first;
+            batch.qwLast = std::min(qwEnd, first + BATCH_MAX_WALLS);
+            const uint32_t verts = uint32_t((batch.qwLast - first) * 4);
+            const uint32_t indexes = uint32_t((batch.qwLast - first) * 6);
+            if (!bgfx::allocTransientBuffers(&batch.cVerts, m_cVertexLayout, verts, &batch.cIndexes, indexes))
+            {
+                // Out of transient memory for this frame.  Dropping walls
+                // beats crashing.
+                m_qwDroppedWalls += batch.qwLast - first;
+                continue;
+            }
+            ncOutBatches.push_back(batch);
+        }
+    }
+
+    /**
+     * Fill reserved batches of walls and record their draws.  Safe to call
+     * from any thread, as long as every thread has its own encoder.
+     *
+     * Walls next to each other on the same atlas page are drawn together.
+     * Every draw is submitted with the index of its first wall as its
+     * depth, which is what puts them back in order later.
+     *
+     * @param cEncoder Encoder to record with.
+     * @param cBinding Textures and uniforms from WorldBinding.
+     * @param cViewProj View and projection matrix.
+     * @param wView View to submit to.
+     * @param ncBatches Batches from ReserveWalls.
+     */
+    auto RecordWalls(bgfx::Encoder &cEncoder, const worldBinding_s &cBinding, const glm::mat4 &cViewProj,
+                     const uint16_t wView, const nonstd::span<wallBatch_s> ncBatches) -> void
+    {
+        for (wallBatch_s &batch : ncBatches)
+        {
+            const size_t first = batch.qwFirst;
+            const size_t last = batch.qwLast;
+            const uint32_t verts = uint32_t((last - first) * 4);
+            std::memcpy(batch.cVerts.data, &m_ncWallVerts[first * 4], verts * sizeof(wallVert_s));
+            uint16_t *index = reinterpret_cast<uint16_t *>(batch.cIndexes.data);
+            for (size_t i = 0; i < last - first; i++)
+            {
+                const uint16_t vert = uint16_t(i * 4);
+                *index++ = vert;
+                *index++ = vert + 1;
+                *index++ = vert + 2;
+                *index++ = vert + 2;
+                *index++ = vert + 3;
+                *index++ = vert;
+            }
+
+            for (size_t run = first; run < last;)
+            {
+                const size_t page = m_nqwWallPages[run];
+                size_t runEnd = run + 1;
+                while (runEnd < last && m_nqwWallPages[runEnd] == page)
+                {
+                    runEnd += 1;
+                }
+
+                // Pages that have nothing on the GPU yet are skipped.
+                if (bgfx::isValid(cBinding.ncPages[page]))
+                {
+                    BindWorldTextures(cEncoder, cBinding, page);
+                    cEncoder.setUniform(m_cUViewProj, &cViewProj[0][0]);
+                    cEncoder.setVertexBuffer(0, &batch.cVerts, 0, verts);
+                    cEncoder.setIndexBuffer(&batch.cIndexes, uint32_t((run - first) * 6), uint32_t((runEnd - run) * 6));
+                    cEncoder.setState(BGFX_STATE_DEFAULT);
+                    cEncoder.submit(wView, cBinding.cProgram, uint32_t(run));
+                }
+                run = runEnd;
+            }
+        }
+    }
+
+    /**
+     * Rebuild the verts of every wall from the atlas as it is now.
+     */
+    auto RebuildWalls() -> void
+    {
+        m_ncWallVerts.clear();
+        m_nqwWallPages.clear();
+        for (const wallDef_s &wall : m_ncWalls)
+        {
+            BuildWall(wall);
+        }
+        m_qwAtlasGeneration = m_pTextures->AtlasGeneration();
+    }
+
+    /**
+     * Submit every wall to a view.
+     *
+     * Every page a wall is on is marked as used before the atlas is sent
+     * to the GPU, so pages we draw from are never evicted, and pages that
+     * were evicted come back before we draw from them.
+     *
+     * Walls are split into slices that are recorded on worker threads, each
+     * with its own bgfx encoder.  The view is sorted by depth, and depth
+     * is the position of a draw in the wall list, so the GPU sees the same
+     * order no matter which worker finished first.
+     *
+     * @param wView View to submit to.
+     * @param cViewProj View and projection matrix.
+     */
+    auto SubmitWorld(const uint16_t wView, const glm::mat4 &cViewProj) -> void override
+    {
+        if (m_nqwWallPages.empty())
+        {
+            return;
+        }
+
+        size_t lastPage = SIZE_MAX;
+        for (const size_t page : m_nqwWallPages)
+        {
+            if (page != lastPage)
+            {
+                m_pTextures->MarkPageUsed(page);
+                lastPage = page;
+            }
+        }
+        m_pTextures->ToGPU();
+
+        // A compaction or reload that finished in ToGPU can move textures
+        // the walls were built with.  Pages that walls moved to are marked
+        // next frame, and skipped until they are on the GPU.
+        if (m_pTextures->AtlasGeneration() != m_qwAtlasGeneration)
+        {
+            RebuildWalls();
+        }
+
+        const worldBinding_s binding = WorldBinding();
+        const size_t walls = m_nqwWallPages.size();
+
+        // bgfx keeps one encoder for the main thread, every other one can
+        // go to a slice.
+        const size_t maxEncoders = bgfx::getCaps()->limits.maxEncoders;
+        const size_t maxSlices = std::min(maxEncoders > 1 ? maxEncoders - 1 : 1, GetWorkers().ThreadCount() + 1);
+        const size_t slices = std::clamp((walls + SLICE_MIN_WALLS - 1) / SLICE_MIN_WALLS, size_t(1), maxSlices);
+        const size_t perSlice = (walls + slices - 1) / slices;
+
+        // Buffers are reserved up front, since workers allocating at the
+        // same time could all see room that only one of them gets.
+        std::vector<wallBatch_s> batches;
+        std::vector<size_t> sliceBatches(slices + 1, 0);
+        for (size_t i = 0; i < slices; i++)
+        {
+            const size_t start = std::min(walls, i * perSlice);
+            ReserveWalls(start, std::min(walls, start + perSlice), batches);
+            sliceBatches[i + 1] = batches.size();
+        }
+
+        bgfx::setViewMode(wView, bgfx::ViewMode::DepthAscending);
+        const nonstd::span<wallBatch_s> allBatches(batches);
+        if (slices == 1)
+        {
+            bgfx::Encoder *encoder = bgfx::begin();
+            RecordWalls(*encoder, binding, cViewProj, wView, allBatches);
+            bgfx::end(encoder);
+            return;
+        }
+
+        std::vector<uint8_t> missed(slices, 0);
+        GetWorkers().ParallelFor(slices, [&](const size_t i) {
+            const size_t count = sliceBatches[i + 1] - sliceBatches[i];
+            if (count == 0)
+            {
+                return;
+            }
+            bgfx::Encoder *encoder = bgfx::begin(true);
+            if (encoder == nullptr)
+            {
+                // Only if the app is holding on to encoders of its own.
+                missed[i] = 1;
+                return;
+            }
+            RecordWalls(*encoder, binding, cViewProj, wView, allBatches.subspan(sliceBatches[i], count));
+            bgfx::end(encoder);
+        });
+
+        // Slices that didn't get an encoder are recorded here instead.
+        // Depth keeps them in order, so it doesn't matter that they come
+        // last.
+        if (std::find(missed.begin(), missed.end(), 1) == missed.end())
+        {
+            return;
+        }
+        bgfx::Encoder *encoder = bgfx::begin();
+        for (size_t i = 0; i < slices; i++)
+        {
+            if (missed[i])
+            {
+                const size_t count = sliceBatches[i + 1] - sliceBatches[i];
+                RecordWalls(*encoder, binding, cViewProj, wView, allBatches.subspan(sliceBatches[i], count));
+            }
+        }
+        bgfx::end(encoder);
+    }
+
+    /**
+     * Walls that weren't drawn because bgfx ran out of transient buffers,
+     * since the context was created.  If this goes up, raise
+     * bgfx::Init::limits.transientVbSize and transientIbSize.
+     */
+    auto DroppedWalls() const -> size_t override
+    {
+        return m_qwDroppedWalls;
+    }
+
+    auto TextureStats() -> const Textures::loadStats_s & override
+    {
+        return m_pTextures->LoadStats();
+    }
+
     /**
      * Persist the texture atlas onto the GPU.
      *
@@ -63,6 +462,73 @@ class RenderContext
      */
     auto BakeTextureAtlas() -> void {}
 
+    /**
+     * Load a level, and every texture and sprite it needs.
+     *
+     * The textures are decoded on worker threads while the level is
+     * parsed, so they are in the atlas by the time any of its geometry is
+     * added.
+     *
+     * @param strPath Asset path of the level.
+     */
+    auto LoadLevel(const std::string_view strPath) -> loadLevelResult_t override
+    {
+        std::vector<std::string> assets;
+        auto rvo = LoadLevelAsset(strPath, [this, &assets](const LevelManifest &cManifest) {
+            assets = cManifest.nstrTextures;
+            assets.insert(assets.end(), cManifest.nstrSprites.begin(), cManifest.nstrSprites.end());
+            const std::vector<std::string_view> paths(assets.begin(), assets.end());
+            m_pTextures->Prefetch(paths);
+        });
+        if (rvo.has_value())
+        {
+            const std::vector<std::string_view> paths(assets.begin(), assets.end());
+            m_pTextures->AddAssets(paths);
+            m_pTextures->BakeAtlas();
+        }
+        return rvo;
+    }
+
+    /**
+     * Add every wall of a level.
+     *
+     * Edges without a back polygon get a middle wall.  Edges with one get
+     * a lower wall up to the floor behind them and an upper wall down to
+     * the ceiling behind them, where those exist.
+     *
+     * @param cLevel Level to add.
+     */
+    auto AddLevel(const Level &cLevel) -> size_t override
+    {
+        size_t rvo = 0;
+        auto addWall = [this, &rvo](const Edge &cEdge, const float fZ1, const float fZ2, const std::string &strTexture,
+                                    const glm::vec3 &cBright) {
+            if (fZ2 > fZ1 && !strTexture.empty() &&
+                AddWall(cEdge.cVertex, cEdge.cNextVertex, fZ1, fZ2, LevelTexturePath(strTexture), cBright))
+            {
+                rvo += 1;
+            }
+        };
+
+        for (const Polygon &poly : cLevel.ncPolygons)
+        {
+            for (const size_t edgeID : poly.nqwEdgeIDs)
+            {
+                const Edge &edge = cLevel.ncEdges[edgeID];
+                if (edge.qwBackPoly == UINT64_MAX)
+                {
+                    addWall(edge, poly.fFloorHeight, poly.fCeilHeight, edge.strMiddleTex, poly.cBrightness);
+                    continue;
+                }
+
+                const Polygon &back = cLevel.ncPolygons[edge.qwBackPoly];
+                addWall(edge, poly.fFloorHeight, back.fFloorHeight, edge.strLowerTex, poly.cBrightness);
+                addWall(edge, back.fCeilHeight, poly.fCeilHeight, edge.strUpperTex, poly.cBrightness);
+            }
+        }
+        return rvo;
+    }
+
     /**
      * Add a wall to the set of things to render.
      *
@@ -73,23 +539,47 @@ class RenderContext
      * @param cTwo Second vertex.
      * @param fZ1 Floor height.
      * @param fZ2 Ceiling height.
-     * @param strTexture Texture name.
+     * @param strTexture Asset path of the texture.
      * @param cBright Wall brightness.
      */
     auto AddWall(const glm::vec2 &cOne, const glm::vec2 &cTwo, const float fZ1, const float fZ2,
-                 const std::string_view strTexture, const glm::vec3 &cBright) -> bool
+                 const std::string_view strTexture, const glm::vec3 &cBright) -> bool override
     {
-        if (!m_pTextures)
+        if (m_ncWalls.empty())
+        {
+            m_qwAtlasGeneration = m_pTextures->AtlasGeneration();
+        }
+
+        wallDef_s wall{cOne, cTwo, fZ1, fZ2, std::string(strTexture), cBright};
+        if (!BuildWall(wall))
         {
             return false;
         }
+        m_ncWalls.push_back(std::move(wall));
+        return true;
+    }
+
+    /**
+     * Build the verts of a wall out of where its texture is in the atlas.
+     *
+     * @param cWall Wall to build.
+     * @return False if the texture is not in the atlas.
+     */
+    auto BuildWall(const wallDef_s &cWall) -> bool
+    {
+        const glm::vec2 &cOne = cWall.cOne;
+        const glm::vec2 &cTwo = cWall.cTwo;
+        const float fZ1 = cWall.fZ1;
+        const float fZ2 = cWall.fZ2;
+        const glm::vec3 &cBright = cWall.cBright;
 
         // Find the texture of the wall in the atlas
-        auto texEntry = m_pTextures->FindByName(strTexture);
+        auto texEntry = m_pTextures->FindByName(cWall.strTexture);
         if (!texEntry)
         {
             return false;
         }
+        m_nqwWallPages.push_back(texEntry->qwPage);
 
         const float ua1 = texEntry->cAtlasMin.x;
         const float va1 = texEntry->cAtlasMin.y;
@@ -155,7 +645,15 @@ class RenderContext
         this.worldInds[iCount + 4] = vCount + 3;
         this.worldInds[iCount + 5] = vCount + 0;
         */
+        return true;
     };
 };
 
+//******************************************************************************
+
+auto RenderContext::Alloc() -> std::unique_ptr<RenderContext>
+{
+    return std::unique_ptr<RenderContext>(new RenderContextImpl());
+}
+
 } // namespace rock3d::r3D
@@ -4,6 +4,9 @@ $input v_atlasinfo, v_texcoord, v_bright
 
 uniform sampler2D u_texture;
 
+// x = atlas page size in pixels, y = smallest mip level with data.
+uniform vec4 u_atlasParams;
+
 float Z_NEAR = 1.0;
 float Z_FAR = 10000.0;
 
@@ -16,6 +19,17 @@ float wrap(float coord, float origin, float len) {
     return mod(coord - origin, len) + origin;
 }
 
+// Pick the mip level from the unwrapped coordinates, since the wrapped
+// ones jump at the edge of every repeat.  Only the first few levels of
+// the atlas hold data.
+float atlasLod(vec2 coord) {
+    vec2 texel = coord * u_atlasParams.x;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+    return clamp(lod, 0.0, u_atlasParams.y);
+}
+
 void main() {
     float uAtOrigin = v_atlasinfo.x;
     float vAtOrigin = v_atlasinfo.y;
@@ -26,7 +40,7 @@ void main() {
     texCord.x = wrap(v_texcoord.x, uAtOrigin, uAtLen);
     texCord.y = wrap(v_texcoord.y, vAtOrigin, vAtLen);
 
-    vec4 color = texture2D(u_texture, texCord);
+    vec4 color = texture2DLod(u_texture, texCord, atlasLod(v_texcoord));
     color.x *= v_bright.x;
     color.y *= v_bright.y;
     color.z *= v_bright.z;
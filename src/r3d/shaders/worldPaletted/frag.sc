@@ -0,0 +1,54 @@
+$input v_atlasinfo, v_texcoord, v_bright
+
+#include <bgfx_shader.sh>
+
+uniform sampler2D u_texture;
+uniform sampler2D u_palette;
+uniform sampler2D u_colormap;
+
+// x = number of colormap rows, y = transparent index or -1.
+uniform vec4 u_paletteInfo;
+
+// x = atlas page size in pixels, y = smallest mip level with data.
+uniform vec4 u_atlasParams;
+
+float wrap(float coord, float origin, float len) {
+    return mod(coord - origin, len) + origin;
+}
+
+// Pick the mip level from the unwrapped coordinates, since the wrapped
+// ones jump at the edge of every repeat.  Only the first few levels of
+// the atlas hold data.
+float atlasLod(vec2 coord) {
+    vec2 texel = coord * u_atlasParams.x;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+    return clamp(lod, 0.0, u_atlasParams.y);
+}
+
+void main() {
+    float uAtOrigin = v_atlasinfo.x;
+    float vAtOrigin = v_atlasinfo.y;
+    float uAtLen = v_atlasinfo.z;
+    float vAtLen = v_atlasinfo.w;
+
+    vec2 texCord;
+    texCord.x = wrap(v_texcoord.x, uAtOrigin, uAtLen);
+    texCord.y = wrap(v_texcoord.y, vAtOrigin, vAtLen);
+
+    float index = floor(texture2DLod(u_texture, texCord, atlasLod(v_texcoord)).x * 255.0 + 0.5);
+    if (index == u_paletteInfo.y) {
+        discard;
+    }
+
+    // Light level picks a row of the colormap, brightest first.
+    float levels = u_paletteInfo.x;
+    float bright = (v_bright.x + v_bright.y + v_bright.z) / 3.0;
+    float row = clamp(floor((1.0 - bright) * levels), 0.0, levels - 1.0);
+
+    vec2 mapCoord = vec2((index + 0.5) / 256.0, (row + 0.5) / levels);
+    float lit = floor(texture2D(u_colormap, mapCoord).x * 255.0 + 0.5);
+
+    gl_FragColor = texture2D(u_palette, vec2((lit + 0.5) / 256.0, 0.5));
+}
@@ -0,0 +1,8 @@
+vec3 a_position     : POSITION;
+vec4 a_texcoord0    : TEXCOORD0;
+vec2 a_texcoord1    : TEXCOORD1;
+vec3 a_color0       : COLOR0;
+
+vec4 v_atlasinfo    : TEXCOORD0;
+vec2 v_texcoord     : TEXCOORD1;
+vec3 v_bright       : COLOR0;
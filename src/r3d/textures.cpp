@@ -21,111 +21,2789 @@
 
 #include "rock3d/rock3d.h"
 
-#include "bimg/bimg.h"
+#include "bimg/decode.h"
+#include "bimg/encode.h"
+#include "bx/allocator.h"
 #include "../vendor/stb_rect_pack.h"
 
 namespace rock3d::r3D
 {
 
+//******************************************************************************
+
+/**
+ * @brief Width and height of a compressed block, in pixels.
+ */
+static constexpr int BLOCK_SIZE = 4;
+
+/**
+ * @brief Check if we know how to bake atlas pages in the passed format.
+ */
+static auto IsAtlasFormat(const bgfx::TextureFormat::Enum eFormat) -> bool
+{
+    switch (eFormat)
+    {
+    case bgfx::TextureFormat::RGBA8:
+    case bgfx::TextureFormat::R8:
+    case bgfx::TextureFormat::BC1:
+    case bgfx::TextureFormat::BC3:
+    case bgfx::TextureFormat::BC7:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Check if the passed format is made up of compressed blocks.
+ */
+static auto IsBlockFormat(const bgfx::TextureFormat::Enum eFormat) -> bool
+{
+    switch (eFormat)
+    {
+    case bgfx::TextureFormat::BC1:
+    case bgfx::TextureFormat::BC3:
+    case bgfx::TextureFormat::BC7:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Bytes per pixel of the CPU copy of a page in the passed format.
+ *
+ * @details Pages in block formats are built up in RGBA8 and compressed.
+ */
+static auto PixelBytes(const bgfx::TextureFormat::Enum eFormat) -> int
+{
+    return eFormat == bgfx::TextureFormat::R8 ? 1 : 4;
+}
+
+/**
+ * @brief Size of an image in the passed atlas format.
+ *
+ * @param iW Width, must be a multiple of BLOCK_SIZE for compressed formats.
+ * @param iH Height, must be a multiple of BLOCK_SIZE for compressed formats.
+ */
+static auto ImageBytes(const bgfx::TextureFormat::Enum eFormat, const int iW, const int iH) -> size_t
+{
+    const size_t blocks = size_t(iW / BLOCK_SIZE) * size_t(iH / BLOCK_SIZE);
+    switch (eFormat)
+    {
+    case bgfx::TextureFormat::BC1:
+        return blocks * 8;
+    case bgfx::TextureFormat::BC3:
+    case bgfx::TextureFormat::BC7:
+        return blocks * 16;
+    default:
+        return size_t(iW) * size_t(iH) * size_t(PixelBytes(eFormat));
+    }
+}
+
+/**
+ * @brief Block-compress a rectangle of an RGBA8 image.
+ *
+ * @param pDest Destination of the first compressed block.
+ * @param qwDestPitch Bytes between rows of blocks in the destination.
+ * @param pSrc RGBA8 source image.
+ * @param iSrcPitch Bytes between rows of pixels in the source.
+ * @param iX Left edge of the rectangle, a multiple of BLOCK_SIZE.
+ * @param iY Top edge of the rectangle, a multiple of BLOCK_SIZE.
+ * @param iW Width of the rectangle, a multiple of BLOCK_SIZE.
+ * @param iH Height of the rectangle, a multiple of BLOCK_SIZE.
+ * @param eFormat Compressed format to encode to.
+ * @param bHighQuality True to trade encode speed for quality.
+ * @param pqwSquaredError If not null, the squared error of every channel
+ *                        of every compressed pixel is added to it.
+ */
+static auto EncodeRect(uint8_t *pDest, const size_t qwDestPitch, const uint8_t *pSrc, const int iSrcPitch, const int iX,
+                       const int iY, const int iW, const int iH, const bgfx::TextureFormat::Enum eFormat,
+                       const bool bHighQuality, uint64_t *pqwSquaredError) -> void
+{
+    static bx::DefaultAllocator allocator;
+
+    const size_t rowBytes = size_t(iW) * 4;
+    buffer_t pixels(rowBytes * size_t(iH));
+    for (int row = 0; row < iH; row++)
+    {
+        std::memcpy(pixels.data() + (rowBytes * size_t(row)),
+                    pSrc + (size_t(iY + row) * size_t(iSrcPitch)) + (size_t(iX) * 4), rowBytes);
+    }
+
+    buffer_t blocks(ImageBytes(eFormat, iW, iH));
+    bx::Error err;
+    bimg::imageEncodeFromRgba8(&allocator, blocks.data(), pixels.data(), uint32_t(iW), uint32_t(iH), 1,
+                               bimg::TextureFormat::Enum(eFormat),
+                               bHighQuality ? bimg::Quality::Highest : bimg::Quality::Default, &err);
+
+    const size_t blockPitch = ImageBytes(eFormat, iW, BLOCK_SIZE);
+    for (int row = 0; row < iH / BLOCK_SIZE; row++)
+    {
+        std::memcpy(pDest + (qwDestPitch * size_t(row)), blocks.data() + (blockPitch * size_t(row)), blockPitch);
+    }
+
+    if (pqwSquaredError != nullptr)
+    {
+        buffer_t decoded(pixels.size());
+        bimg::imageDecodeToRgba8(&allocator, decoded.data(), blocks.data(), uint32_t(iW), uint32_t(iH),
+                                 uint32_t(rowBytes), bimg::TextureFormat::Enum(eFormat));
+        for (size_t i = 0; i < pixels.size(); i++)
+        {
+            const int64_t diff = int64_t(pixels[i]) - int64_t(decoded[i]);
+            *pqwSquaredError += uint64_t(diff * diff);
+        }
+    }
+}
+
+/**
+ * @brief Decompress a block-compressed image back to RGBA8.
+ */
+static auto DecodeImage(const uint8_t *pData, const int iW, const int iH, const bgfx::TextureFormat::Enum eFormat)
+    -> buffer_t
+{
+    static bx::DefaultAllocator allocator;
+
+    buffer_t rvo(size_t(iW) * size_t(iH) * 4);
+    bimg::imageDecodeToRgba8(&allocator, rvo.data(), pData, uint32_t(iW), uint32_t(iH), uint32_t(iW) * 4,
+                             bimg::TextureFormat::Enum(eFormat));
+    return rvo;
+}
+
+/**
+ * @brief Wrap an image and its mip levels in a KTX 1.1 container.
+ *
+ * @param ncLevels Data of every mip level, biggest first.
+ */
+static auto WriteKTX(const bgfx::TextureFormat::Enum eFormat, const int iW, const int iH,
+                     const std::vector<nonstd::span<const uint8_t>> &ncLevels) -> buffer_t
+{
+    static constexpr uint8_t KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+    static constexpr uint32_t GL_UNSIGNED_BYTE = 0x1401;
+    static constexpr uint32_t GL_RED = 0x1903;
+    static constexpr uint32_t GL_RGBA = 0x1908;
+    static constexpr uint32_t GL_R8 = 0x8229;
+    static constexpr uint32_t GL_RGBA8 = 0x8058;
+    static constexpr uint32_t GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1;
+    static constexpr uint32_t GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+    static constexpr uint32_t GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+
+    uint32_t internalFormat = GL_RGBA8;
+    uint32_t baseFormat = GL_RGBA;
+    switch (eFormat)
+    {
+    case bgfx::TextureFormat::R8:
+        internalFormat = GL_R8;
+        baseFormat = GL_RED;
+        break;
+    case bgfx::TextureFormat::BC1:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        break;
+    case bgfx::TextureFormat::BC3:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+    case bgfx::TextureFormat::BC7:
+        internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+        break;
+    default:
+        break;
+    }
+    const bool compressed = IsBlockFormat(eFormat);
+
+    const uint32_t header[] = {
+        0x04030201,                        // endianness
+        compressed ? 0 : GL_UNSIGNED_BYTE, // glType
+        1,                                 // glTypeSize
+        compressed ? 0 : baseFormat,       // glFormat
+        internalFormat,                    // glInternalFormat
+        baseFormat,                        // glBaseInternalFormat
+        uint32_t(iW),                      // pixelWidth
+        uint32_t(iH),                      // pixelHeight
+        0,                                 // pixelDepth
+        0,                                 // numberOfArrayElements
+        1,                                 // numberOfFaces
+        uint32_t(ncLevels.size()),         // numberOfMipmapLevels
+        0,                                 // bytesOfKeyValueData
+    };
+
+    buffer_t rvo;
+    rvo.insert(rvo.end(), std::begin(KTX_IDENTIFIER), std::end(KTX_IDENTIFIER));
+    const uint8_t *headerBytes = reinterpret_cast<const uint8_t *>(header);
+    rvo.insert(rvo.end(), headerBytes, headerBytes + sizeof(header));
+    for (auto &level : ncLevels)
+    {
+        // Every level is a multiple of four bytes, so no mip padding.
+        const uint32_t imageSize = uint32_t(level.size());
+        const uint8_t *sizeBytes = reinterpret_cast<const uint8_t *>(&imageSize);
+        rvo.insert(rvo.end(), sizeBytes, sizeBytes + sizeof(imageSize));
+        rvo.insert(rvo.end(), level.begin(), level.end());
+    }
+    return rvo;
+}
+
+//******************************************************************************
+
 class TexturesImpl final : public Textures
 {
     //**************************************************************************
 
     static constexpr int ATLAS_SIZE = 2048;
+    static constexpr int ATLAS_BPP = 4;
+    static constexpr int ATLAS_PITCH = ATLAS_SIZE * ATLAS_BPP;
+    static constexpr size_t NO_PAGE = SIZE_MAX;
+    static constexpr int ID_SLOT_BITS = 32; // Low bits of a texture ID are its slot, the rest count reuses.
+    static constexpr size_t PALETTE_SIZE = 256;
+
+    /**
+     * @brief Number of mip levels of every page, including the full size
+     *        level.
+     */
+    static constexpr int MIP_LEVELS = 4;
+
+    /**
+     * @brief Pixels of repeated texture around every tile.
+     *
+     * @details Large enough to leave a pixel of gutter at the smallest mip
+     *          level.  Tiles are also aligned to this, so every tile lands
+     *          on whole pixels at every mip level.
+     */
+    static constexpr int GUTTER = 1 << (MIP_LEVELS - 1);
+    static_assert(GUTTER % BLOCK_SIZE == 0, "Tiles must be block-aligned");
+
+    /**
+     * @brief Number of light levels in a colormap we build ourselves.
+     */
+    static constexpr size_t DEFAULT_LIGHT_LEVELS = 32;
+
+    /**
+     * @brief Rows of a page that are compressed together by a single worker.
+     */
+    static constexpr int ENCODE_BAND = BLOCK_SIZE * 16;
+
+    /**
+     * @brief Fraction of a page that can be taken up by removed textures
+     *        before the page is compacted.
+     */
+    static constexpr float COMPACT_THRESHOLD = 0.25f;
 
+    /**
+     * @brief Bump this whenever the layout of the atlas cache or the way
+     *        textures are packed changes.
+     */
+    static constexpr uint32_t CACHE_VERSION = 3;
+    static constexpr char CACHE_MAGIC[8] = {'R', '3', 'D', 'A', 'T', 'L', 'A', 'S'};
+
+    struct rect_s
+    {
+        int x = 0;
+        int y = 0;
+        int w = 0;
+        int h = 0;
+    };
+
+    /**
+     * @brief A texture in the atlas.
+     *
+     * @details On compressed pages, cRect is padded out to whole blocks and
+     *          can be larger than the texture itself.
+     */
     struct texture_s
     {
         texInfo_s cInfo;
-        bimg::ImageContainer cImage;
+        rect_s cRect;
+        buffer_t cPixels;
+        size_t qwRefs = 0;
+        bool bAlpha = false;
+        bool bRemoved = false;
+        size_t qwReuses = 0; // Times the slot was handed to a new texture.
+    };
+
+    /**
+     * @brief Packer state of a single page.
+     *
+     * @details stb_rect_pack keeps pointers into both the node array and
+     *          the context itself, so this must never move once initialized.
+     */
+    struct packer_s
+    {
+        stbrp_context cContext;
+        std::vector<stbrp_node> ncNodes;
+
+        packer_s()
+        {
+            ncNodes.resize(size_t(ATLAS_SIZE));
+            stbrp_init_target(&cContext, ATLAS_SIZE, ATLAS_SIZE, ncNodes.data(), int(ncNodes.size()));
+        }
+        ROCK3D_NOCOPY(packer_s);
+        ROCK3D_NOMOVE(packer_s);
+    };
+
+    /**
+     * @brief Maps RGBA8 colors to palette indexes.
+     *
+     * @details Colors that are in the palette map straight to their index,
+     *          and anything else maps to the closest color.  Never changes
+     *          once built, so it can be shared with worker threads.
+     */
+    struct quantizer_s
+    {
+        std::array<glm::ivec3, PALETTE_SIZE> ncColors;
+        int iTransparent = -1;
+        std::unordered_map<uint32_t, uint8_t> cExact;
+
+        auto Nearest(const glm::ivec3 &cColor) const -> uint8_t
+        {
+            size_t best = 0;
+            int bestDist = INT32_MAX;
+            for (size_t i = 0; i < ncColors.size(); i++)
+            {
+                if (int(i) == iTransparent)
+                {
+                    continue;
+                }
+                const glm::ivec3 diff = ncColors[i] - cColor;
+                const int dist = (diff.x * diff.x) + (diff.y * diff.y) + (diff.z * diff.z);
+                if (dist < bestDist)
+                {
+                    best = i;
+                    bestDist = dist;
+                }
+            }
+            return uint8_t(best);
+        }
+
+        auto Index(const uint8_t *pRGBA) const -> uint8_t
+        {
+            if (iTransparent >= 0 && pRGBA[3] < 0x80)
+            {
+                return uint8_t(iTransparent);
+            }
+            const uint32_t key = uint32_t(pRGBA[0]) | (uint32_t(pRGBA[1]) << 8) | (uint32_t(pRGBA[2]) << 16);
+            auto it = cExact.find(key);
+            if (it != cExact.end())
+            {
+                return it->second;
+            }
+            return Nearest({pRGBA[0], pRGBA[1], pRGBA[2]});
+        }
+    };
+
+    /**
+     * @brief A texture that has been read and decoded, but not registered.
+     */
+    struct decoded_s
+    {
+        glm::ivec2 cSize;
+        buffer_t cPixels;
+        bool bAlpha = false;
+        uint64_t qwFileBytes = 0;
+        uint64_t qwWorkUS = 0;
+    };
+
+    struct tile_s
+    {
+        size_t qwID = 0;
+        rect_s cRect;
+    };
+
+    /**
+     * @brief Totals for a batch of block compression.
+     */
+    struct encodeStats_s
+    {
+        uint64_t qwWorkUS = 0;
+        uint64_t qwBytes = 0;
+        uint64_t qwSquaredError = 0;
+        uint64_t qwSamples = 0;
+
+        auto operator+=(const encodeStats_s &cOther) -> encodeStats_s &
+        {
+            qwWorkUS += cOther.qwWorkUS;
+            qwBytes += cOther.qwBytes;
+            qwSquaredError += cOther.qwSquaredError;
+            qwSamples += cOther.qwSamples;
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Result of repacking a page in the background.
+     */
+    using levels_t = std::array<buffer_t, MIP_LEVELS>;
+
+    struct compaction_s
+    {
+        std::unique_ptr<packer_s> pPacker;
+        levels_t ncPixels;
+        levels_t ncEncoded;
+        std::vector<tile_s> ncTiles;
+        uint64_t qwUsedArea = 0;
+        encodeStats_s cEncodeStats;
+    };
+
+    /**
+     * @brief A single page of the atlas.
+     *
+     * @details Every page holds either opaque or translucent textures, so
+     *          each kind can use its own GPU format.  Compressed pages keep
+     *          an RGBA8 copy of their pixels around to compress new
+     *          textures and compactions from.  Paletted pages hold one
+     *          palette index per pixel.
+     *
+     *          Pages loaded from the atlas cache have no packer, since we
+     *          don't know the packer state that produced them.  Nothing new
+     *          is packed into them until they are compacted, and their
+     *          data is read straight from the mapped cache file.
+     *
+     *          Pages that lost their data to the CPU budget have no packer
+     *          either, and live on only as their GPU texture.  Pages that
+     *          lost their GPU texture to the GPU budget are marked evicted
+     *          and wait for one of their textures to be used again.
+     */
+    struct page_s
+    {
+        bool bAlpha = false;
+        bgfx::TextureFormat::Enum eFormat = bgfx::TextureFormat::RGBA8;
+        std::unique_ptr<packer_s> pPacker;
+        levels_t ncPixels;
+        levels_t ncEncoded;
+        std::array<bufferView_s, MIP_LEVELS> ncMapped;
+        bgfx::TextureHandle cHandle = BGFX_INVALID_HANDLE;
+        std::vector<rect_s> ncDirty;
+        bool bFullyDirty = true;
+        uint64_t qwUsedArea = 0;
+        uint64_t qwDeadArea = 0;
+        std::future<compaction_s> cCompaction;
+        uint64_t qwFailedDeadArea = 0; // Dead area when a compaction last failed to fit, so we don't retry every frame.
+        uint64_t qwLastUsed = 0;
+        bool bEvicted = false;
+
+        auto IsCompacting() const -> bool
+        {
+            return cCompaction.valid();
+        }
+
+        auto IsCompressed() const -> bool
+        {
+            return IsBlockFormat(eFormat);
+        }
+
+        /**
+         * @brief Uncompressed pixels of a mip level, or nullptr if we only
+         *        have the compressed data.
+         */
+        auto Pixels(const int iLevel) const -> const uint8_t *
+        {
+            if (!ncPixels[iLevel].empty())
+            {
+                return ncPixels[iLevel].data();
+            }
+            return IsCompressed() ? nullptr : ncMapped[iLevel].cSpan.data();
+        }
+
+        /**
+         * @brief Check if the GPU data of the page lives in the mapped
+         *        cache file.
+         */
+        auto IsMapped() const -> bool
+        {
+            return IsCompressed() ? ncEncoded[0].empty() : ncPixels[0].empty();
+        }
+
+        /**
+         * @brief Data of a mip level in the GPU format of the page.
+         */
+        auto Data(const int iLevel) const -> nonstd::span<const uint8_t>
+        {
+            if (IsMapped())
+            {
+                return ncMapped[iLevel].cSpan;
+            }
+            const buffer_t &owned = IsCompressed() ? ncEncoded[iLevel] : ncPixels[iLevel];
+            return nonstd::span<const uint8_t>(owned.data(), owned.size());
+        }
+
+        /**
+         * @brief Check if we still have a copy of the page in memory.
+         */
+        auto HasData() const -> bool
+        {
+            return !Data(0).empty();
+        }
+
+        /**
+         * @brief Check if the GPU has everything the page holds.
+         */
+        auto IsUploaded() const -> bool
+        {
+            return bgfx::isValid(cHandle) && !bFullyDirty && ncDirty.empty();
+        }
+
+        /**
+         * @brief Bytes of memory held by the page, mapped or owned.
+         */
+        auto CPUBytes() const -> uint64_t
+        {
+            uint64_t rvo = 0;
+            for (int level = 0; level < MIP_LEVELS; level++)
+            {
+                rvo += ncPixels[level].size() + ncEncoded[level].size() + ncMapped[level].cSpan.size();
+            }
+            return rvo;
+        }
+
+        static auto Alloc(const bool bAlpha, const bgfx::TextureFormat::Enum eFormat) -> std::unique_ptr<page_s>
+        {
+            auto rvo = std::make_unique<page_s>();
+            rvo->bAlpha = bAlpha;
+            rvo->eFormat = eFormat;
+            rvo->pPacker = std::make_unique<packer_s>();
+            rvo->ncPixels = AllocLevels(eFormat, false);
+            if (rvo->IsCompressed())
+            {
+                rvo->ncEncoded = AllocLevels(eFormat, true);
+            }
+            return rvo;
+        }
+    };
+
+    /**
+     * @brief Header of the atlas cache file.
+     *
+     * @details Followed by one cachePage_s per page, and then one
+     *          cacheEntry_s and name per texture.  The data of every page
+     *          lives in a KTX file next to it.
+     */
+    struct cacheHeader_s
+    {
+        char szMagic[8];
+        uint32_t dwVersion;
+        uint32_t dwAtlasSize;
+        uint64_t qwKey;
+        uint32_t dwPages;
+        uint32_t dwTextures;
+    };
+
+    struct cachePage_s
+    {
+        uint32_t dwFormat;
+        uint32_t dwAlpha;
+    };
+
+    struct cacheEntry_s
+    {
+        uint32_t dwPage;
+        int32_t iX;
+        int32_t iY;
+        int32_t iW;
+        int32_t iH;
+        int32_t iPixelW;
+        int32_t iPixelH;
+        uint32_t dwNameLength;
     };
 
     std::vector<texture_s> m_ncTextures;
-    std::unordered_map<std::string, size_t> m_cTextureNames;
+    std::vector<size_t> m_nqwFreeSlots;                      // Slots of removed textures, to reuse.
+    std::unordered_map<std::string, size_t> m_cTextureNames; // Asset path to slot.
+    uint64_t m_qwTexturePixelBytes = 0;                      // Decoded pixels of textures not placed yet.
+    std::vector<std::unique_ptr<page_s>> m_npPages;
+    bool m_bBaked = false;
+    uint64_t m_qwGeneration = 0;
+    compression_s m_cCompression;
+    std::shared_ptr<const quantizer_s> m_pQuantizer;
+    uint64_t m_qwPaletteHash = 0;
+    buffer_t m_cPaletteRGBA;
+    buffer_t m_cColormap;
+    bgfx::TextureHandle m_cPaletteHandle = BGFX_INVALID_HANDLE;
+    bgfx::TextureHandle m_cColormapHandle = BGFX_INVALID_HANDLE;
+    loadStats_s m_cLoadStats;
+    encodeStats_s m_cEncodeTotals;
+    budget_s m_cBudget;
+    residencyStats_s m_cResidencyStats;
+    uint64_t m_qwFrame = 0;
+
+    struct prefetch_s
+    {
+        std::shared_ptr<const quantizer_s> pQuantizer; // Palette it was decoded for.
+        std::future<std::optional<decoded_s>> cDecoded;
+    };
+    std::unordered_map<std::string, prefetch_s> m_cPrefetched;
+    std::unordered_map<size_t, std::future<std::optional<decoded_s>>> m_cReloads; // Texture ID to its new pixels.
 
     //**************************************************************************
 
-  public:
-    auto AddAsset(const std::string_view strAssetPath) -> bool override
+    static auto Allocator() -> bx::AllocatorI *
+    {
+        static bx::DefaultAllocator allocator;
+        return &allocator;
+    }
+
+    //**************************************************************************
+
+    static auto MicrosecondsSince(const std::chrono::steady_clock::time_point &cStart) -> uint64_t
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - cStart;
+        return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Width and height of a page at a mip level.
+     */
+    static auto LevelSize(const int iLevel) -> int
+    {
+        return ATLAS_SIZE >> iLevel;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Bytes between rows of the CPU copy of a page at a mip level.
+     */
+    static auto PagePitch(const bgfx::TextureFormat::Enum eFormat, const int iLevel) -> int
+    {
+        return LevelSize(iLevel) * PixelBytes(eFormat);
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Allocate every mip level of a page, either the CPU copy or
+     *        the compressed data.
+     */
+    static auto AllocLevels(const bgfx::TextureFormat::Enum eFormat, const bool bEncoded) -> levels_t
+    {
+        levels_t rvo;
+        for (int level = 0; level < MIP_LEVELS; level++)
+        {
+            const int size = LevelSize(level);
+            rvo[level].resize(bEncoded ? ImageBytes(eFormat, size, size) : size_t(PagePitch(eFormat, level)) * size, 0);
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Scale a rectangle on the full size page down to a mip level.
+     */
+    static auto LevelRect(const rect_s &cRect, const int iLevel) -> rect_s
+    {
+        return rect_s{cRect.x >> iLevel, cRect.y >> iLevel, cRect.w >> iLevel, cRect.h >> iLevel};
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Read a texture asset and convert it to the atlas pixel format.
+     *
+     * @details Does not touch any texture state, so it is safe to call from
+     *          worker threads.
+     *
+     * @param strAssetPath Asset path of the texture.
+     * @param pQuantizer Palette to convert to, or nullptr for RGBA8.
+     */
+    static auto DecodeAsset(const std::string_view strAssetPath, const quantizer_s *pQuantizer)
+        -> std::optional<decoded_s>
     {
-        auto maybeAsset = rock3d::GetAssets().ReadToBuffer(strAssetPath);
+        const auto start = std::chrono::steady_clock::now();
+
+        auto maybeAsset = rock3d::GetAssets().ReadToView(strAssetPath);
         if (!maybeAsset.has_value())
         {
-            return false;
+            return std::nullopt;
         }
-        const rock3d::buffer_t &asset = maybeAsset.value();
 
-        bimg::ImageContainer img;
-        if (!bimg::imageParse(img, asset.data(), uint32_t(asset.size())))
+        auto rvo = DecodeBuffer(maybeAsset->cSpan, pQuantizer);
+        if (rvo.has_value())
         {
-            return false;
+            rvo->qwWorkUS = MicrosecondsSince(start);
         }
+        return rvo;
+    }
 
-        // Add to internal tracking.
-        const std::string path = std::string(strAssetPath);
-        const size_t id = m_ncTextures.size();
-        texture_s tex{texInfo_s{id, path}, img};
-        m_ncTextures.push_back(tex);
-        m_cTextureNames[path] = id;
-        return true;
+    //**************************************************************************
+
+    /**
+     * @brief Convert an image file that has already been read to the atlas
+     *        pixel format.
+     */
+    static auto DecodeBuffer(const nonstd::span<const uint8_t> asset, const quantizer_s *pQuantizer)
+        -> std::optional<decoded_s>
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        bimg::ImageContainer *img =
+            bimg::imageParse(Allocator(), asset.data(), uint32_t(asset.size()), bimg::TextureFormat::RGBA8);
+        if (img == nullptr)
+        {
+            return std::nullopt;
+        }
+        auto imgFree = nonstd::make_scope_exit([img] { bimg::imageFree(img); });
+
+        decoded_s rvo;
+        rvo.cSize = {int(img->m_width), int(img->m_height)};
+        const uint8_t *pixels = static_cast<const uint8_t *>(img->m_data);
+        rvo.cPixels.assign(pixels, pixels + (size_t(img->m_width) * img->m_height * size_t(ATLAS_BPP)));
+        for (size_t i = 3; i < rvo.cPixels.size(); i += ATLAS_BPP)
+        {
+            if (rvo.cPixels[i] != 0xFF)
+            {
+                rvo.bAlpha = true;
+                break;
+            }
+        }
+
+        if (pQuantizer != nullptr)
+        {
+            // Art is usually drawn with the palette, so most textures only
+            // need a handful of distinct lookups.
+            std::unordered_map<uint32_t, uint8_t> seen;
+            buffer_t indexes(rvo.cPixels.size() / ATLAS_BPP);
+            for (size_t i = 0; i < indexes.size(); i++)
+            {
+                const uint8_t *rgba = &rvo.cPixels[i * ATLAS_BPP];
+                uint32_t key;
+                std::memcpy(&key, rgba, sizeof(key));
+                auto it = seen.find(key);
+                if (it == seen.end())
+                {
+                    it = seen.emplace(key, pQuantizer->Index(rgba)).first;
+                }
+                indexes[i] = it->second;
+            }
+            rvo.cPixels = std::move(indexes);
+        }
+
+        rvo.qwFileBytes = asset.size();
+        rvo.qwWorkUS = MicrosecondsSince(start);
+        return rvo;
     }
 
     //**************************************************************************
 
-    auto BakeAtlas() -> bool override
+    /**
+     * @brief Slot of a texture ID.
+     */
+    static auto IDSlot(const size_t qwID) -> size_t
     {
-        std::vector<stbrp_node> nodes;
-        nodes.resize(size_t(ATLAS_SIZE));
-        stbrp_context ctx;
-        stbrp_init_target(&ctx, ATLAS_SIZE, ATLAS_SIZE, nodes.data(), int(nodes.size()));
+        return qwID & ((size_t(1) << ID_SLOT_BITS) - 1);
+    }
 
-        // Set up a rects array so we have a place to write our coordinates.
-        std::vector<stbrp_rect> rects;
-        for (auto &tex : m_ncTextures)
+    /**
+     * @brief Set up a slot for a new texture, reusing the slot of a removed
+     *        one if there is any.
+     *
+     * @details A reused slot gets a new ID, so IDs of removed textures
+     *          never find the texture that took their place.
+     */
+    auto AllocSlot(const std::string &strAssetPath) -> texture_s &
+    {
+        size_t slot = m_ncTextures.size();
+        if (m_nqwFreeSlots.empty())
+        {
+            m_ncTextures.emplace_back();
+        }
+        else
         {
-            stbrp_rect rect;
-            rect.id = int(tex.cInfo.qwID);
-            rect.w = stbrp_coord(tex.cImage.m_width);
-            rect.h = stbrp_coord(tex.cImage.m_height);
+            slot = m_nqwFreeSlots.back();
+            m_nqwFreeSlots.pop_back();
+            const size_t reuses = m_ncTextures[slot].qwReuses + 1;
+            m_ncTextures[slot] = texture_s{};
+            m_ncTextures[slot].qwReuses = reuses;
         }
 
-        // Do the packing.
-        if (!stbrp_pack_rects(&ctx, rects.data(), int(rects.size())))
+        texture_s &rvo = m_ncTextures[slot];
+        rvo.cInfo.qwID = (rvo.qwReuses << ID_SLOT_BITS) | slot;
+        rvo.cInfo.strName = strAssetPath;
+        rvo.cInfo.qwPage = NO_PAGE;
+        rvo.qwRefs = 1;
+        m_cTextureNames[strAssetPath] = slot;
+        return rvo;
+    }
+
+    /**
+     * @brief Remove a texture and give its slot back.  Its atlas space, if
+     *        it has any, is left for the caller to deal with.
+     */
+    auto FreeSlot(const size_t qwSlot) -> void
+    {
+        texture_s &tex = m_ncTextures[qwSlot];
+        tex.bRemoved = true;
+        SetPixels(tex, buffer_t());
+        m_cTextureNames.erase(tex.cInfo.strName);
+        m_cReloads.erase(qwSlot);
+        m_nqwFreeSlots.push_back(qwSlot);
+    }
+
+    /**
+     * @brief Replace the decoded pixels a texture holds on to until it is
+     *        placed, keeping count of them for the budget.
+     */
+    auto SetPixels(texture_s &cTex, buffer_t &&cPixels) -> void
+    {
+        m_qwTexturePixelBytes -= cTex.cPixels.size();
+        cTex.cPixels = std::move(cPixels);
+        m_qwTexturePixelBytes += cTex.cPixels.size();
+    }
+
+    /**
+     * @brief Add a decoded texture to internal tracking.
+     */
+    auto Register(const std::string_view strAssetPath, decoded_s &&cDecoded) -> void
+    {
+        texture_s &tex = AllocSlot(std::string(strAssetPath));
+        tex.cInfo.cPixelSize = cDecoded.cSize;
+        tex.bAlpha = cDecoded.bAlpha;
+        SetPixels(tex, std::move(cDecoded.cPixels));
+
+        m_cLoadStats.qwTextures += 1;
+        m_cLoadStats.qwFileBytes += cDecoded.qwFileBytes;
+        m_cLoadStats.qwPixelBytes += tex.cPixels.size();
+        m_cLoadStats.qwWorkUS += cDecoded.qwWorkUS;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Copy a rectangle of pixels between two buffers.
+     *
+     * @param iBPP Bytes per pixel of both buffers.
+     */
+    static auto BlitRect(uint8_t *pDest, const int iDestPitch, const int iDestX, const int iDestY,
+                         const uint8_t *pSrc, const int iSrcPitch, const int iSrcX, const int iSrcY, const int iW,
+                         const int iH, const int iBPP) -> void
+    {
+        const size_t rowBytes = size_t(iW) * size_t(iBPP);
+        for (int row = 0; row < iH; row++)
         {
-            return false;
+            uint8_t *dest = pDest + (size_t(iDestY + row) * size_t(iDestPitch)) + (size_t(iDestX) * size_t(iBPP));
+            const uint8_t *src = pSrc + (size_t(iSrcY + row) * size_t(iSrcPitch)) + (size_t(iSrcX) * size_t(iBPP));
+            std::memcpy(dest, src, rowBytes);
         }
+    }
 
-        // Update the atlas position of each texture.
-        for (auto &rect : rects)
+    //**************************************************************************
+
+    /**
+     * @brief Copy a texture into its tile on the full size level of a page.
+     *
+     * @details The texture is centered in the tile and repeated out to the
+     *          tile edges, so filtering and mip levels near the edge of the
+     *          texture see the same pixels they would if it wrapped.  This
+     *          also keeps compressed blocks on the edge from picking up
+     *          colors that aren't there.
+     */
+    static auto FillTile(page_s &cPage, const rect_s &cRect, const texture_s &cTex) -> void
+    {
+        uint8_t *pixels = cPage.ncPixels[0].data();
+        const int bpp = PixelBytes(cPage.eFormat);
+        const int pitch = PagePitch(cPage.eFormat, 0);
+        const glm::ivec2 size = cTex.cInfo.cPixelSize;
+        const int srcPitch = size.x * bpp;
+
+        for (int row = 0; row < cRect.h; row++)
         {
-            // Calculate atlas coordinates.
-            auto &tex = m_ncTextures[size_t(rect.id)];
-            tex.cInfo.cPixelSize = {rect.x, rect.y};
-            tex.cInfo.cAtlasMin = {
-                float(rect.x) / ATLAS_SIZE,
-                float(rect.y) / ATLAS_SIZE,
-            };
-            tex.cInfo.cAtlasMax = {
-                float(rect.x + rect.w) / ATLAS_SIZE,
-                float(rect.y + rect.h) / ATLAS_SIZE,
-            };
+            const int srcY = (((row - GUTTER) % size.y) + size.y) % size.y;
+            const uint8_t *src = cTex.cPixels.data() + (size_t(srcY) * size_t(srcPitch));
+            uint8_t *dest = pixels + (size_t(cRect.y + row) * size_t(pitch)) + (size_t(cRect.x) * size_t(bpp));
+            for (int col = 0; col < cRect.w; col++)
+            {
+                const int srcX = (((col - GUTTER) % size.x) + size.x) % size.x;
+                std::memcpy(dest + (size_t(col) * size_t(bpp)), src + (size_t(srcX) * size_t(bpp)), size_t(bpp));
+            }
         }
+    }
 
-        return true;
+    //**************************************************************************
+
+    /**
+     * @brief Fill the tile of a mip level by averaging 2x2 pixels of the
+     *        tile one level up.
+     *
+     * @details Only reads the tile itself, so tiles never bleed into each
+     *          other.  Paletted pages average the palette colors and pick
+     *          the closest one, and become transparent if most of the
+     *          pixels are.
+     */
+    static auto DownsampleTile(page_s &cPage, const rect_s &cRect, const int iLevel, const quantizer_s *pQuantizer)
+        -> void
+    {
+        const int bpp = PixelBytes(cPage.eFormat);
+        const int srcPitch = PagePitch(cPage.eFormat, iLevel - 1);
+        const int destPitch = PagePitch(cPage.eFormat, iLevel);
+        const uint8_t *src = cPage.ncPixels[iLevel - 1].data();
+        uint8_t *dest = cPage.ncPixels[iLevel].data();
+        const rect_s rect = LevelRect(cRect, iLevel);
+
+        for (int y = rect.y; y < rect.y + rect.h; y++)
+        {
+            const uint8_t *row0 = src + (size_t(y * 2) * size_t(srcPitch));
+            const uint8_t *row1 = row0 + srcPitch;
+            uint8_t *out = dest + (size_t(y) * size_t(destPitch));
+            for (int x = rect.x; x < rect.x + rect.w; x++)
+            {
+                const uint8_t *quad[4] = {
+                    row0 + (size_t(x * 2) * size_t(bpp)),
+                    row0 + (size_t(x * 2 + 1) * size_t(bpp)),
+                    row1 + (size_t(x * 2) * size_t(bpp)),
+                    row1 + (size_t(x * 2 + 1) * size_t(bpp)),
+                };
+
+                if (pQuantizer == nullptr)
+                {
+                    for (int c = 0; c < bpp; c++)
+                    {
+                        const int sum = quad[0][c] + quad[1][c] + quad[2][c] + quad[3][c];
+                        out[(size_t(x) * size_t(bpp)) + size_t(c)] = uint8_t((sum + 2) / 4);
+                    }
+                    continue;
+                }
+
+                glm::ivec3 sum{0, 0, 0};
+                int opaque = 0;
+                for (auto *pixel : quad)
+                {
+                    if (int(*pixel) == pQuantizer->iTransparent)
+                    {
+                        continue;
+                    }
+                    sum = sum + pQuantizer->ncColors[*pixel];
+                    opaque += 1;
+                }
+                if (opaque < 2)
+                {
+                    out[x] = uint8_t(pQuantizer->iTransparent);
+                    continue;
+                }
+                out[x] = pQuantizer->Nearest({sum.x / opaque, sum.y / opaque, sum.z / opaque});
+            }
+        }
     }
 
     //**************************************************************************
 
-    auto ToGPU() -> void override {}
+    /**
+     * @brief Update the atlas coordinates of a texture after it was placed.
+     */
+    static auto SetAtlasRect(texture_s &cTex, const size_t qwPage, const rect_s &cRect) -> void
+    {
+        cTex.cRect = cRect;
+        texInfo_s &cInfo = cTex.cInfo;
+        cInfo.qwPage = qwPage;
+        cInfo.cAtlasMin = {
+            float(cRect.x + GUTTER) / ATLAS_SIZE,
+            float(cRect.y + GUTTER) / ATLAS_SIZE,
+        };
+        cInfo.cAtlasMax = {
+            float(cRect.x + GUTTER + cInfo.cPixelSize.x) / ATLAS_SIZE,
+            float(cRect.y + GUTTER + cInfo.cPixelSize.y) / ATLAS_SIZE,
+        };
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Offset of the block containing a pixel in a compressed mip
+     *        level.
+     */
+    static auto BlockOffset(const bgfx::TextureFormat::Enum eFormat, const int iLevel, const int iX, const int iY)
+        -> size_t
+    {
+        return ImageBytes(eFormat, LevelSize(iLevel), iY) + ImageBytes(eFormat, iX, BLOCK_SIZE);
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Grow a rectangle on a mip level out to whole blocks.
+     */
+    static auto BlockRect(const rect_s &cRect) -> rect_s
+    {
+        const int x1 = cRect.x / BLOCK_SIZE * BLOCK_SIZE;
+        const int y1 = cRect.y / BLOCK_SIZE * BLOCK_SIZE;
+        const int x2 = (cRect.x + cRect.w + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        const int y2 = (cRect.y + cRect.h + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        return rect_s{x1, y1, x2 - x1, y2 - y1};
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Compress block-aligned rectangles of a mip level, spread out
+     *        over worker threads.
+     *
+     * @details The rectangles must not overlap.
+     *
+     * @param pPixels RGBA8 pixels of the mip level.
+     * @param pEncoded Compressed mip level to write to.
+     */
+    static auto EncodeRects(const uint8_t *pPixels, uint8_t *pEncoded, const bgfx::TextureFormat::Enum eFormat,
+                            const int iLevel, const compression_s &cCompression, const std::vector<rect_s> &ncRects)
+        -> encodeStats_s
+    {
+        std::vector<encodeStats_s> stats(ncRects.size());
+        GetWorkers().ParallelFor(ncRects.size(), [&](const size_t i) {
+            const auto start = std::chrono::steady_clock::now();
+
+            const rect_s &rect = ncRects[i];
+            uint64_t *squaredError = cCompression.bMeasureError ? &stats[i].qwSquaredError : nullptr;
+            EncodeRect(pEncoded + BlockOffset(eFormat, iLevel, rect.x, rect.y),
+                       ImageBytes(eFormat, LevelSize(iLevel), BLOCK_SIZE), pPixels, PagePitch(eFormat, iLevel), rect.x,
+                       rect.y, rect.w, rect.h, eFormat, cCompression.bHighQuality, squaredError);
+
+            stats[i].qwBytes = ImageBytes(eFormat, rect.w, rect.h);
+            stats[i].qwSamples = squaredError ? uint64_t(rect.w) * uint64_t(rect.h) * ATLAS_BPP : 0;
+            stats[i].qwWorkUS = MicrosecondsSince(start);
+        });
+
+        encodeStats_s rvo;
+        for (auto &stat : stats)
+        {
+            rvo += stat;
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Compress every mip level of a page, in bands of rows.
+     */
+    static auto EncodeLevels(const levels_t &ncPixels, levels_t &ncEncoded, const bgfx::TextureFormat::Enum eFormat,
+                             const compression_s &cCompression) -> encodeStats_s
+    {
+        encodeStats_s rvo;
+        for (int level = 0; level < MIP_LEVELS; level++)
+        {
+            const int size = LevelSize(level);
+            std::vector<rect_s> bands;
+            for (int y = 0; y < size; y += ENCODE_BAND)
+            {
+                bands.push_back(rect_s{0, y, size, std::min(ENCODE_BAND, size - y)});
+            }
+            rvo += EncodeRects(ncPixels[level].data(), ncEncoded[level].data(), eFormat, level, cCompression, bands);
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Compress newly placed tiles at every mip level.
+     *
+     * @details Tiles stay block-aligned on the bigger mip levels, so they
+     *          are compressed one by one.  On the smaller levels a tile can
+     *          share blocks with its neighbours, so whole rows of blocks
+     *          are compressed instead to keep workers from writing the
+     *          same block.  Those levels are small, so this is cheap.
+     */
+    static auto EncodeTiles(page_s &cPage, const compression_s &cCompression, const std::vector<rect_s> &ncTiles)
+        -> encodeStats_s
+    {
+        encodeStats_s rvo;
+        for (int level = 0; level < MIP_LEVELS; level++)
+        {
+            std::vector<rect_s> rects;
+            if ((GUTTER >> level) % BLOCK_SIZE == 0)
+            {
+                for (auto &tile : ncTiles)
+                {
+                    rects.push_back(LevelRect(tile, level));
+                }
+            }
+            else
+            {
+                const int size = LevelSize(level);
+                std::vector<bool> rows(size_t(size / BLOCK_SIZE), false);
+                for (auto &tile : ncTiles)
+                {
+                    const rect_s rect = BlockRect(LevelRect(tile, level));
+                    for (int y = rect.y; y < rect.y + rect.h; y += BLOCK_SIZE)
+                    {
+                        rows[size_t(y / BLOCK_SIZE)] = true;
+                    }
+                }
+                for (size_t row = 0; row < rows.size(); row++)
+                {
+                    if (rows[row])
+                    {
+                        rects.push_back(rect_s{0, int(row) * BLOCK_SIZE, size, BLOCK_SIZE});
+                    }
+                }
+            }
+            rvo += EncodeRects(cPage.ncPixels[level].data(), cPage.ncEncoded[level].data(), cPage.eFormat, level,
+                               cCompression, rects);
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto AddEncodeStats(const encodeStats_s &cStats) -> void
+    {
+        m_cEncodeTotals += cStats;
+
+        m_cLoadStats.qwEncodeUS = m_cEncodeTotals.qwWorkUS;
+        m_cLoadStats.qwEncodedBytes = m_cEncodeTotals.qwBytes;
+        if (m_cEncodeTotals.qwSamples != 0)
+        {
+            m_cLoadStats.fEncodeRMSE =
+                float(std::sqrt(double(m_cEncodeTotals.qwSquaredError) / double(m_cEncodeTotals.qwSamples)));
+        }
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Build a colormap by darkening every palette color and picking
+     *        the closest match.
+     *
+     * @details Row 0 is full brightness, and every row after it is a
+     *          little darker.  The transparent index always maps to itself.
+     */
+    static auto BuildColormap(const quantizer_s &cQuantizer, const size_t qwLevels) -> buffer_t
+    {
+        buffer_t rvo(qwLevels * PALETTE_SIZE);
+        GetWorkers().ParallelFor(qwLevels, [&cQuantizer, &rvo, qwLevels](const size_t level) {
+            const float scale = 1.0f - (float(level) / float(qwLevels));
+            for (size_t i = 0; i < PALETTE_SIZE; i++)
+            {
+                uint8_t &dest = rvo[(level * PALETTE_SIZE) + i];
+                if (int(i) == cQuantizer.iTransparent)
+                {
+                    dest = uint8_t(i);
+                    continue;
+                }
+                const glm::vec3 darkened = glm::vec3(cQuantizer.ncColors[i]) * scale;
+                dest = cQuantizer.Nearest(glm::ivec3(glm::round(darkened)));
+            }
+        });
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Upload the palette and colormap, if we have them and haven't
+     *        already.
+     */
+    auto UploadPalette() -> void
+    {
+        if (!m_pQuantizer)
+        {
+            return;
+        }
+
+        if (!bgfx::isValid(m_cPaletteHandle))
+        {
+            m_cPaletteHandle = bgfx::createTexture2D(
+                uint16_t(PALETTE_SIZE), 1, false, 1, bgfx::TextureFormat::RGBA8, BGFX_SAMPLER_POINT,
+                bgfx::copy(m_cPaletteRGBA.data(), uint32_t(m_cPaletteRGBA.size())));
+        }
+        if (!bgfx::isValid(m_cColormapHandle))
+        {
+            m_cColormapHandle = bgfx::createTexture2D(uint16_t(PALETTE_SIZE), uint16_t(ColormapLevels()), false, 1,
+                                                      bgfx::TextureFormat::R8, BGFX_SAMPLER_POINT,
+                                                      bgfx::copy(m_cColormap.data(), uint32_t(m_cColormap.size())));
+        }
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Check if opaque and translucent textures go on separate pages.
+     */
+    auto SplitByAlpha() const -> bool
+    {
+        return m_cCompression.eOpaque != m_cCompression.eAlpha;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Pack every texture that does not have a place in the atlas yet.
+     *
+     * @details Textures are packed into the free space of existing pages
+     *          first, and new pages are only started once nothing more fits.
+     *          Pages that are in the middle of being compacted are skipped.
+     *
+     * @return True if every texture found a place.
+     */
+    auto PackPending() -> bool
+    {
+        bool ok = PackPendingClass(false);
+        if (SplitByAlpha())
+        {
+            ok = PackPendingClass(true) && ok;
+        }
+        return ok;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Pack the pending textures that go on one kind of page.
+     *
+     * @param bAlpha True for translucent textures, false for opaque ones.
+     *               Ignored if all textures share the same pages.
+     */
+    auto PackPendingClass(const bool bAlpha) -> bool
+    {
+        const bool split = SplitByAlpha();
+        const bgfx::TextureFormat::Enum format = bAlpha ? m_cCompression.eAlpha : m_cCompression.eOpaque;
+
+        // Tiles are the texture plus its gutter, rounded up to a multiple of
+        // GUTTER.  Since every rectangle is a multiple of GUTTER, the packer
+        // only ever places them on multiples of GUTTER too.
+        std::vector<stbrp_rect> rects;
+        for (auto &tex : m_ncTextures)
+        {
+            if (tex.bRemoved || tex.cInfo.qwPage != NO_PAGE || (split && tex.bAlpha != bAlpha))
+            {
+                continue;
+            }
+
+            stbrp_rect rect{};
+            rect.id = int(IDSlot(tex.cInfo.qwID));
+            rect.w = stbrp_coord((tex.cInfo.cPixelSize.x + (GUTTER * 3) - 1) / GUTTER * GUTTER);
+            rect.h = stbrp_coord((tex.cInfo.cPixelSize.y + (GUTTER * 3) - 1) / GUTTER * GUTTER);
+            rects.push_back(rect);
+        }
+
+        size_t pageIndex = 0;
+        while (!rects.empty())
+        {
+            const bool freshPage = pageIndex >= m_npPages.size();
+            if (freshPage)
+            {
+                m_npPages.push_back(page_s::Alloc(split && bAlpha, format));
+            }
+
+            if (IsReleased(*m_npPages[pageIndex]))
+            {
+                // Nothing lives here anymore, so it can become any kind of
+                // page.
+                m_npPages[pageIndex] = page_s::Alloc(split && bAlpha, format);
+            }
+
+            page_s &page = *m_npPages[pageIndex];
+            if (page.IsCompacting() || !page.pPacker || page.eFormat != format || (split && page.bAlpha != bAlpha))
+            {
+                pageIndex += 1;
+                continue;
+            }
+
+            stbrp_pack_rects(&page.pPacker->cContext, rects.data(), int(rects.size()));
+
+            std::vector<stbrp_rect> leftover;
+            std::vector<tile_s> placed;
+            for (auto &rect : rects)
+            {
+                if (!rect.was_packed)
+                {
+                    leftover.push_back(rect);
+                    continue;
+                }
+                const size_t id = m_ncTextures[size_t(rect.id)].cInfo.qwID;
+                placed.push_back(tile_s{id, rect_s{rect.x, rect.y, rect.w, rect.h}});
+            }
+
+            // Tiles never overlap, so every tile and its mip levels can be
+            // built on a different worker.
+            const quantizer_s *quantizer = m_pQuantizer.get();
+            GetWorkers().ParallelFor(placed.size(), [this, &page, &placed, quantizer](const size_t i) {
+                FillTile(page, placed[i].cRect, m_ncTextures[IDSlot(placed[i].qwID)]);
+                for (int level = 1; level < MIP_LEVELS; level++)
+                {
+                    DownsampleTile(page, placed[i].cRect, level, quantizer);
+                }
+            });
+
+            // The page has its own copy of the pixels now, and compaction
+            // works from that copy, so the decoded texture can go.
+            std::vector<rect_s> placedRects;
+            for (auto &tile : placed)
+            {
+                auto &tex = m_ncTextures[IDSlot(tile.qwID)];
+                page.qwUsedArea += uint64_t(tile.cRect.w) * uint64_t(tile.cRect.h);
+                SetAtlasRect(tex, pageIndex, tile.cRect);
+                SetPixels(tex, buffer_t());
+                placedRects.push_back(tile.cRect);
+            }
+
+            if (page.IsCompressed() && !placedRects.empty())
+            {
+                AddEncodeStats(EncodeTiles(page, m_cCompression, placedRects));
+            }
+            page.ncDirty.insert(page.ncDirty.end(), placedRects.begin(), placedRects.end());
+
+            if (freshPage && leftover.size() == rects.size())
+            {
+                // Nothing fits into an empty page, these textures are too
+                // big for the atlas.  Drop them so we don't retry forever.
+                m_npPages.pop_back();
+                for (auto &rect : leftover)
+                {
+                    FreeSlot(size_t(rect.id));
+                }
+                return false;
+            }
+
+            rects = std::move(leftover);
+            pageIndex += 1;
+        }
+
+        return true;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Repack the live textures of a page into a fresh page.
+     *
+     * @details Runs on a worker thread.  It only reads the pixels of the old
+     *          page, which are left alone while a compaction is in progress.
+     *          Tiles carry their own mip levels and gutters, so every level
+     *          is moved over as-is.
+     *
+     *          The packer sorts tiles its own way, so tiles that fit on the
+     *          old page in the order they were added don't always fit on
+     *          the new one.  If any tile doesn't fit, the result has no
+     *          packer and the old page is kept.
+     */
+    static auto CompactPage(const page_s *pPage, const compression_s cCompression, std::vector<tile_s> ncTiles)
+        -> compaction_s
+    {
+        const bgfx::TextureFormat::Enum format = pPage->eFormat;
+        const int bpp = PixelBytes(format);
+
+        // Pages from the cache might only have compressed data.
+        levels_t decoded;
+        std::array<const uint8_t *, MIP_LEVELS> pixels;
+        for (int level = 0; level < MIP_LEVELS; level++)
+        {
+            pixels[level] = pPage->Pixels(level);
+            if (pixels[level] == nullptr)
+            {
+                const int size = LevelSize(level);
+                decoded[level] = DecodeImage(pPage->Data(level).data(), size, size, format);
+                pixels[level] = decoded[level].data();
+            }
+        }
+
+        compaction_s rvo;
+        rvo.pPacker = std::make_unique<packer_s>();
+        rvo.ncPixels = AllocLevels(format, false);
+
+        std::vector<stbrp_rect> rects;
+        for (size_t i = 0; i < ncTiles.size(); i++)
+        {
+            stbrp_rect rect{};
+            rect.id = int(i);
+            rect.w = stbrp_coord(ncTiles[i].cRect.w);
+            rect.h = stbrp_coord(ncTiles[i].cRect.h);
+            rects.push_back(rect);
+        }
+
+        if (stbrp_pack_rects(&rvo.pPacker->cContext, rects.data(), int(rects.size())) == 0)
+        {
+            return compaction_s{};
+        }
+
+        for (auto &rect : rects)
+        {
+            tile_s &tile = ncTiles[size_t(rect.id)];
+            const rect_s placed{rect.x, rect.y, rect.w, rect.h};
+            for (int level = 0; level < MIP_LEVELS; level++)
+            {
+                const rect_s src = LevelRect(tile.cRect, level);
+                const rect_s dest = LevelRect(placed, level);
+                const int pitch = PagePitch(format, level);
+                BlitRect(rvo.ncPixels[level].data(), pitch, dest.x, dest.y, pixels[level], pitch, src.x, src.y, src.w,
+                         src.h, bpp);
+            }
+            tile.cRect = placed;
+            rvo.qwUsedArea += uint64_t(rect.w) * uint64_t(rect.h);
+        }
+
+        if (IsBlockFormat(format))
+        {
+            rvo.ncEncoded = AllocLevels(format, true);
+            rvo.cEncodeStats = EncodeLevels(rvo.ncPixels, rvo.ncEncoded, format, cCompression);
+        }
+
+        rvo.ncTiles = std::move(ncTiles);
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Start compacting a page if enough of it has gone to waste.
+     */
+    auto MaybeStartCompaction(const size_t qwPage) -> void
+    {
+        page_s &page = *m_npPages[qwPage];
+        if (page.IsCompacting() || page.qwUsedArea == 0 || !page.HasData())
+        {
+            return;
+        }
+
+        const float waste = float(page.qwDeadArea) / float(page.qwUsedArea);
+        if (waste < COMPACT_THRESHOLD || page.qwDeadArea <= page.qwFailedDeadArea)
+        {
+            return;
+        }
+
+        std::vector<tile_s> tiles;
+        for (auto &tex : m_ncTextures)
+        {
+            if (tex.bRemoved || tex.cInfo.qwPage != qwPage)
+            {
+                continue;
+            }
+
+            tiles.push_back(tile_s{tex.cInfo.qwID, tex.cRect});
+        }
+
+        auto promise = std::make_shared<std::promise<compaction_s>>();
+        page.cCompaction = promise->get_future();
+        GetWorkers().Submit([promise, pPage = &page, compression = m_cCompression, tiles = std::move(tiles)] {
+            promise->set_value(CompactPage(pPage, compression, tiles));
+        });
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Swap in the result of a finished compaction.
+     */
+    auto FinishCompaction(const size_t qwPage) -> void
+    {
+        page_s &page = *m_npPages[qwPage];
+        compaction_s result = page.cCompaction.get();
+        if (!result.pPacker)
+        {
+            // Didn't fit, so leave the page alone until more of it dies.
+            page.qwFailedDeadArea = page.qwDeadArea;
+            return;
+        }
+
+        page.pPacker = std::move(result.pPacker);
+        page.ncPixels = std::move(result.ncPixels);
+        page.ncEncoded = std::move(result.ncEncoded);
+        page.ncMapped = {};
+        page.ncDirty.clear();
+        page.bFullyDirty = true;
+        page.qwUsedArea = result.qwUsedArea;
+        page.qwDeadArea = 0;
+        page.qwFailedDeadArea = 0;
+        AddEncodeStats(result.cEncodeStats);
+
+        for (auto &tile : result.ncTiles)
+        {
+            auto &tex = m_ncTextures[IDSlot(tile.qwID)];
+            if (tex.bRemoved || tex.cInfo.qwID != tile.qwID)
+            {
+                // Removed while the compaction was running, and maybe
+                // replaced.
+                page.qwDeadArea += uint64_t(tile.cRect.w) * uint64_t(tile.cRect.h);
+                continue;
+            }
+            SetAtlasRect(tex, qwPage, tile.cRect);
+        }
+
+        m_qwGeneration += 1;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Swap in the new pixels of every reload that finished decoding.
+     *
+     * @details A texture that kept its size and kind is redrawn into its
+     *          tile.  Anything else gives up its tile, which becomes dead
+     *          area like a removed texture, and is packed again.  Textures
+     *          on a page that is compacting wait until it is done, since
+     *          the compaction is reading the page.
+     */
+    auto ApplyReloads() -> void
+    {
+        bool moved = false;
+        for (auto it = m_cReloads.begin(); it != m_cReloads.end();)
+        {
+            texture_s &tex = m_ncTextures[it->first];
+            const bool placed = !tex.bRemoved && tex.cInfo.qwPage != NO_PAGE;
+            if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready ||
+                (placed && m_npPages[tex.cInfo.qwPage]->IsCompacting()))
+            {
+                ++it;
+                continue;
+            }
+
+            std::optional<decoded_s> decoded = it->second.get();
+            it = m_cReloads.erase(it);
+            if (tex.bRemoved || !decoded.has_value())
+            {
+                continue;
+            }
+            m_cLoadStats.qwReloaded += 1;
+
+            page_s *page = placed ? m_npPages[tex.cInfo.qwPage].get() : nullptr;
+            const bool sameKind = !SplitByAlpha() || decoded->bAlpha == tex.bAlpha;
+            SetPixels(tex, std::move(decoded->cPixels));
+            tex.bAlpha = decoded->bAlpha;
+            if (page != nullptr && page->pPacker && sameKind && decoded->cSize == tex.cInfo.cPixelSize)
+            {
+                FillTile(*page, tex.cRect, tex);
+                for (int level = 1; level < MIP_LEVELS; level++)
+                {
+                    DownsampleTile(*page, tex.cRect, level, m_pQuantizer.get());
+                }
+                if (page->IsCompressed())
+                {
+                    AddEncodeStats(EncodeTiles(*page, m_cCompression, {tex.cRect}));
+                }
+                page->ncDirty.push_back(tex.cRect);
+                SetPixels(tex, buffer_t());
+                continue;
+            }
+
+            if (page != nullptr)
+            {
+                page->qwDeadArea += uint64_t(tex.cRect.w) * uint64_t(tex.cRect.h);
+                tex.cInfo.qwPage = NO_PAGE;
+                moved = true;
+            }
+            tex.cInfo.cPixelSize = decoded->cSize;
+        }
+
+        if (moved && m_bBaked)
+        {
+            PackPending();
+            m_qwGeneration += 1;
+        }
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Upload the changed parts of a page.
+     */
+    auto UploadPage(page_s &cPage) -> void
+    {
+        if (!bgfx::isValid(cPage.cHandle))
+        {
+            // Created without memory, so it can be updated later.  bgfx
+            // always allocates a full mip chain, but we only fill the first
+            // MIP_LEVELS and the shaders never pick a smaller level.
+            cPage.cHandle = bgfx::createTexture2D(uint16_t(ATLAS_SIZE), uint16_t(ATLAS_SIZE), true, 1, cPage.eFormat,
+                                                  BGFX_SAMPLER_POINT);
+            cPage.bFullyDirty = true;
+        }
+
+        // If most of the page changed, a single upload is cheaper than many
+        // small ones.
+        uint64_t dirtyArea = 0;
+        for (auto &rect : cPage.ncDirty)
+        {
+            dirtyArea += uint64_t(rect.w) * uint64_t(rect.h);
+        }
+        if (dirtyArea * 2 > uint64_t(ATLAS_SIZE) * ATLAS_SIZE)
+        {
+            cPage.bFullyDirty = true;
+        }
+
+        for (int level = 0; level < MIP_LEVELS; level++)
+        {
+            const nonstd::span<const uint8_t> data = cPage.Data(level);
+            const uint16_t size = uint16_t(LevelSize(level));
+            if (cPage.bFullyDirty && cPage.IsMapped())
+            {
+                // Straight from the mapped cache file.
+                const bgfx::Memory *mem = ViewToMemory(cPage.ncMapped[level]);
+                bgfx::updateTexture2D(cPage.cHandle, 0, uint8_t(level), 0, 0, size, size, mem);
+            }
+            else if (cPage.bFullyDirty)
+            {
+                const bgfx::Memory *mem = bgfx::copy(data.data(), uint32_t(data.size()));
+                bgfx::updateTexture2D(cPage.cHandle, 0, uint8_t(level), 0, 0, size, size, mem);
+            }
+            else if (cPage.IsCompressed())
+            {
+                // Copy whole rows of blocks out of the compressed level.  On
+                // small levels this can pick up a bit of the neighbouring
+                // tiles, which is harmless.
+                const size_t levelPitch = ImageBytes(cPage.eFormat, size, BLOCK_SIZE);
+                for (auto &dirty : cPage.ncDirty)
+                {
+                    const rect_s rect = BlockRect(LevelRect(dirty, level));
+                    const size_t pitch = ImageBytes(cPage.eFormat, rect.w, BLOCK_SIZE);
+                    const bgfx::Memory *mem = bgfx::alloc(uint32_t(ImageBytes(cPage.eFormat, rect.w, rect.h)));
+                    const uint8_t *src = data.data() + BlockOffset(cPage.eFormat, level, rect.x, rect.y);
+                    for (int row = 0; row < rect.h / BLOCK_SIZE; row++)
+                    {
+                        std::memcpy(mem->data + (pitch * size_t(row)), src + (levelPitch * size_t(row)), pitch);
+                    }
+                    bgfx::updateTexture2D(cPage.cHandle, 0, uint8_t(level), uint16_t(rect.x), uint16_t(rect.y),
+                                          uint16_t(rect.w), uint16_t(rect.h), mem);
+                }
+            }
+            else
+            {
+                const int bpp = PixelBytes(cPage.eFormat);
+                for (auto &dirty : cPage.ncDirty)
+                {
+                    const rect_s rect = LevelRect(dirty, level);
+                    const uint32_t pitch = uint32_t(rect.w) * uint32_t(bpp);
+                    const bgfx::Memory *mem = bgfx::alloc(pitch * uint32_t(rect.h));
+                    BlitRect(mem->data, int(pitch), 0, 0, cPage.Pixels(level), PagePitch(cPage.eFormat, level), rect.x,
+                             rect.y, rect.w, rect.h, bpp);
+                    bgfx::updateTexture2D(cPage.cHandle, 0, uint8_t(level), uint16_t(rect.x), uint16_t(rect.y),
+                                          uint16_t(rect.w), uint16_t(rect.h), mem, uint16_t(pitch));
+                }
+            }
+        }
+
+        cPage.ncDirty.clear();
+        cPage.bFullyDirty = false;
+        cPage.qwLastUsed = m_qwFrame;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Bytes a page takes up on the GPU.
+     *
+     * @details bgfx allocates a full mip chain, even though we only fill
+     *          the first MIP_LEVELS.
+     */
+    static auto GPUBytes(const bgfx::TextureFormat::Enum eFormat) -> uint64_t
+    {
+        uint64_t rvo = 0;
+        for (int size = ATLAS_SIZE; size >= 1; size /= 2)
+        {
+            const int padded = IsBlockFormat(eFormat) ? std::max(size, BLOCK_SIZE) : size;
+            rvo += ImageBytes(eFormat, padded, padded);
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Check if a page was freed by ReleasePage, and can be reused
+     *        for anything.
+     */
+    static auto IsReleased(const page_s &cPage) -> bool
+    {
+        return cPage.qwUsedArea == 0 && !cPage.pPacker && !cPage.HasData() && !cPage.IsCompacting();
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Free everything a page holds, once every texture on it is gone.
+     *
+     * @details The page stays in the list so page indexes don't change.
+     */
+    auto ReleasePage(page_s &cPage) -> void
+    {
+        if (bgfx::isValid(cPage.cHandle))
+        {
+            bgfx::destroy(cPage.cHandle);
+            cPage.cHandle = BGFX_INVALID_HANDLE;
+        }
+        cPage.pPacker.reset();
+        cPage.ncPixels = {};
+        cPage.ncEncoded = {};
+        cPage.ncMapped = {};
+        cPage.ncDirty.clear();
+        cPage.bFullyDirty = true;
+        cPage.qwUsedArea = 0;
+        cPage.qwDeadArea = 0;
+        cPage.bEvicted = false;
+        m_cResidencyStats.qwReleasedPages += 1;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Take a page off the GPU.  It is uploaded again from memory the
+     *        next time one of its textures is used.
+     */
+    auto EvictGPU(page_s &cPage) -> void
+    {
+        bgfx::destroy(cPage.cHandle);
+        cPage.cHandle = BGFX_INVALID_HANDLE;
+        cPage.bFullyDirty = true;
+        cPage.bEvicted = true;
+        m_cResidencyStats.qwGPUEvictions += 1;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Drop the memory copy of a page that is fully on the GPU.
+     *
+     * @details Without its pixels, the page can't take new textures or be
+     *          compacted, so it is sealed for the rest of its life.
+     */
+    auto EvictCPU(page_s &cPage) -> void
+    {
+        cPage.pPacker.reset();
+        cPage.ncPixels = {};
+        cPage.ncEncoded = {};
+        cPage.ncMapped = {};
+        m_cResidencyStats.qwCPUEvictions += 1;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Evict least recently used pages until we are under budget.
+     *
+     * @details GPU eviction goes first, since it only picks pages that we
+     *          still have in memory, and CPU eviction only picks pages that
+     *          are still on the GPU.  Pages used in the last few frames are
+     *          never taken off the GPU, so we don't thrash.
+     */
+    auto EnforceBudget() -> void
+    {
+        uint64_t cpuBytes = m_qwTexturePixelBytes;
+        uint64_t gpuBytes = 0;
+        for (auto &page : m_npPages)
+        {
+            cpuBytes += page->CPUBytes();
+            if (bgfx::isValid(page->cHandle))
+            {
+                gpuBytes += GPUBytes(page->eFormat);
+            }
+        }
+
+        std::vector<size_t> order(m_npPages.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](const size_t a, const size_t b) {
+            return m_npPages[a]->qwLastUsed < m_npPages[b]->qwLastUsed;
+        });
+
+        for (const size_t i : order)
+        {
+            if (gpuBytes <= m_cBudget.qwGPUBytes)
+            {
+                break;
+            }
+            page_s &page = *m_npPages[i];
+            // Pages used this frame stay, even with qwIdleFrames at zero.
+            const bool recent = page.qwLastUsed + m_cBudget.qwIdleFrames > m_qwFrame || page.qwLastUsed == m_qwFrame;
+            if (!bgfx::isValid(page.cHandle) || !page.HasData() || recent)
+            {
+                continue;
+            }
+            EvictGPU(page);
+            gpuBytes -= GPUBytes(page.eFormat);
+        }
+
+        for (const size_t i : order)
+        {
+            if (cpuBytes <= m_cBudget.qwCPUBytes)
+            {
+                break;
+            }
+            page_s &page = *m_npPages[i];
+            if (!page.HasData() || !page.IsUploaded() || page.IsCompacting())
+            {
+                continue;
+            }
+            cpuBytes -= page.CPUBytes();
+            EvictCPU(page);
+        }
+
+        m_cResidencyStats.qwCPUBytes = cpuBytes;
+        m_cResidencyStats.qwGPUBytes = gpuBytes;
+        if (cpuBytes > m_cBudget.qwCPUBytes || gpuBytes > m_cBudget.qwGPUBytes)
+        {
+            m_cResidencyStats.qwOverBudget += 1;
+        }
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Hash everything that goes into baking an atlas.
+     *
+     * @param nstrAssetPaths Texture paths, in order.
+     * @param nqwContentHashes Hash of each texture file, or 0 if missing.
+     */
+    auto CacheKey(const std::vector<std::string_view> &nstrAssetPaths, const std::vector<uint64_t> &nqwContentHashes)
+        -> uint64_t
+    {
+        const uint32_t settings[] = {
+            CACHE_VERSION,
+            uint32_t(ATLAS_SIZE),
+            uint32_t(ATLAS_BPP),
+            uint32_t(m_cCompression.eOpaque),
+            uint32_t(m_cCompression.eAlpha),
+            uint32_t(m_cCompression.bHighQuality),
+        };
+        uint64_t key =
+            HashFNV1a64(nonstd::span<const uint8_t>(reinterpret_cast<const uint8_t *>(settings), sizeof(settings)));
+        key = HashFNV1a64(
+            nonstd::span<const uint8_t>(reinterpret_cast<const uint8_t *>(&m_qwPaletteHash), sizeof(uint64_t)), key);
+        for (size_t i = 0; i < nstrAssetPaths.size(); i++)
+        {
+            const auto &path = nstrAssetPaths[i];
+            key = HashFNV1a64(nonstd::span<const uint8_t>(reinterpret_cast<const uint8_t *>(path.data()), path.size()),
+                              key);
+            key = HashFNV1a64(
+                nonstd::span<const uint8_t>(reinterpret_cast<const uint8_t *>(&nqwContentHashes[i]), sizeof(uint64_t)),
+                key);
+        }
+        return key;
+    }
+
+    //**************************************************************************
+
+    static auto CachePath(const uint64_t qwKey) -> std::string
+    {
+        return fmt::format("{}atlas-{:016x}.r3dcache", GetPlatform().GetPrefPath(), qwKey);
+    }
+
+    //**************************************************************************
+
+    static auto CachePagePath(const uint64_t qwKey, const size_t qwPage) -> std::string
+    {
+        return fmt::format("{}atlas-{:016x}-{}.ktx", GetPlatform().GetPrefPath(), qwKey, qwPage);
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Map a page of the atlas cache.
+     *
+     * @return Views of every mip level in the GPU format, or nothing if the
+     *         file is missing or doesn't hold what we expect.
+     */
+    static auto LoadCachePage(const uint64_t qwKey, const size_t qwPage, const bgfx::TextureFormat::Enum eFormat)
+        -> std::optional<std::array<bufferView_s, MIP_LEVELS>>
+    {
+        auto maybeFile = GetPlatform().MapFile(CachePagePath(qwKey, qwPage));
+        if (!maybeFile.has_value())
+        {
+            return std::nullopt;
+        }
+        const bufferView_s &file = maybeFile.value();
+
+        bimg::ImageContainer container;
+        bx::Error err;
+        if (!bimg::imageParse(container, file.cSpan.data(), uint32_t(file.cSpan.size()), &err))
+        {
+            return std::nullopt;
+        }
+        if (container.m_format != bimg::TextureFormat::Enum(eFormat) || container.m_width != uint32_t(ATLAS_SIZE) ||
+            container.m_height != uint32_t(ATLAS_SIZE) || container.m_numMips != MIP_LEVELS)
+        {
+            return std::nullopt;
+        }
+
+        std::array<bufferView_s, MIP_LEVELS> rvo;
+        for (int level = 0; level < MIP_LEVELS; level++)
+        {
+            const int size = LevelSize(level);
+            bimg::ImageMip mip;
+            if (!bimg::imageGetRawData(container, 0, uint8_t(level), file.cSpan.data(), uint32_t(file.cSpan.size()),
+                                       mip) ||
+                mip.m_size != ImageBytes(eFormat, size, size))
+            {
+                return std::nullopt;
+            }
+
+            const size_t offset = size_t(mip.m_data - file.cSpan.data());
+            rvo[level] = bufferView_s{file.cSpan.subspan(offset, mip.m_size), file.pOwner};
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Try to load a previously baked atlas from the cache.
+     *
+     * @param qwKey Cache key of the atlas.
+     * @param nstrAssetPaths Paths of every texture we expect, in order.
+     * @return True if the atlas was loaded.  On failure, nothing is changed.
+     */
+    auto LoadCache(const uint64_t qwKey, const std::vector<std::string_view> &nstrAssetPaths) -> bool
+    {
+        auto maybeFile = GetPlatform().MapFile(CachePath(qwKey));
+        if (!maybeFile.has_value())
+        {
+            return false;
+        }
+        const nonstd::span<const uint8_t> data = maybeFile->cSpan;
+
+        cacheHeader_s header;
+        if (data.size() < sizeof(header))
+        {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.szMagic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.dwVersion != CACHE_VERSION ||
+            header.dwAtlasSize != uint32_t(ATLAS_SIZE) || header.qwKey != qwKey ||
+            header.dwTextures > nstrAssetPaths.size())
+        {
+            return false;
+        }
+        size_t pos = sizeof(header);
+
+        // Map every page first, since the pages are the bulk of the cache.
+        if ((data.size() - pos) / sizeof(cachePage_s) < header.dwPages)
+        {
+            return false;
+        }
+        std::vector<std::unique_ptr<page_s>> pages;
+        for (uint32_t i = 0; i < header.dwPages; i++)
+        {
+            cachePage_s entry;
+            std::memcpy(&entry, data.data() + pos, sizeof(entry));
+            pos += sizeof(entry);
+
+            const auto format = bgfx::TextureFormat::Enum(entry.dwFormat);
+            if (!IsAtlasFormat(format))
+            {
+                return false;
+            }
+            auto maybePage = LoadCachePage(qwKey, i, format);
+            if (!maybePage.has_value())
+            {
+                return false;
+            }
+
+            auto page = std::make_unique<page_s>();
+            page->bAlpha = entry.dwAlpha != 0;
+            page->eFormat = format;
+            page->ncMapped = std::move(maybePage.value());
+            pages.push_back(std::move(page));
+        }
+
+        // Read the texture table.  Missing or broken textures were left out
+        // when the cache was written, so the table is an ordered subset of
+        // the textures we asked for.
+        struct loaded_s
+        {
+            std::string_view strName;
+            size_t qwPage;
+            rect_s cRect;
+            glm::ivec2 cPixelSize;
+        };
+        std::vector<loaded_s> loaded;
+        size_t nextPath = 0;
+        for (uint32_t i = 0; i < header.dwTextures; i++)
+        {
+            cacheEntry_s entry;
+            if (data.size() - pos < sizeof(entry))
+            {
+                return false;
+            }
+            std::memcpy(&entry, data.data() + pos, sizeof(entry));
+            pos += sizeof(entry);
+
+            if (data.size() - pos < entry.dwNameLength)
+            {
+                return false;
+            }
+            const std::string_view name(reinterpret_cast<const char *>(data.data() + pos), entry.dwNameLength);
+            pos += entry.dwNameLength;
+
+            while (nextPath < nstrAssetPaths.size() && nstrAssetPaths[nextPath] != name)
+            {
+                nextPath += 1;
+            }
+            if (nextPath == nstrAssetPaths.size())
+            {
+                return false;
+            }
+            nextPath += 1;
+
+            const rect_s rect{entry.iX, entry.iY, entry.iW, entry.iH};
+            if (entry.dwPage >= header.dwPages || rect.x < 0 || rect.y < 0 || rect.w <= 0 || rect.h <= 0 ||
+                rect.x + rect.w > ATLAS_SIZE || rect.y + rect.h > ATLAS_SIZE || entry.iPixelW <= 0 ||
+                entry.iPixelW > rect.w || entry.iPixelH <= 0 || entry.iPixelH > rect.h)
+            {
+                return false;
+            }
+            loaded.push_back(loaded_s{name, size_t(entry.dwPage), rect, {entry.iPixelW, entry.iPixelH}});
+        }
+
+        // Everything checks out, so commit to it.
+        const size_t firstPage = m_npPages.size();
+        for (auto &page : pages)
+        {
+            m_npPages.push_back(std::move(page));
+        }
+
+        for (auto &entry : loaded)
+        {
+            texture_s &tex = AllocSlot(std::string(entry.strName));
+            tex.cInfo.cPixelSize = entry.cPixelSize;
+            SetAtlasRect(tex, firstPage + entry.qwPage, entry.cRect);
+            m_npPages[firstPage + entry.qwPage]->qwUsedArea += uint64_t(entry.cRect.w) * uint64_t(entry.cRect.h);
+        }
+
+        return true;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Write the current atlas to the cache.
+     *
+     * @details Pages are written as KTX files in their GPU format, so they
+     *          can be uploaded as-is and looked at with regular tools.  The
+     *          texture table goes last, so a cache is never found with
+     *          pages missing.
+     */
+    auto WriteCache(const uint64_t qwKey) -> bool
+    {
+        buffer_t file(sizeof(cacheHeader_s));
+        for (size_t i = 0; i < m_npPages.size(); i++)
+        {
+            const page_s &page = *m_npPages[i];
+            std::vector<nonstd::span<const uint8_t>> levels;
+            for (int level = 0; level < MIP_LEVELS; level++)
+            {
+                levels.push_back(page.Data(level));
+            }
+            const buffer_t ktx = WriteKTX(page.eFormat, ATLAS_SIZE, ATLAS_SIZE, levels);
+            if (!GetPlatform().WriteFileFromBuffer(CachePagePath(qwKey, i), ktx))
+            {
+                return false;
+            }
+
+            cachePage_s entry;
+            entry.dwFormat = uint32_t(page.eFormat);
+            entry.dwAlpha = page.bAlpha ? 1 : 0;
+
+            const uint8_t *entryBytes = reinterpret_cast<const uint8_t *>(&entry);
+            file.insert(file.end(), entryBytes, entryBytes + sizeof(entry));
+        }
+
+        uint32_t textures = 0;
+        for (auto &tex : m_ncTextures)
+        {
+            if (tex.bRemoved || tex.cInfo.qwPage == NO_PAGE)
+            {
+                continue;
+            }
+
+            cacheEntry_s entry;
+            entry.dwPage = uint32_t(tex.cInfo.qwPage);
+            entry.iX = tex.cRect.x;
+            entry.iY = tex.cRect.y;
+            entry.iW = tex.cRect.w;
+            entry.iH = tex.cRect.h;
+            entry.iPixelW = tex.cInfo.cPixelSize.x;
+            entry.iPixelH = tex.cInfo.cPixelSize.y;
+            entry.dwNameLength = uint32_t(tex.cInfo.strName.size());
+
+            const uint8_t *entryBytes = reinterpret_cast<const uint8_t *>(&entry);
+            file.insert(file.end(), entryBytes, entryBytes + sizeof(entry));
+            file.insert(file.end(), tex.cInfo.strName.begin(), tex.cInfo.strName.end());
+            textures += 1;
+        }
+
+        cacheHeader_s header;
+        std::memcpy(header.szMagic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.dwVersion = CACHE_VERSION;
+        header.dwAtlasSize = uint32_t(ATLAS_SIZE);
+        header.qwKey = qwKey;
+        header.dwPages = uint32_t(m_npPages.size());
+        header.dwTextures = textures;
+        std::memcpy(file.data(), &header, sizeof(header));
+
+        return GetPlatform().WriteFileFromBuffer(CachePath(qwKey), file);
+    }
+
+    //**************************************************************************
+
+  public:
+    ~TexturesImpl()
+    {
+        for (auto &page : m_npPages)
+        {
+            if (page->IsCompacting())
+            {
+                page->cCompaction.wait();
+            }
+            if (bgfx::isValid(page->cHandle))
+            {
+                bgfx::destroy(page->cHandle);
+            }
+        }
+
+        if (bgfx::isValid(m_cPaletteHandle))
+        {
+            bgfx::destroy(m_cPaletteHandle);
+        }
+        if (bgfx::isValid(m_cColormapHandle))
+        {
+            bgfx::destroy(m_cColormapHandle);
+        }
+    }
+
+    //**************************************************************************
+
+    auto SetCompression(const compression_s &cCompression) -> bool override
+    {
+        if (!m_npPages.empty() || m_pQuantizer || !IsAtlasFormat(cCompression.eOpaque) ||
+            !IsAtlasFormat(cCompression.eAlpha) || cCompression.eOpaque == bgfx::TextureFormat::R8 ||
+            cCompression.eAlpha == bgfx::TextureFormat::R8)
+        {
+            return false;
+        }
+        m_cCompression = cCompression;
+        return true;
+    }
+
+    //**************************************************************************
+
+    auto SetPalette(const palette_s &cPalette) -> bool override
+    {
+        if (!m_npPages.empty() || !m_ncTextures.empty() || cPalette.nPalette.size() != PALETTE_SIZE * 3 ||
+            cPalette.nColormap.size() % PALETTE_SIZE != 0 || cPalette.iTransparent >= int(PALETTE_SIZE))
+        {
+            return false;
+        }
+
+        auto quantizer = std::make_shared<quantizer_s>();
+        quantizer->iTransparent = cPalette.iTransparent < 0 ? -1 : cPalette.iTransparent;
+        m_cPaletteRGBA.resize(PALETTE_SIZE * 4);
+        for (size_t i = 0; i < PALETTE_SIZE; i++)
+        {
+            const uint8_t *rgb = &cPalette.nPalette[i * 3];
+            const bool transparent = int(i) == quantizer->iTransparent;
+            quantizer->ncColors[i] = {rgb[0], rgb[1], rgb[2]};
+            if (!transparent)
+            {
+                // If a color shows up twice, the first index wins.
+                const uint32_t key = uint32_t(rgb[0]) | (uint32_t(rgb[1]) << 8) | (uint32_t(rgb[2]) << 16);
+                quantizer->cExact.emplace(key, uint8_t(i));
+            }
+
+            m_cPaletteRGBA[(i * 4) + 0] = rgb[0];
+            m_cPaletteRGBA[(i * 4) + 1] = rgb[1];
+            m_cPaletteRGBA[(i * 4) + 2] = rgb[2];
+            m_cPaletteRGBA[(i * 4) + 3] = transparent ? 0x00 : 0xFF;
+        }
+
+        if (cPalette.nColormap.empty())
+        {
+            m_cColormap = BuildColormap(*quantizer, DEFAULT_LIGHT_LEVELS);
+        }
+        else
+        {
+            m_cColormap.assign(cPalette.nColormap.begin(), cPalette.nColormap.end());
+        }
+
+        const int32_t transparent = quantizer->iTransparent;
+        m_qwPaletteHash = HashFNV1a64(cPalette.nPalette);
+        m_qwPaletteHash = HashFNV1a64(
+            nonstd::span<const uint8_t>(reinterpret_cast<const uint8_t *>(&transparent), sizeof(transparent)),
+            m_qwPaletteHash);
+
+        m_pQuantizer = std::move(quantizer);
+        m_cCompression = compression_s{};
+        m_cCompression.eOpaque = bgfx::TextureFormat::R8;
+        m_cCompression.eAlpha = bgfx::TextureFormat::R8;
+        return true;
+    }
+
+    //**************************************************************************
+
+    auto SetBudget(const budget_s &cBudget) -> void override
+    {
+        m_cBudget = cBudget;
+    }
+
+    //**************************************************************************
+
+    auto AddAsset(const std::string_view strAssetPath) -> bool override
+    {
+        auto it = m_cTextureNames.find(std::string(strAssetPath));
+        if (it != m_cTextureNames.end())
+        {
+            m_ncTextures[it->second].qwRefs += 1;
+            return true;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        auto maybeDecoded = IsPrefetched(strAssetPath) ? TakePrefetched(strAssetPath)
+                                                       : DecodeAsset(strAssetPath, m_pQuantizer.get());
+        if (!maybeDecoded.has_value())
+        {
+            return false;
+        }
+        Register(strAssetPath, std::move(maybeDecoded.value()));
+        m_cLoadStats.qwWallUS += MicrosecondsSince(start);
+
+        if (m_bBaked)
+        {
+            return PackPending();
+        }
+        return true;
+    }
+
+    //**************************************************************************
+
+    auto AddAssets(const nonstd::span<const std::string_view> nstrAssetPaths) -> bool override
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        // Skip duplicates in the batch, and only add a reference to
+        // anything we already have.
+        std::vector<std::string_view> paths;
+        std::unordered_set<std::string_view> seen;
+        for (auto &path : nstrAssetPaths)
+        {
+            if (!seen.insert(path).second)
+            {
+                continue;
+            }
+            auto it = m_cTextureNames.find(std::string(path));
+            if (it != m_cTextureNames.end())
+            {
+                m_ncTextures[it->second].qwRefs += 1;
+                continue;
+            }
+            paths.push_back(path);
+        }
+
+        // Read everything that wasn't prefetched in one batch, then decode
+        // in parallel.  Prefetched textures have been decoding all along,
+        // so they are picked up last.
+        std::vector<size_t> unfetched;
+        std::vector<std::string_view> unfetchedPaths;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (!IsPrefetched(paths[i]))
+            {
+                unfetched.push_back(i);
+                unfetchedPaths.push_back(paths[i]);
+            }
+        }
+
+        auto files = rock3d::GetAssets().ReadToViews(unfetchedPaths);
+        std::vector<std::optional<decoded_s>> decoded(paths.size());
+        const quantizer_s *quantizer = m_pQuantizer.get();
+        GetWorkers().ParallelFor(unfetched.size(), [&files, &decoded, &unfetched, quantizer](const size_t i) {
+            if (files[i].has_value())
+            {
+                decoded[unfetched[i]] = DecodeBuffer(files[i]->cSpan, quantizer);
+            }
+        });
+
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (IsPrefetched(paths[i]))
+            {
+                decoded[i] = TakePrefetched(paths[i]);
+            }
+        }
+
+        // Register in the order we were given.
+        bool ok = true;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (!decoded[i].has_value())
+            {
+                ok = false;
+                continue;
+            }
+            Register(paths[i], std::move(decoded[i].value()));
+        }
+        m_cLoadStats.qwWallUS += MicrosecondsSince(start);
+
+        if (m_bBaked)
+        {
+            ok = PackPending() && ok;
+        }
+        return ok;
+    }
+
+    //**************************************************************************
+
+    auto Prefetch(const nonstd::span<const std::string_view> nstrAssetPaths) -> void override
+    {
+        std::vector<std::string> paths;
+        auto promises = std::make_shared<std::vector<std::promise<std::optional<decoded_s>>>>();
+        for (auto &path : nstrAssetPaths)
+        {
+            std::string key(path);
+            if (m_cTextureNames.count(key) != 0 || m_cPrefetched.count(key) != 0)
+            {
+                continue;
+            }
+            promises->emplace_back();
+            m_cPrefetched.emplace(key, prefetch_s{m_pQuantizer, promises->back().get_future()});
+            paths.push_back(std::move(key));
+        }
+        if (paths.empty())
+        {
+            return;
+        }
+
+        GetWorkers().Submit([paths, promises, quantizer = m_pQuantizer] {
+            const std::vector<std::string_view> views(paths.begin(), paths.end());
+            auto files = rock3d::GetAssets().ReadToViews(views);
+            GetWorkers().ParallelFor(paths.size(), [&files, &promises, &quantizer](const size_t i) {
+                std::optional<decoded_s> decoded;
+                if (files[i].has_value())
+                {
+                    decoded = DecodeBuffer(files[i]->cSpan, quantizer.get());
+                }
+                (*promises)[i].set_value(std::move(decoded));
+            });
+        });
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Check if a texture was prefetched for the current palette.
+     *        Prefetches for an old palette are thrown away.
+     */
+    auto IsPrefetched(const std::string_view strAssetPath) -> bool
+    {
+        auto it = m_cPrefetched.find(std::string(strAssetPath));
+        if (it == m_cPrefetched.end())
+        {
+            return false;
+        }
+        if (it->second.pQuantizer != m_pQuantizer)
+        {
+            m_cPrefetched.erase(it);
+            return false;
+        }
+        return true;
+    }
+
+    //**************************************************************************
+
+    /**
+     * @brief Wait for a prefetched texture to finish decoding, and take it.
+     */
+    auto TakePrefetched(const std::string_view strAssetPath) -> std::optional<decoded_s>
+    {
+        auto it = m_cPrefetched.find(std::string(strAssetPath));
+        if (it == m_cPrefetched.end())
+        {
+            return std::nullopt;
+        }
+
+        std::optional<decoded_s> rvo = it->second.cDecoded.get();
+        m_cPrefetched.erase(it);
+        if (rvo.has_value())
+        {
+            m_cLoadStats.qwPrefetched += 1;
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto BakeAtlasCached(const nonstd::span<const std::string_view> nstrAssetPaths) -> bool override
+    {
+        if (m_bBaked || !m_ncTextures.empty())
+        {
+            // The cache only holds whole atlases.
+            return AddAssets(nstrAssetPaths) && BakeAtlas();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::string_view> paths;
+        std::unordered_set<std::string_view> seen;
+        for (auto &path : nstrAssetPaths)
+        {
+            if (seen.insert(path).second)
+            {
+                paths.push_back(path);
+            }
+        }
+
+        // We have to read everything to know if the cache is still good,
+        // but that is much cheaper than decoding and packing.
+        auto files = rock3d::GetAssets().ReadToViews(paths);
+        std::vector<uint64_t> hashes(paths.size(), 0);
+        GetWorkers().ParallelFor(paths.size(), [&files, &hashes](const size_t i) {
+            if (files[i].has_value())
+            {
+                hashes[i] = HashFNV1a64(files[i]->cSpan);
+            }
+        });
+
+        bool ok = true;
+        std::vector<std::string_view> readable;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (!files[i].has_value())
+            {
+                ok = false;
+                continue;
+            }
+            m_cLoadStats.qwFileBytes += files[i]->cSpan.size();
+            readable.push_back(paths[i]);
+        }
+
+        const uint64_t key = CacheKey(paths, hashes);
+        if (LoadCache(key, readable))
+        {
+            m_bBaked = true;
+            m_cLoadStats.qwCacheHits += 1;
+            for (auto &path : paths)
+            {
+                // Nothing left to decode.
+                m_cPrefetched.erase(std::string(path));
+            }
+            m_cLoadStats.qwWallUS += MicrosecondsSince(start);
+            return ok && m_ncTextures.size() == readable.size();
+        }
+        m_cLoadStats.qwCacheMisses += 1;
+
+        std::vector<bool> prefetched(paths.size());
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            prefetched[i] = IsPrefetched(paths[i]);
+        }
+
+        std::vector<std::optional<decoded_s>> decoded(paths.size());
+        const quantizer_s *quantizer = m_pQuantizer.get();
+        GetWorkers().ParallelFor(paths.size(), [&files, &decoded, &prefetched, quantizer](const size_t i) {
+            if (!prefetched[i] && files[i].has_value())
+            {
+                decoded[i] = DecodeBuffer(files[i]->cSpan, quantizer);
+            }
+        });
+
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (prefetched[i])
+            {
+                decoded[i] = TakePrefetched(paths[i]);
+            }
+            if (!decoded[i].has_value())
+            {
+                ok = false;
+                continue;
+            }
+            decoded[i]->qwFileBytes = 0; // Already counted.
+            Register(paths[i], std::move(decoded[i].value()));
+        }
+        m_cLoadStats.qwWallUS += MicrosecondsSince(start);
+
+        ok = BakeAtlas() && ok;
+        WriteCache(key);
+        return ok;
+    }
+
+    //**************************************************************************
+
+    auto Reload(const nonstd::span<const std::string_view> nstrAssetPaths) -> size_t override
+    {
+        std::vector<std::string> paths;
+        auto promises = std::make_shared<std::vector<std::promise<std::optional<decoded_s>>>>();
+        for (auto &path : nstrAssetPaths)
+        {
+            std::string key(path);
+            m_cPrefetched.erase(key); // Decoded from the old file.
+            auto it = m_cTextureNames.find(key);
+            if (it == m_cTextureNames.end())
+            {
+                continue;
+            }
+
+            // Replaces a reload of an older version that hasn't landed yet.
+            promises->emplace_back();
+            m_cReloads[it->second] = promises->back().get_future();
+            paths.push_back(std::move(key));
+        }
+        if (paths.empty())
+        {
+            return 0;
+        }
+
+        GetWorkers().Submit([paths, promises, quantizer = m_pQuantizer] {
+            const std::vector<std::string_view> views(paths.begin(), paths.end());
+            auto files = rock3d::GetAssets().ReadToViews(views);
+            GetWorkers().ParallelFor(paths.size(), [&files, &promises, &quantizer](const size_t i) {
+                std::optional<decoded_s> decoded;
+                if (files[i].has_value())
+                {
+                    decoded = DecodeBuffer(files[i]->cSpan, quantizer.get());
+                }
+                (*promises)[i].set_value(std::move(decoded));
+            });
+        });
+        return paths.size();
+    }
+
+    //**************************************************************************
+
+    auto Remove(const std::string_view strAssetPath) -> bool override
+    {
+        auto it = m_cTextureNames.find(std::string(strAssetPath));
+        if (it == m_cTextureNames.end())
+        {
+            return false;
+        }
+
+        auto &tex = m_ncTextures[it->second];
+        if (tex.qwRefs > 1)
+        {
+            tex.qwRefs -= 1;
+            return true;
+        }
+
+        if (tex.cInfo.qwPage != NO_PAGE)
+        {
+            page_s &page = *m_npPages[tex.cInfo.qwPage];
+            page.qwDeadArea += uint64_t(tex.cRect.w) * uint64_t(tex.cRect.h);
+        }
+
+        FreeSlot(it->second);
+        return true;
+    }
+
+    //**************************************************************************
+
+    auto BakeAtlas() -> bool override
+    {
+        m_bBaked = true;
+        return PackPending();
+    }
+
+    //**************************************************************************
+
+    auto ToGPU() -> void override
+    {
+        UploadPalette();
+        ApplyReloads();
+
+        for (size_t i = 0; i < m_npPages.size(); i++)
+        {
+            page_s &page = *m_npPages[i];
+            if (page.IsCompacting() &&
+                page.cCompaction.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                FinishCompaction(i);
+            }
+
+            if (!page.IsCompacting() && page.qwUsedArea > 0 && page.qwDeadArea == page.qwUsedArea)
+            {
+                ReleasePage(page);
+                continue;
+            }
+
+            // Evicted pages only come back once something needs them.
+            const bool wanted = !page.bEvicted || page.qwLastUsed == m_qwFrame;
+            if (wanted && (page.bFullyDirty || !page.ncDirty.empty()) && !IsReleased(page))
+            {
+                if (page.bEvicted)
+                {
+                    page.bEvicted = false;
+                    m_cResidencyStats.qwReuploads += 1;
+                }
+                UploadPage(page);
+            }
+
+            MaybeStartCompaction(i);
+        }
+
+        EnforceBudget();
+        m_qwFrame += 1;
+    }
+
+    //**************************************************************************
+
+    auto MarkUsed(const size_t qwID) -> void override
+    {
+        const texInfo_s *info = FindByID(qwID);
+        if (info == nullptr || info->qwPage == NO_PAGE)
+        {
+            return;
+        }
+        MarkPageUsed(info->qwPage);
+    }
+
+    //**************************************************************************
+
+    auto MarkPageUsed(const size_t qwPage) -> void override
+    {
+        if (qwPage >= m_npPages.size())
+        {
+            return;
+        }
+        m_npPages[qwPage]->qwLastUsed = m_qwFrame;
+    }
+
+    //**************************************************************************
+
+    auto PageCount() -> size_t override
+    {
+        return m_npPages.size();
+    }
+
+    //**************************************************************************
+
+    auto PageHandle(const size_t qwPage) -> bgfx::TextureHandle override
+    {
+        if (qwPage >= m_npPages.size())
+        {
+            return BGFX_INVALID_HANDLE;
+        }
+        return m_npPages[qwPage]->cHandle;
+    }
+
+    //**************************************************************************
+
+    auto PageSize() -> size_t override
+    {
+        return size_t(ATLAS_SIZE);
+    }
+
+    //**************************************************************************
+
+    auto MipLevels() -> size_t override
+    {
+        return size_t(MIP_LEVELS);
+    }
+
+    //**************************************************************************
+
+    auto SampleReference(const size_t qwID, const glm::vec2 &cTexCoord, const float fLod)
+        -> std::optional<glm::u8vec4> override
+    {
+        const texInfo_s *info = FindByID(qwID);
+        if (info == nullptr || info->qwPage == NO_PAGE)
+        {
+            return std::nullopt;
+        }
+        const page_s &page = *m_npPages[info->qwPage];
+        if (!page.HasData())
+        {
+            return std::nullopt;
+        }
+
+        // Same as the world shaders: scale into the atlas, then wrap around
+        // inside the texture.
+        const glm::vec2 origin = info->cAtlasMin;
+        const glm::vec2 len = info->cAtlasMax - info->cAtlasMin;
+        glm::vec2 coord = (cTexCoord * len) + origin;
+        for (int i = 0; i < 2; i++)
+        {
+            const float offset = coord[i] - origin[i];
+            coord[i] = offset - (len[i] * std::floor(offset / len[i])) + origin[i];
+        }
+
+        // Nearest mip level, picked the way GL picks it for point sampling.
+        const int level = std::min(fLod <= 0.5f ? 0 : int(std::ceil(fLod + 0.5f)) - 1, MIP_LEVELS - 1);
+        const int size = LevelSize(level);
+        const int x = glm::clamp(int(std::floor(coord.x * float(size))), 0, size - 1);
+        const int y = glm::clamp(int(std::floor(coord.y * float(size))), 0, size - 1);
+
+        const uint8_t *pixels = page.Pixels(level);
+        if (pixels == nullptr)
+        {
+            // Only compressed data, so decompress the block we landed in.
+            const int bx = x / BLOCK_SIZE * BLOCK_SIZE;
+            const int by = y / BLOCK_SIZE * BLOCK_SIZE;
+            const buffer_t block = DecodeImage(page.Data(level).data() + BlockOffset(page.eFormat, level, bx, by),
+                                               BLOCK_SIZE, BLOCK_SIZE, page.eFormat);
+            const uint8_t *texel = &block[size_t(((y - by) * BLOCK_SIZE) + (x - bx)) * ATLAS_BPP];
+            return glm::u8vec4{texel[0], texel[1], texel[2], texel[3]};
+        }
+
+        const int bpp = PixelBytes(page.eFormat);
+        const size_t offset = (size_t(y) * size_t(PagePitch(page.eFormat, level))) + (size_t(x) * size_t(bpp));
+        const uint8_t *texel = pixels + offset;
+        if (page.eFormat == bgfx::TextureFormat::R8)
+        {
+            texel = &m_cPaletteRGBA[size_t(*texel) * 4];
+        }
+        return glm::u8vec4{texel[0], texel[1], texel[2], texel[3]};
+    }
+
+    //**************************************************************************
+
+    auto IsPaletted() -> bool override
+    {
+        return m_pQuantizer != nullptr;
+    }
+
+    //**************************************************************************
+
+    auto PaletteHandle() -> bgfx::TextureHandle override
+    {
+        return m_cPaletteHandle;
+    }
+
+    //**************************************************************************
+
+    auto ColormapHandle() -> bgfx::TextureHandle override
+    {
+        return m_cColormapHandle;
+    }
+
+    //**************************************************************************
+
+    auto ColormapLevels() -> size_t override
+    {
+        return m_cColormap.size() / PALETTE_SIZE;
+    }
+
+    //**************************************************************************
+
+    auto TransparentIndex() -> int override
+    {
+        return m_pQuantizer ? m_pQuantizer->iTransparent : -1;
+    }
+
+    //**************************************************************************
+
+    auto AtlasGeneration() -> uint64_t override
+    {
+        return m_qwGeneration;
+    }
+
+    //**************************************************************************
+
+    auto LoadStats() -> const loadStats_s & override
+    {
+        return m_cLoadStats;
+    }
+
+    //**************************************************************************
+
+    auto ResidencyStats() -> const residencyStats_s & override
+    {
+        return m_cResidencyStats;
+    }
 
     //**************************************************************************
 
     auto FindByID(const size_t qwID) -> const texInfo_s * override
     {
-        if (qwID >= m_ncTextures.size())
+        const size_t slot = IDSlot(qwID);
+        if (slot >= m_ncTextures.size() || m_ncTextures[slot].bRemoved || m_ncTextures[slot].cInfo.qwID != qwID)
         {
             return nullptr;
         }
-        return &m_ncTextures[qwID].cInfo;
+        return &m_ncTextures[slot].cInfo;
     }
 
     //**************************************************************************
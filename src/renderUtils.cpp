@@ -12,37 +12,75 @@
 namespace rock3d
 {
 
-auto ShaderCompileProgram(const std::string_view strShaderDir) -> bgfx::ProgramHandle
+auto ViewToMemory(const bufferView_s &cView) -> const bgfx::Memory *
+{
+    // bgfx holds on to the owner until it is done with the memory.
+    auto *owner = new std::shared_ptr<const void>(cView.pOwner);
+    return bgfx::makeRef(
+        cView.cSpan.data(), uint32_t(cView.cSpan.size()),
+        [](void *, void *pUserData) { delete static_cast<std::shared_ptr<const void> *>(pUserData); }, owner);
+}
+
+auto ShaderProgramFiles(const std::string_view strShaderDir) -> std::array<std::string, 2>
 {
-    std::string prefix{"shaders/spirv15-12/"};
     std::string shaderDir(strShaderDir);
     std::replace(shaderDir.begin(), shaderDir.end(), '/', '_');
 
-    std::string vertFile = fmt::format("{}{}_vert.sc.bin", prefix, shaderDir);
-    const auto maybeVert = rock3d::GetAssets().ReadToBuffer(vertFile);
+    const std::string_view prefix = "shaders/spirv15-12/";
+    return {fmt::format("{}{}_vert.sc.bin", prefix, shaderDir), fmt::format("{}{}_frag.sc.bin", prefix, shaderDir)};
+}
+
+auto ShaderTryCompileProgram(const std::string_view strShaderDir) -> shaderResult_t
+{
+    const auto files = ShaderProgramFiles(strShaderDir);
+
+    const auto maybeVert = rock3d::GetAssets().ReadToView(files[0]);
     if (!maybeVert.has_value())
     {
-        rock3d::GetPlatform().FatalError(fmt::format("Missing shader file: {}", vertFile));
+        return nonstd::make_unexpected(fmt::format("Missing shader file: {}", files[0]));
     }
 
-    std::string fragFile = fmt::format("{}{}_frag.sc.bin", prefix, shaderDir);
-    const auto maybeFrag = rock3d::GetAssets().ReadToBuffer(fragFile);
+    const auto maybeFrag = rock3d::GetAssets().ReadToView(files[1]);
     if (!maybeFrag.has_value())
     {
-        rock3d::GetPlatform().FatalError(fmt::format("Missing shader file: {}", fragFile));
+        return nonstd::make_unexpected(fmt::format("Missing shader file: {}", files[1]));
     }
 
     // [LM] AFAICT, these are freed by bgfx and there's no standalone free function.
-    const bgfx::Memory *vert = bgfx::copy(maybeVert.value().data(), maybeVert.value().size());
-    const bgfx::Memory *frag = bgfx::copy(maybeFrag.value().data(), maybeFrag.value().size());
+    const bgfx::Memory *vert = ViewToMemory(maybeVert.value());
+    const bgfx::Memory *frag = ViewToMemory(maybeFrag.value());
 
-    bgfx::RendererType::Enum type = bgfx::getRendererType();
-    bgfx::ProgramHandle handle = bgfx::createProgram(bgfx::createShader(vert), bgfx::createShader(frag), true);
+    bgfx::ShaderHandle vertShader = bgfx::createShader(vert);
+    bgfx::ShaderHandle fragShader = bgfx::createShader(frag);
+    if (!bgfx::isValid(vertShader) || !bgfx::isValid(fragShader))
+    {
+        if (bgfx::isValid(vertShader))
+        {
+            bgfx::destroy(vertShader);
+        }
+        if (bgfx::isValid(fragShader))
+        {
+            bgfx::destroy(fragShader);
+        }
+        return nonstd::make_unexpected(fmt::format("Could not compile shader: {}", strShaderDir));
+    }
+
+    bgfx::ProgramHandle handle = bgfx::createProgram(vertShader, fragShader, true);
     if (handle.idx == bgfx::kInvalidHandle)
     {
-        rock3d::GetPlatform().FatalError(fmt::format("Could not compile shader: {}", strShaderDir));
+        return nonstd::make_unexpected(fmt::format("Could not compile shader: {}", strShaderDir));
     }
     return handle;
 }
 
+auto ShaderCompileProgram(const std::string_view strShaderDir) -> bgfx::ProgramHandle
+{
+    auto maybeProgram = ShaderTryCompileProgram(strShaderDir);
+    if (!maybeProgram.has_value())
+    {
+        rock3d::GetPlatform().FatalError(maybeProgram.error());
+    }
+    return maybeProgram.value();
+}
+
 } // namespace rock3d
@@ -0,0 +1,95 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief bgfx setup shared by every platform.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include "bgfx/platform.h"
+
+#include "render_thread.h"
+
+namespace rock3d
+{
+
+//******************************************************************************
+
+RenderThread::~RenderThread()
+{
+    // Exiting without shutting down, after a fatal error.  The thread is
+    // stuck inside bgfx, so leave it be rather than take the process down.
+    if (m_cThread.joinable())
+    {
+        m_cThread.detach();
+    }
+}
+
+//******************************************************************************
+
+auto RenderThread::Join() -> void
+{
+    m_bQuit = true;
+    if (m_cThread.joinable())
+    {
+        m_cThread.join();
+    }
+}
+
+//******************************************************************************
+
+auto RenderThread::Init(const bgfx::Init &cInit, const bool bThreaded) -> bool
+{
+    if (!bThreaded)
+    {
+        // Calling this before bgfx::init stops bgfx from making a render
+        // thread, and since we never call it again, bgfx::frame renders.
+        bgfx::renderFrame();
+        return bgfx::init(cInit);
+    }
+
+    // bgfx takes whichever thread calls this before bgfx::init to be the
+    // render thread, so the thread has to get there before we go on.
+    std::promise<void> started;
+    m_bQuit = false;
+    m_cThread = std::thread([this, &started] {
+        bgfx::renderFrame();
+        started.set_value();
+
+        while (!m_bQuit.load())
+        {
+            const bgfx::RenderFrame::Enum result = bgfx::renderFrame();
+            if (result == bgfx::RenderFrame::Exiting)
+            {
+                return;
+            }
+            if (result == bgfx::RenderFrame::NoContext)
+            {
+                // bgfx::init hasn't gotten far enough yet.
+                std::this_thread::yield();
+            }
+        }
+    });
+    started.get_future().wait();
+
+    if (!bgfx::init(cInit))
+    {
+        Join();
+        return false;
+    }
+    return true;
+}
+
+//******************************************************************************
+
+auto RenderThread::Shutdown() -> void
+{
+    // The render thread sees the shutdown and leaves on its own.
+    bgfx::shutdown();
+    Join();
+}
+
+} // namespace rock3d
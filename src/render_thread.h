@@ -0,0 +1,55 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief bgfx setup shared by every platform.
+ */
+
+#pragma once
+
+namespace rock3d
+{
+
+/**
+ * @brief Runs bgfx's renderer on a thread of our own.
+ *
+ * @details The thread that initializes bgfx builds command buffers, and
+ *          the render thread hands them to the GPU.  bgfx::frame is where
+ *          the two meet: it waits for the render thread to finish the last
+ *          frame, then hands over the one that was just built.  While the
+ *          render thread draws it, the main thread can get on with ticking
+ *          and building the next one, so a frame takes as long as the
+ *          slower of the two instead of both added together.
+ */
+class RenderThread final
+{
+    std::thread m_cThread;
+    std::atomic<bool> m_bQuit = false;
+
+    auto Join() -> void;
+
+  public:
+    RenderThread() {}
+    ~RenderThread();
+    ROCK3D_NOCOPY(RenderThread);
+
+    /**
+     * @brief Initialize bgfx.  The calling thread becomes the one that
+     *        submits to bgfx.
+     *
+     * @param cInit Settings to initialize bgfx with.
+     * @param bThreaded False to render on the calling thread from inside
+     *                  bgfx::frame instead, which is easier to debug.
+     * @return True if bgfx initialized.
+     */
+    auto Init(const bgfx::Init &cInit, const bool bThreaded) -> bool;
+
+    /**
+     * @brief Shut bgfx down, and wait for the render thread to finish.
+     */
+    auto Shutdown() -> void;
+};
+
+} // namespace rock3d
@@ -0,0 +1,137 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+#include "rock3d/rock3d.h"
+
+#include "SDL2/SDL.h"
+
+#include "sdl_events.h"
+
+namespace rock3d
+{
+
+/**
+ * @brief Convert an SDL scancode to our keyboardScan_e enum.
+ */
+static auto SDLScanToRock(const SDL_Scancode eScan) -> keyboardScan_e
+{
+    return keyboardScan_e(eScan);
+}
+
+/**
+ * @brief Convert an SDL scancode to our keyboardScan_e enum.
+ */
+static auto SDLKeyToRock(const SDL_Keycode eKey) -> keyboardKey_e
+{
+    return keyboardKey_e(eKey);
+}
+
+/**
+ * @brief Convert a SDL mouse button to our mouseButton_e enum.
+ */
+static auto SDLMBtnToRock(const Uint8 button) -> mouseButton_e
+{
+    switch (button)
+    {
+    case SDL_BUTTON_LEFT:
+        return MBTN_LEFT;
+    case SDL_BUTTON_MIDDLE:
+        return MBTN_MIDDLE; // Unlike SDL, we use 3 for middle.
+    case SDL_BUTTON_RIGHT:
+        return MBTN_RIGHT; // Unlike SDL, we use 2 for right.
+    case SDL_BUTTON_X1:
+        return MBTN_X1;
+    case SDL_BUTTON_X2:
+        return MBTN_X2;
+    }
+    return MBTN_NONE;
+}
+
+/**
+ * @brief Convert an SDL gamepad axis to our padAxis_e enum.
+ */
+static auto SDLPadAxisToRock(const SDL_GameControllerAxis eAxis) -> padAxis_e
+{
+    return padAxis_e(eAxis);
+}
+
+/**
+ * @brief Convert an SDL gamepad button to our padButton_e enum.
+ */
+static auto SDLPadButtonToRock(const SDL_GameControllerButton eButton) -> padButton_e
+{
+    return padButton_e(eButton);
+}
+
+//******************************************************************************
+
+auto SDLPumpEvents() -> void
+{
+    SDL_Event ev;
+    while (SDL_PollEvent(&ev))
+    {
+        switch (ev.type)
+        {
+        case SDL_KEYDOWN:
+            [[fallthrough]];
+        case SDL_KEYUP: {
+            event_t rockEv = eventKey_s{
+                SDLScanToRock(ev.key.keysym.scancode),
+                SDLKeyToRock(ev.key.keysym.sym),
+                ev.type == SDL_KEYDOWN,
+            };
+            GetEventQueue().Queue(std::move(rockEv));
+            break;
+        }
+        case SDL_MOUSEMOTION: {
+            event_t rockEv = eventMouseMotion_s{
+                glm::ivec2{ev.motion.x, ev.motion.y},
+                glm::ivec2{ev.motion.xrel, ev.motion.yrel},
+            };
+            GetEventQueue().Queue(std::move(rockEv));
+            break;
+        }
+        case SDL_MOUSEBUTTONDOWN:
+            [[fallthrough]];
+        case SDL_MOUSEBUTTONUP: {
+            event_t rockEv = eventMouseButton_s{
+                glm::ivec2{ev.button.x, ev.button.y},
+                SDLMBtnToRock(ev.button.button),
+                ev.button.state == SDL_PRESSED,
+            };
+            GetEventQueue().Queue(std::move(rockEv));
+            break;
+        }
+        case SDL_MOUSEWHEEL:
+            break;
+        case SDL_CONTROLLERAXISMOTION: {
+            event_t rockEv = eventPadAxis_s{ev.caxis.axis, ev.caxis.value};
+            GetEventQueue().Queue(std::move(rockEv));
+            break;
+        }
+        case SDL_CONTROLLERBUTTONDOWN:
+            [[fallthrough]];
+        case SDL_CONTROLLERBUTTONUP: {
+            event_t rockEv = eventPadButton_s{ev.cbutton.button, ev.type == SDL_CONTROLLERBUTTONDOWN};
+            GetEventQueue().Queue(std::move(rockEv));
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+//******************************************************************************
+
+auto SDLWaitEvents(const uint32_t dwTimeoutMS) -> bool
+{
+    // Passing no event leaves it on SDL's queue for SDLPumpEvents.  Window
+    // events we don't translate still wake us, so an exposed or resized
+    // window gets redrawn.
+    return SDL_WaitEventTimeout(nullptr, int(dwTimeoutMS)) != 0;
+}
+
+} // namespace rock3d
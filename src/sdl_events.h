@@ -0,0 +1,28 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Event handling shared by every platform that is built on SDL.
+ */
+
+#pragma once
+
+namespace rock3d
+{
+
+/**
+ * @brief Translate every pending SDL event into our own events, and put
+ *        them on the event queue.
+ */
+auto SDLPumpEvents() -> void;
+
+/**
+ * @brief Sleep until SDL has an event, or the timeout passes.
+ *
+ * @return True if an event is waiting.
+ */
+auto SDLWaitEvents(const uint32_t dwTimeoutMS) -> bool;
+
+} // namespace rock3d
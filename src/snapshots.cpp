@@ -0,0 +1,232 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Double-buffered renderable state, for drawing between ticks.
+ */
+
+#include "rock3d/rock3d.h"
+
+namespace rock3d
+{
+
+//******************************************************************************
+
+class SnapshotsImpl final : public Snapshots
+{
+    state_s m_cPrevious;
+    state_s m_cCurrent;
+    state_s m_cBlended;
+    float m_fAlpha = 0.0f;
+    bool m_bCutAll = false;
+
+    /**
+     * @brief Make room for a slot in the current state.
+     */
+    auto GrowEntities(const size_t qwSlot) -> void
+    {
+        if (qwSlot < m_cCurrent.nbLive.size())
+        {
+            return;
+        }
+        m_cCurrent.ncPositions.resize(qwSlot + 1);
+        m_cCurrent.ncRotations.resize(qwSlot + 1);
+        m_cCurrent.ndwCuts.resize(qwSlot + 1, 0);
+        m_cCurrent.nbLive.resize(qwSlot + 1, 0);
+    }
+
+  public:
+    auto SetCamera(const glm::vec3 &cPosition, const glm::quat &cRotation) -> void override
+    {
+        m_cCurrent.cCamera = camera_s{cPosition, cRotation};
+    }
+
+    //**************************************************************************
+
+    auto CutCamera() -> void override
+    {
+        m_cCurrent.dwCameraCut += 1;
+    }
+
+    //**************************************************************************
+
+    auto SetEntity(const size_t qwSlot, const glm::vec3 &cPosition, const glm::quat &cRotation) -> void override
+    {
+        GrowEntities(qwSlot);
+        if (m_cCurrent.nbLive[qwSlot] == 0)
+        {
+            // A new entity in an old slot, don't blend from the last one.
+            m_cCurrent.ndwCuts[qwSlot] += 1;
+            m_cCurrent.nbLive[qwSlot] = 1;
+        }
+        m_cCurrent.ncPositions[qwSlot] = cPosition;
+        m_cCurrent.ncRotations[qwSlot] = cRotation;
+    }
+
+    //**************************************************************************
+
+    auto CutEntity(const size_t qwSlot) -> void override
+    {
+        if (qwSlot < m_cCurrent.ndwCuts.size())
+        {
+            m_cCurrent.ndwCuts[qwSlot] += 1;
+        }
+    }
+
+    //**************************************************************************
+
+    auto RemoveEntity(const size_t qwSlot) -> void override
+    {
+        if (qwSlot < m_cCurrent.nbLive.size())
+        {
+            m_cCurrent.nbLive[qwSlot] = 0;
+        }
+    }
+
+    //**************************************************************************
+
+    auto SetPolygon(const size_t qwPolygon, const float fFloorHeight, const float fCeilHeight) -> void override
+    {
+        if (qwPolygon >= m_cCurrent.nfFloorHeights.size())
+        {
+            m_cCurrent.nfFloorHeights.resize(qwPolygon + 1, 0.0f);
+            m_cCurrent.nfCeilHeights.resize(qwPolygon + 1, 0.0f);
+        }
+        m_cCurrent.nfFloorHeights[qwPolygon] = fFloorHeight;
+        m_cCurrent.nfCeilHeights[qwPolygon] = fCeilHeight;
+    }
+
+    //**************************************************************************
+
+    auto CutAll() -> void override
+    {
+        m_bCutAll = true;
+    }
+
+    //**************************************************************************
+
+    auto Clear() -> void override
+    {
+        const camera_s camera = m_cCurrent.cCamera;
+        m_cCurrent = state_s{};
+        m_cCurrent.cCamera = camera;
+        m_bCutAll = true;
+    }
+
+    //**************************************************************************
+
+    auto Advance() -> void override
+    {
+        // Assigning reuses the previous state's arrays, so this doesn't
+        // allocate once the game has settled.
+        m_cPrevious = m_cCurrent;
+        m_bCutAll = false;
+    }
+
+    //**************************************************************************
+
+    auto Blend(const float fAlpha) -> void override
+    {
+        m_fAlpha = fAlpha;
+        if (m_bCutAll)
+        {
+            m_cBlended = m_cCurrent;
+            return;
+        }
+
+        const state_s &prev = m_cPrevious;
+        const state_s &cur = m_cCurrent;
+        state_s &out = m_cBlended;
+
+        out.dwCameraCut = cur.dwCameraCut;
+        if (prev.dwCameraCut == cur.dwCameraCut)
+        {
+            out.cCamera.cPosition = glm::mix(prev.cCamera.cPosition, cur.cCamera.cPosition, fAlpha);
+            out.cCamera.cRotation = glm::slerp(prev.cCamera.cRotation, cur.cCamera.cRotation, fAlpha);
+        }
+        else
+        {
+            out.cCamera = cur.cCamera;
+        }
+
+        // Entities that are new, removed or cut this tick are drawn where
+        // they are now.
+        const size_t slots = cur.nbLive.size();
+        const size_t both = std::min(slots, prev.nbLive.size());
+        out.ncPositions.resize(slots);
+        out.ncRotations.resize(slots);
+        out.ndwCuts.assign(cur.ndwCuts.begin(), cur.ndwCuts.end());
+        out.nbLive.assign(cur.nbLive.begin(), cur.nbLive.end());
+        for (size_t i = 0; i < both; i++)
+        {
+            const bool blend = prev.nbLive[i] != 0 && cur.nbLive[i] != 0 && prev.ndwCuts[i] == cur.ndwCuts[i];
+            out.ncPositions[i] =
+                blend ? glm::mix(prev.ncPositions[i], cur.ncPositions[i], fAlpha) : cur.ncPositions[i];
+        }
+        for (size_t i = 0; i < both; i++)
+        {
+            const bool blend = prev.nbLive[i] != 0 && cur.nbLive[i] != 0 && prev.ndwCuts[i] == cur.ndwCuts[i];
+            out.ncRotations[i] =
+                blend ? glm::slerp(prev.ncRotations[i], cur.ncRotations[i], fAlpha) : cur.ncRotations[i];
+        }
+        std::copy(cur.ncPositions.begin() + both, cur.ncPositions.end(), out.ncPositions.begin() + both);
+        std::copy(cur.ncRotations.begin() + both, cur.ncRotations.end(), out.ncRotations.begin() + both);
+
+        const size_t polygons = cur.nfFloorHeights.size();
+        const size_t oldPolygons = std::min(polygons, prev.nfFloorHeights.size());
+        out.nfFloorHeights.resize(polygons);
+        out.nfCeilHeights.resize(polygons);
+        for (size_t i = 0; i < oldPolygons; i++)
+        {
+            out.nfFloorHeights[i] = glm::mix(prev.nfFloorHeights[i], cur.nfFloorHeights[i], fAlpha);
+        }
+        for (size_t i = 0; i < oldPolygons; i++)
+        {
+            out.nfCeilHeights[i] = glm::mix(prev.nfCeilHeights[i], cur.nfCeilHeights[i], fAlpha);
+        }
+        std::copy(cur.nfFloorHeights.begin() + oldPolygons, cur.nfFloorHeights.end(),
+                  out.nfFloorHeights.begin() + oldPolygons);
+        std::copy(cur.nfCeilHeights.begin() + oldPolygons, cur.nfCeilHeights.end(),
+                  out.nfCeilHeights.begin() + oldPolygons);
+    }
+
+    //**************************************************************************
+
+    auto Previous() -> const state_s & override
+    {
+        return m_cPrevious;
+    }
+
+    //**************************************************************************
+
+    auto Current() -> const state_s & override
+    {
+        return m_cCurrent;
+    }
+
+    //**************************************************************************
+
+    auto Blended() -> const state_s & override
+    {
+        return m_cBlended;
+    }
+
+    //**************************************************************************
+
+    auto Alpha() -> float override
+    {
+        return m_fAlpha;
+    }
+};
+
+//******************************************************************************
+
+auto GetSnapshots() -> Snapshots &
+{
+    static SnapshotsImpl snapshots;
+    return snapshots;
+}
+
+} // namespace rock3d
@@ -0,0 +1,414 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Worker thread pool, with a work-stealing queue per worker.
+ */
+
+#include "rock3d/rock3d.h"
+
+namespace rock3d
+{
+
+//******************************************************************************
+
+struct Workers::counter_s
+{
+    std::atomic<size_t> qwPending{0};
+    std::mutex cMutex;
+    std::vector<std::function<void()>> nfnWaiting; // Queues jobs that were waiting on this counter.
+};
+
+//******************************************************************************
+
+class WorkersImpl final : public Workers
+{
+    struct job_s
+    {
+        task_t fnTask;
+        counter_t cDone;
+    };
+
+    struct queue_s
+    {
+        std::mutex cMutex;
+        std::deque<job_s> ncJobs;
+    };
+
+    /**
+     * @brief Index of the queue the current thread owns, or -1 if it isn't
+     *        a worker.
+     */
+    static thread_local int t_iWorker;
+
+    std::vector<std::thread> m_ncThreads;
+    std::vector<std::unique_ptr<queue_s>> m_ncQueues;
+    std::atomic<size_t> m_qwNextQueue{0};
+    std::atomic<size_t> m_qwQueued{0}; // Jobs sitting in a worker queue.
+
+    std::mutex m_cMainMutex;
+    std::deque<job_s> m_ncMainJobs;
+    std::atomic<size_t> m_qwMainQueued{0};
+    std::thread::id m_cMainThread;
+
+    std::mutex m_cWakeMutex;
+    std::condition_variable m_cWake;
+    bool m_bQuit = false;
+
+    /**
+     * @brief Wake up anyone sleeping in WorkerLoop or Wait.
+     */
+    auto WakeAll() -> void
+    {
+        // Taking the lock means a thread that just checked for work is now
+        // asleep, so it can't miss this.
+        {
+            std::lock_guard<std::mutex> lock(m_cWakeMutex);
+        }
+        m_cWake.notify_all();
+    }
+
+    auto Enqueue(job_s &&cJob) -> void
+    {
+        // Workers keep their own jobs, everyone else deals them out.
+        const size_t index = t_iWorker >= 0 ? size_t(t_iWorker) : m_qwNextQueue.fetch_add(1) % m_ncQueues.size();
+        queue_s &queue = *m_ncQueues[index];
+        {
+            std::lock_guard<std::mutex> lock(queue.cMutex);
+            queue.ncJobs.push_back(std::move(cJob));
+            m_qwQueued.fetch_add(1);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_cWakeMutex);
+        }
+        m_cWake.notify_one();
+    }
+
+    auto EnqueueMain(job_s &&cJob) -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_cMainMutex);
+            m_ncMainJobs.push_back(std::move(cJob));
+            m_qwMainQueued.fetch_add(1);
+        }
+
+        // The main thread might be asleep in Wait.
+        WakeAll();
+    }
+
+    /**
+     * @brief Queue a job once cAfter reaches zero, or right away if it
+     *        already has.
+     */
+    auto EnqueueAfter(const counter_t &cAfter, std::function<void()> &&fnEnqueue) -> void
+    {
+        if (cAfter != nullptr && cAfter->qwPending.load() != 0)
+        {
+            std::lock_guard<std::mutex> lock(cAfter->cMutex);
+            if (cAfter->qwPending.load() != 0)
+            {
+                cAfter->nfnWaiting.push_back(std::move(fnEnqueue));
+                return;
+            }
+        }
+        fnEnqueue();
+    }
+
+    /**
+     * @brief Take a job, from the back of our own queue if we have one, or
+     *        from the front of somebody else's.
+     */
+    auto TryPop(job_s &cOutJob) -> bool
+    {
+        if (m_qwQueued.load() == 0)
+        {
+            return false;
+        }
+
+        const size_t count = m_ncQueues.size();
+        if (t_iWorker >= 0)
+        {
+            queue_s &queue = *m_ncQueues[size_t(t_iWorker)];
+            std::lock_guard<std::mutex> lock(queue.cMutex);
+            if (!queue.ncJobs.empty())
+            {
+                cOutJob = std::move(queue.ncJobs.back());
+                queue.ncJobs.pop_back();
+                m_qwQueued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // Start at our neighbor, so thieves don't all pile onto queue 0.
+        const size_t start = t_iWorker >= 0 ? size_t(t_iWorker) + 1 : 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            queue_s &queue = *m_ncQueues[(start + i) % count];
+            std::lock_guard<std::mutex> lock(queue.cMutex);
+            if (!queue.ncJobs.empty())
+            {
+                cOutJob = std::move(queue.ncJobs.front());
+                queue.ncJobs.pop_front();
+                m_qwQueued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto TryPopMain(job_s &cOutJob) -> bool
+    {
+        if (m_qwMainQueued.load() == 0)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_cMainMutex);
+        if (m_ncMainJobs.empty())
+        {
+            return false;
+        }
+        cOutJob = std::move(m_ncMainJobs.front());
+        m_ncMainJobs.pop_front();
+        m_qwMainQueued.fetch_sub(1);
+        return true;
+    }
+
+    /**
+     * @brief Run a job, then count it as done.  The last job of a group
+     *        lets go of every job that was waiting on the group.
+     */
+    auto Run(job_s &cJob) -> void
+    {
+        cJob.fnTask();
+        cJob.fnTask = nullptr;
+        if (cJob.cDone == nullptr)
+        {
+            return;
+        }
+
+        counter_s &done = *cJob.cDone;
+        if (done.qwPending.fetch_sub(1) != 1)
+        {
+            return;
+        }
+
+        std::vector<std::function<void()>> waiting;
+        {
+            std::lock_guard<std::mutex> lock(done.cMutex);
+            waiting.swap(done.nfnWaiting);
+        }
+        for (auto &enqueue : waiting)
+        {
+            enqueue();
+        }
+        WakeAll();
+    }
+
+    auto WorkerLoop(const int iWorker) -> void
+    {
+        t_iWorker = iWorker;
+        for (;;)
+        {
+            job_s job;
+            if (TryPop(job))
+            {
+                Run(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_cWakeMutex);
+            m_cWake.wait(lock, [this] { return m_bQuit || m_qwQueued.load() != 0; });
+            if (m_bQuit && m_qwQueued.load() == 0)
+            {
+                return;
+            }
+        }
+    }
+
+  public:
+    WorkersImpl() : m_cMainThread(std::this_thread::get_id())
+    {
+        // Leave a core for the main thread.
+        const size_t cores = std::thread::hardware_concurrency();
+        const size_t count = cores > 1 ? cores - 1 : 1;
+        for (size_t i = 0; i < count; i++)
+        {
+            m_ncQueues.push_back(std::make_unique<queue_s>());
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            m_ncThreads.emplace_back([this, i] { WorkerLoop(int(i)); });
+        }
+    }
+
+    ~WorkersImpl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_cWakeMutex);
+            m_bQuit = true;
+        }
+        m_cWake.notify_all();
+        for (auto &thread : m_ncThreads)
+        {
+            thread.join();
+        }
+    }
+
+    //**************************************************************************
+
+    auto ThreadCount() -> size_t override
+    {
+        return m_ncThreads.size();
+    }
+
+    //**************************************************************************
+
+    auto Submit(task_t &&fnTask) -> void override
+    {
+        Enqueue(job_s{std::move(fnTask), nullptr});
+    }
+
+    //**************************************************************************
+
+    auto MakeCounter() -> counter_t override
+    {
+        return std::make_shared<counter_s>();
+    }
+
+    //**************************************************************************
+
+    auto Submit(task_t &&fnTask, const counter_t &cAfter, const counter_t &cDone) -> void override
+    {
+        if (cDone != nullptr)
+        {
+            cDone->qwPending.fetch_add(1);
+        }
+
+        auto job = std::make_shared<job_s>(job_s{std::move(fnTask), cDone});
+        EnqueueAfter(cAfter, [this, job] { Enqueue(std::move(*job)); });
+    }
+
+    //**************************************************************************
+
+    auto SubmitMain(task_t &&fnTask, const counter_t &cAfter, const counter_t &cDone) -> void override
+    {
+        if (cDone != nullptr)
+        {
+            cDone->qwPending.fetch_add(1);
+        }
+
+        auto job = std::make_shared<job_s>(job_s{std::move(fnTask), cDone});
+        EnqueueAfter(cAfter, [this, job] { EnqueueMain(std::move(*job)); });
+    }
+
+    //**************************************************************************
+
+    auto RunMainJobs() -> size_t override
+    {
+        // Jobs queued by the jobs we run wait for the next call, so a job
+        // that requeues itself can't keep us here forever.
+        size_t rvo = 0;
+        for (size_t queued = m_qwMainQueued.load(); rvo < queued; rvo++)
+        {
+            job_s job;
+            if (!TryPopMain(job))
+            {
+                break;
+            }
+            Run(job);
+        }
+        return rvo;
+    }
+
+    //**************************************************************************
+
+    auto IsDone(const counter_t &cCounter) -> bool override
+    {
+        return cCounter->qwPending.load() == 0;
+    }
+
+    //**************************************************************************
+
+    auto Wait(const counter_t &cCounter) -> void override
+    {
+        const bool isMain = std::this_thread::get_id() == m_cMainThread;
+        while (cCounter->qwPending.load() != 0)
+        {
+            job_s job;
+            if ((isMain && TryPopMain(job)) || TryPop(job))
+            {
+                Run(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_cWakeMutex);
+            m_cWake.wait(lock, [this, &cCounter, isMain] {
+                return cCounter->qwPending.load() == 0 || m_qwQueued.load() != 0 ||
+                       (isMain && m_qwMainQueued.load() != 0);
+            });
+        }
+    }
+
+    //**************************************************************************
+
+    auto ParallelFor(const size_t qwCount, const std::function<void(size_t)> &fnFunc) -> void override
+    {
+        if (qwCount == 0)
+        {
+            return;
+        }
+
+        struct state_s
+        {
+            std::atomic<size_t> qwNext{0};
+            std::atomic<size_t> qwDone{0};
+            std::mutex cMutex;
+            std::condition_variable cFinished;
+        };
+        auto state = std::make_shared<state_s>();
+
+        // Grab indexes until there are none left.  Helpers that start after
+        // everything is handed out return right away.
+        auto drain = [state, qwCount, &fnFunc] {
+            for (;;)
+            {
+                const size_t index = state->qwNext.fetch_add(1);
+                if (index >= qwCount)
+                {
+                    return;
+                }
+                fnFunc(index);
+                if (state->qwDone.fetch_add(1) + 1 == qwCount)
+                {
+                    std::lock_guard<std::mutex> lock(state->cMutex);
+                    state->cFinished.notify_all();
+                }
+            }
+        };
+
+        const size_t helpers = std::min(qwCount - 1, ThreadCount());
+        for (size_t i = 0; i < helpers; i++)
+        {
+            Submit(drain);
+        }
+        drain();
+
+        std::unique_lock<std::mutex> lock(state->cMutex);
+        state->cFinished.wait(lock, [&state, qwCount] { return state->qwDone.load() == qwCount; });
+    }
+};
+
+thread_local int WorkersImpl::t_iWorker = -1;
+
+//******************************************************************************
+
+auto GetWorkers() -> Workers &
+{
+    static WorkersImpl workers;
+    return workers;
+}
+
+} // namespace rock3d
@@ -82,6 +82,14 @@ def build_shaders() -> None:
             ROOT_DIR / "src" / "r3d" / "shaders" / "world" / "frag.sc",
             ShaderType.fragment,
         ),
+        Shader(
+            ROOT_DIR / "src" / "r3d" / "shaders" / "worldPaletted" / "vert.sc",
+            ShaderType.vertex,
+        ),
+        Shader(
+            ROOT_DIR / "src" / "r3d" / "shaders" / "worldPaletted" / "frag.sc",
+            ShaderType.fragment,
+        ),
         Shader(
             ROOT_DIR / "rocked" / "shaders" / "imgui" / "vert.sc", ShaderType.vertex
         ),
@@ -0,0 +1,222 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Check the texture atlas against textures with known texels.
+ *
+ * @details Usage: r3datlascheck
+ *
+ *          A few textures are written to a temporary directory, baked
+ *          into an atlas, and sampled with Textures::SampleReference at
+ *          the edges of their tiles, wrapped around past both edges, on
+ *          every mip level.  Every sample is compared against the texel
+ *          it should land on, with mip levels worked out by box filtering
+ *          the texture.  Returns nonzero if any sample is wrong.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+struct image_s
+{
+    int iW = 0;
+    int iH = 0;
+    std::vector<glm::u8vec4> ncTexels;
+
+    auto At(const int iX, const int iY) const -> const glm::u8vec4 &
+    {
+        return ncTexels[size_t(iY) * size_t(iW) + size_t(iX)];
+    }
+};
+
+/**
+ * @brief A texture of noise, so every texel is different from its
+ *        neighbours and averages don't come out even by accident.
+ */
+static auto MakeImage(const int iW, const int iH, const int iSeed) -> image_s
+{
+    image_s rvo{iW, iH, {}};
+    for (int y = 0; y < iH; y++)
+    {
+        for (int x = 0; x < iW; x++)
+        {
+            const uint32_t hash = (uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^ (uint32_t(iSeed) * 83492791u);
+            const uint32_t mixed = hash * 2654435761u;
+            rvo.ncTexels.push_back(glm::u8vec4{uint8_t(mixed >> 24), uint8_t(mixed >> 16), uint8_t(mixed >> 8), 0xFF});
+        }
+    }
+    return rvo;
+}
+
+/**
+ * @brief Average 2x2 texels, rounding the same way the atlas does.
+ */
+static auto Downsample(const image_s &cImage) -> image_s
+{
+    image_s rvo{cImage.iW / 2, cImage.iH / 2, {}};
+    for (int y = 0; y < rvo.iH; y++)
+    {
+        for (int x = 0; x < rvo.iW; x++)
+        {
+            glm::u8vec4 texel;
+            for (int c = 0; c < 4; c++)
+            {
+                const int sum = cImage.At(x * 2, y * 2)[c] + cImage.At(x * 2 + 1, y * 2)[c] +
+                                cImage.At(x * 2, y * 2 + 1)[c] + cImage.At(x * 2 + 1, y * 2 + 1)[c];
+                texel[c] = uint8_t((sum + 2) / 4);
+            }
+            rvo.ncTexels.push_back(texel);
+        }
+    }
+    return rvo;
+}
+
+/**
+ * @brief Write an RGBA8 texture as a KTX 1.1 file.
+ */
+static auto WriteKTX(const fs::path &cPath, const image_s &cImage) -> bool
+{
+    static constexpr uint8_t KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+    const uint32_t header[] = {
+        0x04030201,          // endianness
+        0x1401,              // glType, GL_UNSIGNED_BYTE
+        1,                   // glTypeSize
+        0x1908,              // glFormat, GL_RGBA
+        0x8058,              // glInternalFormat, GL_RGBA8
+        0x1908,              // glBaseInternalFormat, GL_RGBA
+        uint32_t(cImage.iW), // pixelWidth
+        uint32_t(cImage.iH), // pixelHeight
+        0,                   // pixelDepth
+        0,                   // numberOfArrayElements
+        1,                   // numberOfFaces
+        1,                   // numberOfMipmapLevels
+        0,                   // bytesOfKeyValueData
+    };
+    const uint32_t imageSize = uint32_t(cImage.ncTexels.size() * sizeof(glm::u8vec4));
+
+    std::ofstream file(cPath, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(KTX_IDENTIFIER), sizeof(KTX_IDENTIFIER));
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(&imageSize), sizeof(imageSize));
+    file.write(reinterpret_cast<const char *>(cImage.ncTexels.data()), std::streamsize(imageSize));
+    return bool(file);
+}
+
+int main()
+{
+    struct check_s
+    {
+        const char *szName;
+        int iW;
+        int iH;
+        bool bMips; // Only sizes that halve evenly line up with their tiles on every level.
+    };
+    static constexpr check_s CHECKS[] = {
+        {"square.ktx", 16, 16, true},
+        {"wide.ktx", 64, 8, true},
+        {"tall.ktx", 24, 40, true},
+        {"odd.ktx", 5, 3, false},
+    };
+
+    const fs::path dir = fs::temp_directory_path() / "r3datlascheck";
+    fs::create_directories(dir);
+    auto removeDir = nonstd::make_scope_exit([&dir] {
+        std::error_code error;
+        fs::remove_all(dir, error);
+    });
+
+    std::vector<image_s> images;
+    std::vector<std::string_view> names;
+    for (const check_s &check : CHECKS)
+    {
+        images.push_back(MakeImage(check.iW, check.iH, int(images.size()) + 1));
+        names.push_back(check.szName);
+        if (!WriteKTX(dir / check.szName, images.back()))
+        {
+            std::cerr << "r3datlascheck: could not write " << (dir / check.szName).string() << "\n";
+            return 1;
+        }
+    }
+
+    rock3d::GetAssets().AddPath(dir.string());
+    auto textures = rock3d::r3D::Textures::Alloc();
+    if (!textures->AddAssets(names) || !textures->BakeAtlas())
+    {
+        std::cerr << "r3datlascheck: could not bake the atlas\n";
+        return 1;
+    }
+
+    // Centers of the first and last texel along one axis, in this repeat
+    // of the texture and a few others, so samples land on both edges of
+    // the tile from both sides of a wrap.
+    struct axis_s
+    {
+        int iRepeat;
+        bool bLast;
+    };
+    static constexpr axis_s AXIS[] = {
+        {0, false}, {0, true}, {-1, true}, {1, false}, {3, true}, {-4, false},
+    };
+    auto texelIndex = [](const axis_s &cAxis, const int iSize) { return cAxis.bLast ? iSize - 1 : 0; };
+    auto texCoord = [&texelIndex](const axis_s &cAxis, const int iSize) {
+        return float(cAxis.iRepeat) + ((float(texelIndex(cAxis, iSize)) + 0.5f) / float(iSize));
+    };
+
+    size_t samples = 0;
+    size_t failures = 0;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        const rock3d::r3D::Textures::texInfo_s *info = textures->FindByName(names[i]);
+        if (info == nullptr)
+        {
+            std::cerr << "r3datlascheck: " << names[i] << " is not in the atlas\n";
+            return 1;
+        }
+
+        const size_t levels = CHECKS[i].bMips ? textures->MipLevels() : 1;
+        image_s level = images[i];
+        for (size_t lod = 0; lod < levels; lod++)
+        {
+            if (lod > 0)
+            {
+                level = Downsample(level);
+            }
+            for (const axis_s &u : AXIS)
+            {
+                for (const axis_s &v : AXIS)
+                {
+                    const glm::vec2 coord{texCoord(u, level.iW), texCoord(v, level.iH)};
+                    const glm::u8vec4 expected = level.At(texelIndex(u, level.iW), texelIndex(v, level.iH));
+                    const auto maybeTexel = textures->SampleReference(info->qwID, coord, float(lod));
+                    samples += 1;
+                    if (maybeTexel.has_value() && maybeTexel.value() == expected)
+                    {
+                        continue;
+                    }
+
+                    failures += 1;
+                    std::cerr << names[i] << " lod " << lod << " at (" << coord.x << ", " << coord.y << "): ";
+                    if (!maybeTexel.has_value())
+                    {
+                        std::cerr << "no sample\n";
+                        continue;
+                    }
+                    const glm::u8vec4 got = maybeTexel.value();
+                    std::cerr << "got " << int(got.r) << " " << int(got.g) << " " << int(got.b) << " " << int(got.a)
+                              << ", expected " << int(expected.r) << " " << int(expected.g) << " " << int(expected.b)
+                              << " " << int(expected.a) << "\n";
+                }
+            }
+        }
+    }
+
+    std::cout << "r3datlascheck: " << (samples - failures) << " of " << samples << " samples correct\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Measure the overhead and scaling of the worker pool.
+ *
+ * @details Usage: r3djobbench [jobs]
+ *
+ *          Overhead is timed with jobs that do nothing, so it is the cost
+ *          of scheduling alone.  Scaling is timed by splitting a fixed
+ *          amount of arithmetic into more and more jobs, up to one for
+ *          every worker plus the main thread.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include <iostream>
+
+template <typename FUNC>
+static auto TimeMS(const FUNC &fnFunc) -> double
+{
+    const auto start = std::chrono::steady_clock::now();
+    fnFunc();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Something to keep a core busy that the compiler can't skip.
+ */
+static auto Crunch(const nonstd::span<float> nValues) -> void
+{
+    for (float &value : nValues)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            value = std::sqrt(value * value + 1.0f);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t jobs = argc > 1 ? size_t(std::max(1, std::atoi(argv[1]))) : 100000;
+    rock3d::Workers &workers = rock3d::GetWorkers();
+    std::cout << "r3djobbench: " << workers.ThreadCount() << " workers\n";
+
+    // Empty jobs submitted from the main thread, which deals them out.
+    {
+        auto counter = workers.MakeCounter();
+        const double ms = TimeMS([&] {
+            for (size_t i = 0; i < jobs; i++)
+            {
+                workers.Submit([] {}, nullptr, counter);
+            }
+            workers.Wait(counter);
+        });
+        std::cout << "submit from main:   " << (ms * 1e6 / double(jobs)) << " ns/job\n";
+    }
+
+    // Empty jobs submitted from a worker, which go on its own queue and
+    // have to be stolen by the others.
+    {
+        auto counter = workers.MakeCounter();
+        const double ms = TimeMS([&] {
+            workers.Submit(
+                [&] {
+                    for (size_t i = 0; i < jobs; i++)
+                    {
+                        workers.Submit([] {}, nullptr, counter);
+                    }
+                },
+                nullptr, counter);
+            workers.Wait(counter);
+        });
+        std::cout << "submit from worker: " << (ms * 1e6 / double(jobs)) << " ns/job\n";
+    }
+
+    // A chain where every job waits on the one before it, so nothing runs
+    // in parallel and all we see is the latency of a dependency.
+    {
+        const size_t links = std::min<size_t>(jobs, 10000);
+        std::vector<rock3d::Workers::counter_t> counters;
+        for (size_t i = 0; i < links; i++)
+        {
+            counters.push_back(workers.MakeCounter());
+        }
+        const double ms = TimeMS([&] {
+            for (size_t i = 0; i < links; i++)
+            {
+                workers.Submit([] {}, i > 0 ? counters[i - 1] : nullptr, counters[i]);
+            }
+            workers.Wait(counters.back());
+        });
+        std::cout << "dependency chain:   " << (ms * 1e6 / double(links)) << " ns/link\n";
+    }
+
+    // Main thread jobs, queued from workers.
+    {
+        auto counter = workers.MakeCounter();
+        const double ms = TimeMS([&] {
+            workers.ParallelFor(jobs, [&](const size_t) { workers.SubmitMain([] {}, nullptr, counter); });
+            workers.Wait(counter);
+        });
+        std::cout << "main thread jobs:   " << (ms * 1e6 / double(jobs)) << " ns/job\n";
+    }
+
+    // ParallelFor with one index per thread, so the cost is waking
+    // everybody up and waiting for them.
+    {
+        const size_t calls = std::min<size_t>(jobs, 10000);
+        const double ms = TimeMS([&] {
+            for (size_t i = 0; i < calls; i++)
+            {
+                workers.ParallelFor(workers.ThreadCount() + 1, [](const size_t) {});
+            }
+        });
+        std::cout << "parallel for:       " << (ms * 1e3 / double(calls)) << " us/call\n";
+    }
+
+    // The same work split into more and more jobs.
+    std::vector<float> values(1 << 20, 1.0f);
+    const nonstd::span<float> all(values);
+    double serialMS = 0.0;
+    for (size_t split = 1; split <= workers.ThreadCount() + 1; split++)
+    {
+        const size_t chunk = (all.size() + split - 1) / split;
+        const double ms = TimeMS([&] {
+            auto counter = workers.MakeCounter();
+            for (size_t start = 0; start < all.size(); start += chunk)
+            {
+                const auto part = all.subspan(start, std::min(chunk, all.size() - start));
+                workers.Submit([part] { Crunch(part); }, nullptr, counter);
+            }
+            workers.Wait(counter);
+        });
+        serialMS = split == 1 ? ms : serialMS;
+        std::cout << "scaling " << split << " jobs: " << ms << " ms, " << (serialMS / ms) << "x\n";
+    }
+
+    const double spanMS = TimeMS([&] { workers.ParallelFor(all, 0, Crunch); });
+    std::cout << "parallel for span:  " << spanMS << " ms, " << (serialMS / spanMS) << "x\n";
+    return 0;
+}
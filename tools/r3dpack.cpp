@@ -0,0 +1,158 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Build a pack archive out of a tree of assets.
+ *
+ * @details Usage: r3dpack [--compress] <assets directory> <output file>
+ *
+ *          Every file under the directory becomes an entry, named by its
+ *          path relative to the directory with forward slashes, which is
+ *          the same path the game asks for.
+ *
+ *          With --compress, every entry is compressed with LZ4, except ones
+ *          that barely shrink, like images that are already compressed.
+ *
+ *          Every level under map/ gets a dependency manifest, unless the
+ *          directory already has one for it.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+static auto ReadFile(const fs::path &cPath) -> std::optional<rock3d::buffer_t>
+{
+    std::ifstream file(cPath, std::ios::binary);
+    if (!file)
+    {
+        return std::nullopt;
+    }
+
+    rock3d::buffer_t rvo(size_t(fs::file_size(cPath)));
+    if (!file.read(reinterpret_cast<char *>(rvo.data()), std::streamsize(rvo.size())))
+    {
+        return std::nullopt;
+    }
+    return rvo;
+}
+
+static auto StartsWith(const std::string_view strString, const std::string_view strPrefix) -> bool
+{
+    return strString.substr(0, strPrefix.size()) == strPrefix;
+}
+
+static auto EndsWith(const std::string_view strString, const std::string_view strSuffix) -> bool
+{
+    return strString.size() >= strSuffix.size() && strString.substr(strString.size() - strSuffix.size()) == strSuffix;
+}
+
+int main(int argc, char *argv[])
+{
+    const bool compress = argc == 4 && std::string_view(argv[1]) == "--compress";
+    if (argc != 3 && !compress)
+    {
+        std::cerr << "usage: r3dpack [--compress] <assets directory> <output file>\n";
+        return 1;
+    }
+
+    const fs::path root = argv[argc - 2];
+    const fs::path output = argv[argc - 1];
+
+    std::error_code error;
+    std::vector<rock3d::Pack::entry_s> entries;
+    uint64_t bytes = 0;
+    for (auto it = fs::recursive_directory_iterator(root, error); it != fs::recursive_directory_iterator();
+         it.increment(error))
+    {
+        if (error)
+        {
+            break;
+        }
+        if (!it->is_regular_file())
+        {
+            continue;
+        }
+
+        auto maybeData = ReadFile(it->path());
+        if (!maybeData.has_value())
+        {
+            std::cerr << "r3dpack: could not read " << it->path().string() << "\n";
+            return 1;
+        }
+
+        rock3d::Pack::entry_s entry;
+        entry.strPath = fs::relative(it->path(), root).generic_string();
+        entry.cData = std::move(maybeData.value());
+        entry.bCompress = compress;
+        bytes += entry.cData.size();
+        entries.push_back(std::move(entry));
+    }
+    if (error)
+    {
+        std::cerr << "r3dpack: could not list " << root.string() << ": " << error.message() << "\n";
+        return 1;
+    }
+
+    // Levels only list their textures, so a hand-written manifest that
+    // also lists sprites and sounds wins over a generated one.
+    std::unordered_set<std::string> paths;
+    for (auto &entry : entries)
+    {
+        paths.insert(entry.strPath);
+    }
+    const size_t packed = entries.size();
+    for (size_t i = 0; i < packed; i++)
+    {
+        const std::string &path = entries[i].strPath;
+        const std::string manifestPath = rock3d::LevelManifestPath(path);
+        if (!StartsWith(path, "map/") || !EndsWith(path, ".json") || EndsWith(path, ".deps.json") ||
+            paths.count(manifestPath) != 0)
+        {
+            continue;
+        }
+
+        auto maybeManifest = rock3d::BuildLevelManifest(entries[i].cData);
+        if (!maybeManifest.has_value())
+        {
+            std::cerr << "r3dpack: could not parse level " << path << "\n";
+            return 1;
+        }
+
+        const std::string manifest = rock3d::SerializeLevelManifest(maybeManifest.value());
+        rock3d::Pack::entry_s entry;
+        entry.strPath = manifestPath;
+        entry.cData.assign(manifest.begin(), manifest.end());
+        entry.bCompress = compress;
+        entries.push_back(std::move(entry));
+    }
+
+    const rock3d::buffer_t pack = rock3d::Pack::Build(entries);
+
+    // Written under a temporary name, so the game never sees half a pack.
+    const fs::path temp = fs::path(output).concat(".tmp");
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char *>(pack.data()), std::streamsize(pack.size())))
+        {
+            std::cerr << "r3dpack: could not write " << temp.string() << "\n";
+            return 1;
+        }
+    }
+    fs::rename(temp, output, error);
+    if (error)
+    {
+        std::cerr << "r3dpack: could not write " << output.string() << ": " << error.message() << "\n";
+        return 1;
+    }
+
+    std::cout << "r3dpack: packed " << entries.size() << " files, " << bytes << " bytes of data into "
+              << pack.size() << " bytes\n";
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * rock3d.cpp: A 3D game engine for making retro FPS games
+ * Copyright (C) 2018 Lexi Mayfield <alexmax2742@gmail.com>
+ */
+
+/**
+ * @brief Compare batched io_uring reads against plain read() on Linux.
+ *
+ * @details Usage: r3dreadbench <directory> [rounds]
+ *
+ *          Every file under the directory is read once per round with each
+ *          method.  Drop the page cache between runs (as root,
+ *          "echo 3 > /proc/sys/vm/drop_caches") to measure a cold start;
+ *          otherwise this measures syscall overhead alone.
+ */
+
+#include "rock3d/rock3d.h"
+
+#include <filesystem>
+#include <iostream>
+
+#include "../src/linux_io.h"
+
+namespace fs = std::filesystem;
+
+template <typename FUNC>
+static auto TimeMS(const FUNC &fnFunc) -> double
+{
+    const auto start = std::chrono::steady_clock::now();
+    fnFunc();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: r3dreadbench <directory> [rounds]\n";
+        return 1;
+    }
+    const int rounds = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    std::vector<std::string> paths;
+    for (auto &entry : fs::recursive_directory_iterator(argv[1]))
+    {
+        if (entry.is_regular_file())
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    const std::vector<std::string_view> views(paths.begin(), paths.end());
+
+    uint64_t posixBytes = 0;
+    uint64_t uringBytes = 0;
+    double posixMS = 0.0;
+    double uringMS = 0.0;
+    for (int round = 0; round < rounds; round++)
+    {
+        posixMS += TimeMS([&views, &posixBytes] {
+            for (auto &path : views)
+            {
+                auto maybeFile = rock3d::PosixReadFile(path);
+                posixBytes += maybeFile.has_value() ? maybeFile->size() : 0;
+            }
+        });
+
+        bool available = true;
+        uringMS += TimeMS([&views, &uringBytes, &available] {
+            auto maybeFiles = rock3d::UringReadFiles(views);
+            if (!maybeFiles.has_value())
+            {
+                available = false;
+                return;
+            }
+            for (auto &file : maybeFiles.value())
+            {
+                uringBytes += file.has_value() ? file->size() : 0;
+            }
+        });
+        if (!available)
+        {
+            std::cerr << "r3dreadbench: io_uring is not available on this system\n";
+            return 1;
+        }
+    }
+
+    if (posixBytes != uringBytes)
+    {
+        std::cerr << "r3dreadbench: read() got " << posixBytes << " bytes, io_uring got " << uringBytes << "\n";
+        return 1;
+    }
+
+    std::cout << "r3dreadbench: " << paths.size() << " files, " << posixBytes / uint64_t(rounds) << " bytes, "
+              << rounds << " rounds\n";
+    std::cout << "  read():   " << posixMS / rounds << " ms per round\n";
+    std::cout << "  io_uring: " << uringMS / rounds << " ms per round\n";
+    return 0;
+}